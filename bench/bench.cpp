@@ -0,0 +1,263 @@
+/**
+ * @file bench.cpp
+ * @brief Microbenchmarks of the HTML, HTTP and URL parsing code over a synthetic corpus.
+ *
+ * Every benchmark runs one function over one input of the corpus in `bench/corpus` until a minimum time
+ * has elapsed, and reports the throughput in MB/s and in links per second (the links extracted from a
+ * page, or the URLs processed by the URL utilities). The corpus covers small pages, a large link-dense
+ * page and pathological inputs: near misses of every link pattern, over-long links and a link that is
+ * never terminated. Numbers are only meaningful for an optimized build (-DCMAKE_BUILD_TYPE=Release).
+ */
+
+#include "http.h"
+#include "parser.h"
+#include <argparse/argparse.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef BENCH_CORPUS_DIR
+#define BENCH_CORPUS_DIR "bench/corpus"
+#endif
+
+const size_t CHUNK_SIZE = 16384; // the receive buffer size of the crawler
+const char* BASE_HOST = "bench.example.com";
+const char* PAGE_NAMES[] = {"small.html", "link_dense.html", "no_links.html", "near_misses.html", "long_links.html", "unterminated.html"};
+
+struct Benchmark {
+    std::string name;
+    size_t bytes; // per iteration
+    std::function<size_t()> run; // returns the number of links per iteration
+};
+
+/**
+ * @brief Keeps the compiler from optimizing away a value that is never used.
+ */
+template <typename T>
+static void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * @brief Reads a whole file.
+ *
+ * @param path The path of the file.
+ * @param content Receives the content of the file.
+ * @return True if the file was read, otherwise false.
+ */
+static bool readFile(const std::string& path, std::string& content) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+/**
+ * @brief Wraps a page into an HTTP response, with a Content-Length or chunked transfer encoding.
+ *
+ * @param page The body of the response.
+ * @param chunked Whether the body is sent in chunks.
+ * @return The response.
+ */
+static std::string createHttpResponse(const std::string& page, bool chunked) {
+    std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nServer: bench\r\n";
+    if (!chunked) {
+        response += "Content-Length: " + std::to_string(page.size()) + "\r\n\r\n" + page;
+        return response;
+    }
+
+    response += "Transfer-Encoding: chunked\r\n\r\n";
+    char size[32];
+    for (size_t offset = 0; offset < page.size(); offset += 4096) {
+        size_t length = std::min<size_t>(4096, page.size() - offset);
+        std::snprintf(size, sizeof(size), "%zx\r\n", length);
+        response += size;
+        response.append(page, offset, length);
+        response += "\r\n";
+    }
+    response += "0\r\n\r\n";
+    return response;
+}
+
+/**
+ * @brief Runs a benchmark until the minimum time has elapsed and prints its throughput.
+ *
+ * @param benchmark The benchmark.
+ * @param minTimeMs The minimum running time in milliseconds.
+ */
+static void runBenchmark(const Benchmark& benchmark, int minTimeMs) {
+    benchmark.run(); // warm up the caches and the lazily built tables
+
+    size_t iterations = 0;
+    size_t links = 0;
+    size_t batch = 1;
+    auto startTime = std::chrono::steady_clock::now();
+    double seconds = 0;
+    while (seconds * 1000 < minTimeMs) {
+        for (size_t i = 0; i < batch; i++) {
+            links += benchmark.run();
+        }
+        iterations += batch;
+        batch *= 2;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    double megabytesPerSecond = static_cast<double>(benchmark.bytes) * iterations / seconds / 1e6;
+    std::cout << std::left << std::setw(42) << benchmark.name << std::right
+              << std::setw(12) << iterations
+              << std::setw(14) << std::fixed << std::setprecision(1) << seconds / iterations * 1e6
+              << std::setw(12) << megabytesPerSecond;
+    if (links > 0) {
+        std::cout << std::setw(14) << std::setprecision(0) << links / seconds;
+    } else {
+        std::cout << std::setw(14) << "-";
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    argparse::ArgumentParser program("threadr-bench");
+
+    program.add_argument("--corpus", "-c")
+        .help("Directory of the benchmark corpus")
+        .default_value(std::string(BENCH_CORPUS_DIR));
+
+    program.add_argument("--filter", "-f")
+        .help("Only run the benchmarks whose name contains this string")
+        .default_value(std::string(""));
+
+    program.add_argument("--minTime")
+        .help("Minimum running time of every benchmark in milliseconds")
+        .default_value(300)
+        .scan<'i', int>();
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
+        return 1;
+    }
+
+    std::string corpusDir = program.get<std::string>("--corpus");
+    std::string filter = program.get<std::string>("--filter");
+    int minTimeMs = program.get<int>("--minTime");
+
+    std::vector<std::pair<std::string, std::string>> pages;
+    for (const char* name : PAGE_NAMES) {
+        std::string content;
+        if (!readFile(corpusDir + "/" + name, content)) {
+            std::cerr << " [!] Error: Unable to read corpus file: " << corpusDir << "/" << name << std::endl;
+            return 1;
+        }
+        pages.emplace_back(name, std::move(content));
+    }
+
+    std::string urlList;
+    if (!readFile(corpusDir + "/urls.txt", urlList)) {
+        std::cerr << " [!] Error: Unable to read corpus file: " << corpusDir << "/urls.txt" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> urls;
+    std::istringstream urlStream(urlList);
+    for (std::string url; std::getline(urlStream, url);) {
+        if (!url.empty()) urls.push_back(url);
+    }
+    size_t urlBytes = 0;
+    for (const auto& url : urls) urlBytes += url.size();
+
+    LinkExtractor extractor;
+    std::vector<LinkExtractor::Link> links;
+    HttpResponseParser parser;
+    size_t bodyBytes = 0;
+    parser.setBodyHandler([&bodyBytes](const char*, size_t length) { bodyBytes += length; });
+
+    std::vector<std::string> responses;
+    responses.reserve(pages.size() * 2); // the benchmarks keep references to the responses
+    std::vector<Benchmark> benchmarks;
+    for (const auto& page : pages) {
+        const std::string& html = page.second;
+        benchmarks.push_back({"extractUrls/" + page.first, html.size(), [&html] {
+            auto extracted = extractUrls(html, BASE_HOST);
+            keep(extracted);
+            return extracted.size();
+        }});
+
+        benchmarks.push_back({"LinkExtractor::feed/" + page.first, html.size(), [&html, &extractor, &links] {
+            size_t count = 0;
+            extractor.reset(BASE_HOST);
+            for (size_t offset = 0; offset < html.size(); offset += CHUNK_SIZE) {
+                links.clear();
+                extractor.feed(html.data() + offset, std::min(CHUNK_SIZE, html.size() - offset), links);
+                count += links.size();
+            }
+            links.clear();
+            extractor.finish(links);
+            keep(links);
+            return count + links.size();
+        }});
+
+        benchmarks.push_back({"reformatHttpResponse/" + page.first, html.size(), [&html] {
+            std::string reformatted = reformatHttpResponse(html);
+            keep(reformatted);
+            return size_t(0);
+        }});
+
+        for (bool chunked : {false, true}) {
+            responses.push_back(createHttpResponse(html, chunked));
+            const std::string& response = responses.back();
+            std::string name = std::string(chunked ? "HttpResponseParser/chunked/" : "HttpResponseParser/") + page.first;
+            benchmarks.push_back({name, response.size(), [&response, &parser, &bodyBytes] {
+                parser.reset();
+                for (size_t offset = 0; offset < response.size(); offset += CHUNK_SIZE) {
+                    parser.feed(response.data() + offset, std::min(CHUNK_SIZE, response.size() - offset));
+                }
+                keep(bodyBytes);
+                return size_t(0);
+            }});
+        }
+    }
+
+    benchmarks.push_back({"getHostnameFromUrl/urls.txt", urlBytes, [&urls] {
+        size_t length = 0;
+        for (const auto& url : urls) length += getHostnameFromUrl(url).size();
+        keep(length);
+        return urls.size();
+    }});
+    benchmarks.push_back({"verifyUrl/urls.txt", urlBytes, [&urls] {
+        size_t valid = 0;
+        for (const auto& url : urls) valid += verifyUrl(url);
+        keep(valid);
+        return urls.size();
+    }});
+    benchmarks.push_back({"normalizeUrl/urls.txt", urlBytes, [&urls] {
+        size_t length = 0;
+        for (const auto& url : urls) length += normalizeUrl(url).size();
+        keep(length);
+        return urls.size();
+    }});
+
+#ifndef __OPTIMIZE__
+    std::cerr << " [!] Warning: Built without optimizations, configure with -DCMAKE_BUILD_TYPE=Release for meaningful numbers" << std::endl;
+#endif
+
+    std::cout << std::left << std::setw(42) << "Benchmark" << std::right << std::setw(12) << "Iterations"
+              << std::setw(14) << "Time (us)" << std::setw(12) << "MB/s" << std::setw(14) << "links/s" << std::endl;
+    for (const auto& benchmark : benchmarks) {
+        if (benchmark.name.find(filter) != std::string::npos) {
+            runBenchmark(benchmark, minTimeMs);
+        }
+    }
+    return 0;
+}
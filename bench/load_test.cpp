@@ -0,0 +1,252 @@
+/**
+ * @file load_test.cpp
+ * @brief End-to-end load test of the crawler against the local mock server.
+ *
+ * The driver starts a MockServer on a free local port, runs `threadr` against it (every hostname is
+ * routed to the server with --connectTo, so no DNS or network is involved) and reports the throughput
+ * in pages per second, the latency percentiles exported by the crawler, and the CPU time and peak RSS of
+ * the crawler process. With --serveOnly it only runs the server, to crawl it by hand.
+ */
+
+#include "mock_server.h"
+#include <argparse/argparse.hpp>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef THREADR_PATH
+#define THREADR_PATH "threadr"
+#endif
+
+static volatile sig_atomic_t isStopRequested = 0;
+
+/**
+ * @brief Reads a sample from a Prometheus text file.
+ *
+ * @param metrics The content of the file.
+ * @param name The name of the sample, with its labels.
+ * @return The value of the sample, 0 if it is missing.
+ */
+static double getMetric(const std::string& metrics, const std::string& name) {
+    std::istringstream lines(metrics);
+    for (std::string line; std::getline(lines, line);) {
+        if (line.size() > name.size() && line.compare(0, name.size(), name) == 0 && line[name.size()] == ' ') {
+            return std::strtod(line.c_str() + name.size() + 1, nullptr);
+        }
+    }
+    return 0;
+}
+
+static double getStageQuantile(const std::string& metrics, const std::string& stage, const std::string& quantile) {
+    return getMetric(metrics, "threadr_stage_duration_seconds{stage=\"" + stage + "\",quantile=\"" + quantile + "\"}") * 1000;
+}
+
+/**
+ * @brief Runs the crawler and waits for it to exit.
+ *
+ * @param arguments The command line of the crawler.
+ * @param logPath The file receiving the output of the crawler.
+ * @param timeoutSeconds The time after which the crawler is killed, 0 for no limit.
+ * @param usage Receives the resource usage of the crawler.
+ * @return The exit status of the crawler, -1 if it could not be started or was killed.
+ */
+static int runCrawler(const std::vector<std::string>& arguments, const std::string& logPath, int timeoutSeconds, struct rusage& usage) {
+    // the server threads are running, so the child only makes async-signal-safe calls before exec
+    std::vector<char*> argv;
+    for (const auto& argument : arguments) argv.push_back(const_cast<char*>(argument.c_str()));
+    argv.push_back(nullptr);
+    std::string execError = " [!] Error: Cannot run " + arguments[0] + "\n";
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << " [!] Error: Cannot start the crawler: " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    if (pid == 0) {
+        int log = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log >= 0) {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+            close(log);
+        }
+        execv(argv[0], argv.data());
+        ssize_t written = write(STDERR_FILENO, execError.data(), execError.size());
+        _exit(written >= 0 ? 127 : 126);
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    bool killed = false;
+    int status = 0;
+    while (wait4(pid, &status, WNOHANG, &usage) == 0) {
+        bool timedOut = timeoutSeconds > 0 && std::chrono::steady_clock::now() - startTime > std::chrono::seconds(timeoutSeconds);
+        if (!killed && (timedOut || isStopRequested)) {
+            std::cerr << " [!] Warning: " << (timedOut ? "Timeout reached" : "Interrupted") << ", killing the crawler" << std::endl;
+            kill(pid, SIGKILL);
+            killed = true;
+        }
+        usleep(2000);
+    }
+    return killed || !WIFEXITED(status) ? -1 : WEXITSTATUS(status);
+}
+
+int main(int argc, char* argv[]) {
+    argparse::ArgumentParser program("threadr-load");
+
+    program.add_argument("--hosts").help("Number of virtual hosts of the mock server").default_value(1000).scan<'i', int>();
+    program.add_argument("--pagesPerHost").help("Number of pages of every host").default_value(20).scan<'i', int>();
+    program.add_argument("--fanout").help("Number of links on every page").default_value(10).scan<'i', int>();
+    program.add_argument("--externalLinks").help("Fraction of the links pointing to other hosts").default_value(0.3).scan<'g', double>();
+    program.add_argument("--pageSize").help("Size of the pages in bytes").default_value(8192).scan<'i', int>();
+    program.add_argument("--latency").help("Minimum latency of the hosts in milliseconds").default_value(5).scan<'i', int>();
+    program.add_argument("--latencyJitter").help("Extra latency of up to this many milliseconds, fixed per host").default_value(20).scan<'i', int>();
+    program.add_argument("--errorRate").help("Fraction of the pages answered with a 500 error").default_value(0.01).scan<'g', double>();
+    program.add_argument("--serverThreads").help("Number of threads of the mock server").default_value(2).scan<'i', int>();
+    program.add_argument("--port").help("Port of the mock server, 0 for a free port").default_value(0).scan<'i', int>();
+
+    program.add_argument("--gzip")
+        .help("Serve the pages gzip-compressed to clients accepting it")
+        .implicit_value(true)
+        .default_value(false)
+        .nargs(0);
+
+    program.add_argument("--serveOnly")
+        .help("Only run the mock server, until interrupted")
+        .implicit_value(true)
+        .default_value(false)
+        .nargs(0);
+
+    program.add_argument("--threadr").help("Path of the crawler").default_value(std::string(THREADR_PATH));
+    program.add_argument("--ioBackend").help("I/O backend of the crawler: `threads` or `epoll`").default_value(std::string("threads"));
+    program.add_argument("--maxThreads").help("Number of crawler threads (threads backend)").default_value(16).scan<'i', int>();
+    program.add_argument("--ioThreads").help("Number of event loops (epoll backend)").default_value(4).scan<'i', int>();
+    program.add_argument("--crawlDepth").help("Maximum crawl depth").default_value(3).scan<'i', int>();
+    program.add_argument("--linkedSitesLimit").help("Maximum number of linked sites followed per site").default_value(20).scan<'i', int>();
+    program.add_argument("--crawlDelay").help("Delay between two pages of a host in milliseconds").default_value(0).scan<'i', int>();
+    program.add_argument("--threadrArgs").help("Extra arguments of the crawler, separated by spaces").default_value(std::string(""));
+    program.add_argument("--log").help("File receiving the output of the crawler").default_value(std::string("/dev/null"));
+    program.add_argument("--timeout").help("Kill the crawler after this many seconds, 0 for no limit").default_value(600).scan<'i', int>();
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
+        return 1;
+    }
+
+    MockServer::Options options;
+    options.hosts = program.get<int>("--hosts");
+    options.pagesPerHost = program.get<int>("--pagesPerHost");
+    options.fanout = program.get<int>("--fanout");
+    options.externalLinks = program.get<double>("--externalLinks");
+    options.pageSize = program.get<int>("--pageSize");
+    options.latencyMs = program.get<int>("--latency");
+    options.latencyJitterMs = program.get<int>("--latencyJitter");
+    options.errorRate = program.get<double>("--errorRate");
+    options.threads = program.get<int>("--serverThreads");
+    options.gzip = program.get<bool>("--gzip");
+
+    std::signal(SIGINT, [](int) { isStopRequested = 1; });
+    std::signal(SIGTERM, [](int) { isStopRequested = 1; });
+
+    MockServer server(options);
+    if (!server.start(program.get<int>("--port"))) {
+        return 1;
+    }
+    std::string address = "127.0.0.1:" + std::to_string(server.getPort());
+    std::string startUrl = "http://" + MockServer::getHostname(0) + "/";
+
+    if (program.get<bool>("--serveOnly")) {
+        std::cout << " [*] Mock server listening on " << address << ", crawl it with: threadr --connectTo " << address << " " << startUrl << std::endl;
+        while (!isStopRequested) {
+            usleep(100000);
+        }
+        std::cout << " [*] Served " << server.getServedRequests() << " requests" << std::endl;
+        return 0;
+    }
+
+    char metricsPath[] = "/tmp/threadr-load-XXXXXX";
+    int metricsFd = mkstemp(metricsPath);
+    if (metricsFd < 0) {
+        std::cerr << " [!] Error: Cannot create the metrics file: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    close(metricsFd);
+
+    std::string backend = program.get<std::string>("--ioBackend");
+    std::vector<std::string> arguments = {
+        program.get<std::string>("--threadr"),
+        "--connectTo", address,
+        "--ioBackend", backend,
+        "--maxThreads", std::to_string(program.get<int>("--maxThreads")),
+        "--ioThreads", std::to_string(program.get<int>("--ioThreads")),
+        "--crawlDepth", std::to_string(program.get<int>("--crawlDepth")),
+        "--pageLimit", std::to_string(options.pagesPerHost),
+        "--linkedSitesLimit", std::to_string(program.get<int>("--linkedSitesLimit")),
+        "--crawlDelay", std::to_string(program.get<int>("--crawlDelay")),
+        "--metricsFile", metricsPath,
+        "--disableConsoleOutput",
+    };
+    std::istringstream extraArguments(program.get<std::string>("--threadrArgs"));
+    for (std::string argument; extraArguments >> argument;) {
+        arguments.push_back(argument);
+    }
+    arguments.push_back(startUrl);
+
+    std::cout << " [*] Mock server: " << options.hosts << " hosts x " << options.pagesPerHost << " pages of " << options.pageSize
+              << " bytes, fan-out " << options.fanout << ", latency " << options.latencyMs << "-" << options.latencyMs + options.latencyJitterMs
+              << " ms, error rate " << options.errorRate << (options.gzip ? ", gzip" : "") << std::endl;
+    std::cout << " [*] Running:";
+    for (const auto& argument : arguments) std::cout << " " << argument;
+    std::cout << std::endl;
+
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    auto startTime = std::chrono::steady_clock::now();
+    int status = runCrawler(arguments, program.get<std::string>("--log"), program.get<int>("--timeout"), usage);
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    server.stop();
+
+    std::ifstream metricsFile(metricsPath);
+    std::stringstream metricsBuffer;
+    metricsBuffer << metricsFile.rdbuf();
+    std::string metrics = metricsBuffer.str();
+    std::remove(metricsPath);
+
+    if (status != 0) {
+        std::cerr << " [!] Error: The crawler failed" << (status > 0 ? " with status " + std::to_string(status) : std::string()) << std::endl;
+        if (metrics.empty()) return 1;
+    }
+
+    double pages = getMetric(metrics, "threadr_pages_total");
+    double cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "----------------------------------------------------------------------------" << std::endl;
+    std::cout << " [*] Wall time:        " << wallSeconds << " s" << std::endl;
+    std::cout << " [*] Pages:            " << static_cast<uint64_t>(pages) << " (" << pages / wallSeconds << " pages/s)" << std::endl;
+    std::cout << " [*] Requests:         " << static_cast<uint64_t>(getMetric(metrics, "threadr_requests_total")) << " sent, "
+              << server.getServedRequests() << " served (" << server.getServedErrors() << " errors), "
+              << static_cast<uint64_t>(getMetric(metrics, "threadr_failed_queries_total")) << " failed" << std::endl;
+    std::cout << " [*] Received:         " << getMetric(metrics, "threadr_received_bytes_total") / (1 << 20) << " MiB" << std::endl;
+    std::cout << " [*] Time to 1st byte: p50 " << getStageQuantile(metrics, "ttfb", "0.5") << " ms, p90 " << getStageQuantile(metrics, "ttfb", "0.9")
+              << " ms, p99 " << getStageQuantile(metrics, "ttfb", "0.99") << " ms" << std::endl;
+    std::cout << " [*] Download:         p50 " << getStageQuantile(metrics, "download", "0.5") << " ms, p90 " << getStageQuantile(metrics, "download", "0.9")
+              << " ms, p99 " << getStageQuantile(metrics, "download", "0.99") << " ms" << std::endl;
+    std::cout << " [*] CPU:              " << cpuSeconds << " s (user " << usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+              << " s, system " << usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6 << " s), "
+              << std::setprecision(0) << cpuSeconds / wallSeconds * 100 << "% of a core" << std::endl;
+    std::cout << " [*] Peak RSS:         " << std::setprecision(1) << usage.ru_maxrss / 1024.0 << " MiB" << std::endl;
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,474 @@
+/**
+ * @file mock_server.cpp
+ * @brief Implementation of the local HTTP server serving a synthetic site graph to load tests.
+ *
+ * Every server thread runs an EventLoop with its own listening socket bound to the shared port with
+ * SO_REUSEPORT, so the kernel spreads the connections over the threads. Connections are kept alive and
+ * each request is answered after the latency of its host, scheduled on the loop's timer wheel, so slow
+ * hosts do not hold a thread. Page 0 of a host is served at "/" and page N at "/page<N>.html".
+ */
+
+#include "mock_server.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unordered_set>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <zlib.h>
+#include <unistd.h>
+
+const std::string MOCK_DOMAIN = ".threadr-mock.com";
+const size_t MAX_REQUEST_SIZE = 65536;
+const char* FILLER_TEXT = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore. ";
+
+/**
+ * @brief Mixes the bits of a value (splitmix64 finalizer).
+ */
+static uint64_t mix(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+static uint64_t hashPage(int host, int page, int salt) {
+    return mix(mix(static_cast<uint64_t>(host)) ^ (static_cast<uint64_t>(page) << 20) ^ static_cast<uint64_t>(salt));
+}
+
+static std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    return text;
+}
+
+/**
+ * @brief Parses a non-negative decimal number filling a whole string.
+ *
+ * @return The number, or -1 if the string is not a number.
+ */
+static int parseIndex(const std::string& text) {
+    if (text.empty() || text.size() > 9) {
+        return -1;
+    }
+    int value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return -1;
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
+
+/**
+ * @brief Compresses a body in the gzip format, in place.
+ *
+ * @return True if the body was compressed, false (body unchanged) if zlib failed.
+ */
+static bool compressGzip(std::string& body) {
+    z_stream stream = z_stream();
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    std::string compressed(deflateBound(&stream, static_cast<uLong>(body.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(&body[0]);
+    stream.avail_in = static_cast<uInt>(body.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    int result = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        return false;
+    }
+    body = std::move(compressed);
+    return true;
+}
+
+class MockServer::Listener : public EventHandler {
+public:
+    Listener(MockServer& server, EventLoop& loop, int fd) : server(server), loop(loop), fd(fd) {}
+    ~Listener() override;
+
+    void handleEvent(uint32_t events) override;
+    void release(Connection* connection);
+
+private:
+    MockServer& server;
+    EventLoop& loop;
+    int fd;
+    std::unordered_set<Connection*> connections;
+    std::vector<Connection*> closedConnections; // deleted once the events of the current batch are handled
+};
+
+class MockServer::Connection : public EventHandler {
+public:
+    Connection(MockServer& server, EventLoop& loop, Listener& listener, int fd)
+        : server(server), loop(loop), listener(listener), fd(fd), outputOffset(0), responseTimer(0), closeAfterWrite(false), closed(false) {}
+
+    ~Connection() override {
+        if (!closed) {
+            close(fd);
+        }
+    }
+
+    void handleEvent(uint32_t events) override {
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            readRequests();
+        }
+        if (!closed && (events & EPOLLOUT)) {
+            writeResponse();
+        }
+    }
+
+private:
+    MockServer& server;
+    EventLoop& loop;
+    Listener& listener;
+    int fd;
+    std::string input;
+    std::string output;
+    size_t outputOffset;
+    uint64_t responseTimer;
+    bool closeAfterWrite;
+    bool closed;
+
+    void readRequests() {
+        char buffer[16384];
+        while (true) {
+            ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+            if (length > 0) {
+                input.append(buffer, static_cast<size_t>(length));
+                if (input.size() > MAX_REQUEST_SIZE) {
+                    closeConnection();
+                    return;
+                }
+            } else if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else if (length < 0 && errno == EINTR) {
+                continue;
+            } else {
+                closeConnection(); // closed by the client, or reset
+                return;
+            }
+        }
+        handleNextRequest();
+    }
+
+    // requests are answered one at a time, in order, so pipelined requests wait for the previous response
+    void handleNextRequest() {
+        if (responseTimer != 0 || outputOffset < output.size() || closeAfterWrite) {
+            return;
+        }
+        size_t end = input.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            return;
+        }
+
+        std::string request = input.substr(0, end + 2);
+        input.erase(0, end + 4);
+
+        std::string path;
+        std::string host;
+        bool keepAlive = true;
+        bool acceptsGzip = false;
+        size_t lineEnd = request.find("\r\n");
+        std::string requestLine = request.substr(0, lineEnd);
+        size_t pathStart = requestLine.find(' ');
+        size_t pathEnd = requestLine.find(' ', pathStart + 1);
+        if (pathStart != std::string::npos && pathEnd != std::string::npos) {
+            path = requestLine.substr(pathStart + 1, pathEnd - pathStart - 1);
+            keepAlive = requestLine.compare(pathEnd + 1, std::string::npos, "HTTP/1.0") != 0;
+        }
+        for (size_t start = lineEnd + 2; start < request.size();) {
+            size_t next = request.find("\r\n", start);
+            std::string line = request.substr(start, next - start);
+            start = next + 2;
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = toLower(line.substr(0, colon));
+            size_t valueStart = line.find_first_not_of(' ', colon + 1);
+            std::string value = toLower(valueStart == std::string::npos ? std::string() : line.substr(valueStart));
+            if (name == "host") host = value.substr(0, value.find(':'));
+            else if (name == "connection") keepAlive = value != "close" && (keepAlive || value == "keep-alive");
+            else if (name == "accept-encoding") acceptsGzip = value.find("gzip") != std::string::npos;
+        }
+
+        int delayMs = 0;
+        std::string response = server.createResponse(host, path, keepAlive, acceptsGzip, delayMs);
+        responseTimer = loop.runAfter(delayMs, [this, response, keepAlive] {
+            responseTimer = 0;
+            output = response;
+            outputOffset = 0;
+            closeAfterWrite = !keepAlive;
+            writeResponse();
+        });
+    }
+
+    void writeResponse() {
+        while (outputOffset < output.size()) {
+            ssize_t written = send(fd, output.data() + outputOffset, output.size() - outputOffset, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                loop.modifyFd(fd, EPOLLIN | EPOLLOUT, this);
+                return;
+            }
+            if (written < 0) {
+                closeConnection();
+                return;
+            }
+            outputOffset += static_cast<size_t>(written);
+        }
+
+        output.clear();
+        outputOffset = 0;
+        if (closeAfterWrite) {
+            closeConnection();
+            return;
+        }
+        loop.modifyFd(fd, EPOLLIN, this);
+        handleNextRequest();
+    }
+
+    void closeConnection() {
+        if (closed) {
+            return;
+        }
+        closed = true;
+        if (responseTimer != 0) {
+            loop.cancelTimer(responseTimer);
+            responseTimer = 0;
+        }
+        loop.removeFd(fd);
+        close(fd);
+        listener.release(this);
+    }
+};
+
+/**
+ * @brief Deletes the remaining connections, once the loop of the listener has stopped.
+ */
+MockServer::Listener::~Listener() {
+    for (Connection* connection : connections) {
+        delete connection;
+    }
+    for (Connection* connection : closedConnections) {
+        delete connection;
+    }
+    close(fd);
+}
+
+/**
+ * @brief Accepts the pending connections and registers them with the loop of the listener.
+ */
+void MockServer::Listener::handleEvent(uint32_t) {
+    while (true) {
+        int client = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << " [!] Error: Mock server cannot accept a connection: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+        Connection* connection = new Connection(server, loop, *this, client);
+        if (!loop.addFd(client, EPOLLIN | EPOLLRDHUP, connection)) {
+            delete connection;
+            continue;
+        }
+        connections.insert(connection);
+    }
+}
+
+/**
+ * @brief Takes back a closed connection, which is deleted after the current batch of events.
+ */
+void MockServer::Listener::release(Connection* connection) {
+    connections.erase(connection);
+    closedConnections.push_back(connection);
+    if (closedConnections.size() == 1) {
+        loop.post([this] {
+            for (Connection* closed : closedConnections) {
+                delete closed;
+            }
+            closedConnections.clear();
+        });
+    }
+}
+
+/**
+ * @brief Constructs a MockServer object, which serves nothing before start() is called.
+ *
+ * @param options The shape of the site graph and the behavior of the hosts.
+ */
+MockServer::MockServer(const Options& options) : options(options), port(0), servedRequests(0), servedErrors(0) {
+    this->options.hosts = std::max(1, options.hosts);
+    this->options.pagesPerHost = std::max(1, options.pagesPerHost);
+    this->options.threads = std::max(1, options.threads);
+}
+
+MockServer::~MockServer() {
+    stop();
+}
+
+/**
+ * @brief Binds the listening sockets on 127.0.0.1 and starts the server threads.
+ *
+ * @param requestedPort The port to listen on, or 0 for a free port chosen by the system.
+ * @return True if the server is listening, otherwise false.
+ */
+bool MockServer::start(int requestedPort) {
+    port = requestedPort;
+    for (int i = 0; i < options.threads; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int enable = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+            std::cerr << " [!] Error: Mock server cannot listen on port " << port << ": " << strerror(errno) << std::endl;
+            if (fd >= 0) close(fd);
+            stop();
+            return false;
+        }
+
+        if (port == 0) { // the other threads share the port chosen for the first one
+            socklen_t length = sizeof(address);
+            getsockname(fd, reinterpret_cast<struct sockaddr*>(&address), &length);
+            port = ntohs(address.sin_port);
+        }
+
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->listener.reset(new Listener(*this, worker->loop, fd));
+        worker->loop.addFd(fd, EPOLLIN, worker->listener.get());
+        workers.push_back(std::move(worker));
+    }
+
+    for (auto& worker : workers) {
+        EventLoop* loop = &worker->loop;
+        worker->thread = std::thread([loop] { loop->run(); });
+    }
+    return true;
+}
+
+/**
+ * @brief Stops the server threads and closes every connection.
+ */
+void MockServer::stop() {
+    for (auto& worker : workers) {
+        worker->loop.stop();
+    }
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+    workers.clear();
+}
+
+/**
+ * @brief Gets the hostname of a virtual host.
+ *
+ * @param host The index of the host.
+ * @return The hostname.
+ */
+std::string MockServer::getHostname(int host) {
+    return "site" + std::to_string(host) + MOCK_DOMAIN;
+}
+
+/**
+ * @brief Builds the response to a request and the delay before it is sent.
+ *
+ * @param host The Host header of the request, lowercased and without port.
+ * @param path The path of the request.
+ * @param keepAlive Whether the connection stays open after the response.
+ * @param acceptsGzip Whether the request accepts a gzip body.
+ * @param delayMs Receives the latency of the host in milliseconds.
+ * @return The response.
+ */
+std::string MockServer::createResponse(const std::string& host, const std::string& path, bool keepAlive, bool acceptsGzip, int& delayMs) {
+    servedRequests++;
+
+    int hostIndex = -1;
+    if (host.size() > MOCK_DOMAIN.size() + 4 && host.compare(0, 4, "site") == 0
+        && host.compare(host.size() - MOCK_DOMAIN.size(), MOCK_DOMAIN.size(), MOCK_DOMAIN) == 0) {
+        hostIndex = parseIndex(host.substr(4, host.size() - MOCK_DOMAIN.size() - 4));
+    }
+    int pageIndex = -1;
+    if (path == "/") {
+        pageIndex = 0;
+    } else if (path.size() > 10 && path.compare(0, 5, "/page") == 0 && path.compare(path.size() - 5, 5, ".html") == 0) {
+        pageIndex = parseIndex(path.substr(5, path.size() - 10));
+    }
+
+    int status = 200;
+    std::string body;
+    if (hostIndex < 0 || hostIndex >= options.hosts || pageIndex < 0 || pageIndex >= options.pagesPerHost) {
+        status = 404;
+        body = "<html><body>Not Found</body></html>\n";
+        delayMs = 0;
+    } else {
+        delayMs = options.latencyMs + static_cast<int>(mix(static_cast<uint64_t>(hostIndex)) % static_cast<uint64_t>(options.latencyJitterMs + 1));
+        if (static_cast<double>(hashPage(hostIndex, pageIndex, 1) % 1000000) < options.errorRate * 1000000) {
+            status = 500;
+            body = "<html><body>Internal Server Error</body></html>\n";
+        } else {
+            body = createPage(hostIndex, pageIndex);
+        }
+    }
+    if (status != 200) {
+        servedErrors++;
+    }
+
+    bool compressed = status == 200 && options.gzip && acceptsGzip && compressGzip(body);
+
+    std::string response = "HTTP/1.1 " + std::to_string(status) + (status == 200 ? " OK" : status == 404 ? " Not Found" : " Internal Server Error");
+    response += "\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+    if (compressed) {
+        response += "Content-Encoding: gzip\r\n";
+    }
+    response += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    response += body;
+    return response;
+}
+
+/**
+ * @brief Generates a page: `fanout` links spread over filler text, padded to the page size.
+ *
+ * @param host The index of the host.
+ * @param page The index of the page.
+ * @return The HTML of the page.
+ */
+std::string MockServer::createPage(int host, int page) const {
+    std::string html = "<!DOCTYPE html>\n<html><head><title>Site " + std::to_string(host) + " page " + std::to_string(page) + "</title></head>\n<body>\n";
+    size_t fillerPerLink = static_cast<size_t>(std::max(0, options.pageSize)) / static_cast<size_t>(options.fanout + 1);
+    size_t fillerLength = strlen(FILLER_TEXT);
+
+    for (int link = 0; link < options.fanout; link++) {
+        html += "<p>";
+        for (size_t length = 0; length < fillerPerLink; length += fillerLength) {
+            html.append(FILLER_TEXT, std::min(fillerLength, fillerPerLink - length));
+        }
+
+        uint64_t hash = hashPage(host, page, link + 2);
+        if (static_cast<double>(hash % 1000000) < options.externalLinks * 1000000) {
+            html += "<a href=\"http://" + getHostname(static_cast<int>((hash >> 20) % static_cast<uint64_t>(options.hosts))) + "/\">another site</a>";
+        } else {
+            int target = static_cast<int>((hash >> 20) % static_cast<uint64_t>(options.pagesPerHost));
+            html += "<a href=\"" + (target == 0 ? std::string("/") : "/page" + std::to_string(target) + ".html") + "\">page " + std::to_string(target) + "</a>";
+        }
+        html += "</p>\n";
+    }
+
+    while (html.size() + 15 < static_cast<size_t>(options.pageSize)) {
+        html.append(FILLER_TEXT, std::min(fillerLength, static_cast<size_t>(options.pageSize) - html.size() - 15));
+    }
+    html += "</body></html>\n";
+    return html;
+}
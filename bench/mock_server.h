@@ -0,0 +1,64 @@
+#ifndef MOCK_SERVER_H
+#define MOCK_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "event_loop.h"
+
+// Local HTTP/1.1 server generating a synthetic site graph: `hosts` virtual hosts named site<N>.threadr-mock.com
+// with `pagesPerHost` pages each, every page linking to `fanout` pages of the same or of other hosts. Pages,
+// latencies and errors are derived from hashes, so every run serves the same graph.
+class MockServer {
+public:
+    struct Options {
+        int hosts = 1000;
+        int pagesPerHost = 20;
+        int fanout = 10;
+        double externalLinks = 0.3; // fraction of the links pointing to other hosts
+        int pageSize = 8192;
+        int latencyMs = 5; // every host answers after latencyMs plus up to latencyJitterMs
+        int latencyJitterMs = 20;
+        double errorRate = 0.01; // fraction of the pages answered with a 500
+        int threads = 2;
+        bool gzip = false; // compress the pages sent to clients accepting gzip
+    };
+
+    explicit MockServer(const Options& options);
+    ~MockServer();
+
+    MockServer(const MockServer&) = delete;
+    MockServer& operator=(const MockServer&) = delete;
+
+    bool start(int port = 0);
+    void stop();
+    int getPort() const { return port; }
+    uint64_t getServedRequests() const { return servedRequests.load(); }
+    uint64_t getServedErrors() const { return servedErrors.load(); }
+
+    static std::string getHostname(int host);
+
+private:
+    class Listener;
+    class Connection;
+
+    struct Worker {
+        EventLoop loop;
+        std::unique_ptr<Listener> listener;
+        std::thread thread;
+    };
+
+    Options options;
+    int port;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<uint64_t> servedRequests;
+    std::atomic<uint64_t> servedErrors;
+
+    std::string createResponse(const std::string& host, const std::string& path, bool keepAlive, bool acceptsGzip, int& delayMs);
+    std::string createPage(int host, int page) const;
+};
+
+#endif // MOCK_SERVER_H
@@ -0,0 +1,35 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 16384);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    char* allocate(size_t size);
+    void shrinkLast(char* data, size_t size, size_t usedSize);
+    std::string_view copy(std::string_view text);
+    void reset();
+
+    size_t capacity() const;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t currentBlock;
+    size_t offset;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,67 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "mpsc_queue.h"
+
+class Checkpoint {
+public:
+    using Site = std::pair<std::string, int>;
+
+    struct State {
+        std::vector<uint64_t> completedSites; // fingerprints of the hostnames
+        std::vector<Site> pendingSites;
+    };
+
+    explicit Checkpoint(int flushIntervalMs = 5000);
+    ~Checkpoint();
+
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+
+    static bool load(const std::string& path, State& state);
+
+    bool open(const std::string& path, const State& state);
+    bool isOpen() const { return fd >= 0; }
+    void recordDiscovered(const std::string& hostname, int depth);
+    void recordCompleted(const std::string& hostname);
+    void stop();
+
+private:
+    struct Record {
+        char type;
+        std::string hostname;
+        int depth;
+    };
+
+    int flushIntervalMs;
+    std::string path;
+    int fd;
+    uint64_t logBytes;
+    uint64_t compactedBytes;
+    std::string buffer;
+
+    std::vector<uint64_t> completedSites;
+    std::unordered_map<uint64_t, Site> pendingSites;
+
+    MpscQueue<Record> queue;
+    std::atomic<bool> stopRequested;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondVar;
+    std::thread writer;
+
+    void runWriter();
+    void apply(const Record& record);
+    bool writeBuffer();
+    bool compact();
+};
+
+#endif // CHECKPOINT_H
@@ -6,13 +6,43 @@
 
 struct Config {
     int crawlDelay = 1500;
+    bool adaptiveDelay = false;
+    int minCrawlDelay = 0;
+    int maxCrawlDelay = 30000;
     int maxThreads = 15;
     int depthLimit = 5;
     int pageLimit = 20;
     int linkedSitesLimit = 20;
+    int maxActiveSites = 256;
+    std::string ioBackend = "threads";
+    int ioThreads = 4;
+    int maxConnections = 1024;
+    bool keepAlive = true;
+    int maxIdleConnections = 256;
+    int maxBodySize = 2097152;
+    int dnsThreads = 4;
+    int dnsCacheTtl = 300;
+    int dnsNegativeTtl = 60;
+    int dnsCacheSize = 100000;
+    std::string connectTo = "";
+    bool obeyRobots = true;
+    int robotsCacheSize = 100000;
+    int bloomFilterHosts = 0;
+    std::string frontierOrder = "fifo";
+    int frontierMemoryLimit = 0;
+    std::string frontierSpillDir = "";
     bool verbose = false;
     bool enableCSVOutput = false;
+    bool enableBinaryOutput = false;
     bool disableConsoleOutput = false;
+    std::string checkpointFile = "";
+    int checkpointInterval = 5000;
+    bool resume = false;
+    std::string metricsFile = "";
+    int metricsInterval = 10000;
+    int shards = 1;
+    int shardIndex = -1; // set in the shard processes
+    std::string shardSocket = "";
     std::vector<std::string> startUrls;
 };
 
@@ -0,0 +1,44 @@
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+
+class ConnectionPool {
+public:
+    ConnectionPool(int maxIdlePerHost = 4, int idleTimeoutMs = 30000, int maxIdleTotal = 256);
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    int acquire(const std::string& hostname, int port);
+    void release(const std::string& hostname, int port, int fd);
+    void discard(const std::string& hostname, int port);
+
+private:
+    struct IdleConnection {
+        std::string key;
+        int fd;
+        std::chrono::steady_clock::time_point idleSince;
+    };
+    using IdleList = std::list<IdleConnection>;
+
+    int maxIdlePerHost;
+    std::chrono::milliseconds idleTimeout;
+    size_t maxIdleTotal;
+    std::mutex poolMutex;
+    IdleList idleList; // most recently released first
+    std::unordered_map<std::string, std::vector<IdleList::iterator>> idleConnections;
+
+    void remove(IdleList::iterator connection);
+    void evictExpired(std::chrono::steady_clock::time_point now, std::vector<int>& staleConnections);
+    static std::string makeKey(const std::string& hostname, int port);
+    static bool isAlive(int fd);
+};
+
+#endif // CONNECTION_POOL_H
@@ -4,6 +4,17 @@
 #include "socket.h"
 #include "parser.h"
 #include "config.h"
+#include "event_loop.h"
+#include "connection_pool.h"
+#include "frontier.h"
+#include "host_scheduler.h"
+#include "resolver.h"
+#include "result_sink.h"
+#include "checkpoint.h"
+#include "metrics.h"
+#include "robots.h"
+#include "rate_controller.h"
+#include "shard.h"
 #include <iostream>
 #include <fstream>
 #include <queue>
@@ -13,33 +24,49 @@
 #include <map>
 #include <iomanip>
 #include <condition_variable>
+#include <memory>
 
 
 class Crawler {
 public:
     Crawler(const Config& config);
     void start();
+    void stop();
 private:
     Config config;
     struct CrawlerState {
-        int threadsCount;
-        std::queue<std::pair<std::string, int>> pendingSites;
-        std::map<std::string, bool> discoveredSites;
+        int activeSites;
+        std::unique_ptr<SiteFrontier> frontier;
+        std::unique_ptr<HostScheduler> scheduler;
     } crawlerState;    
 
-    std::mutex m_mutex;
+    ConnectionPool connectionPool;
+    Resolver resolver;
+    RobotsCache robotsCache;
+    RateController::Limits rateLimits;
+    int serverPort;
+    ResultSink resultSink;
+    Checkpoint checkpoint;
+    Metrics metrics;
+    std::unique_ptr<ShardClient> shardClient;
 
-    std::mutex csvMutex;
+    std::mutex m_mutex;
 
     std::condition_variable m_condVar;
-    bool isThreadFinished;
+    bool isStopRequested;
 
     void initialize();
+    Socket::Services socketServices();
     void initializeResultsFile();
-    void startCrawler(std::string baseUrl, int currentDepth);
+    void initializeCheckpoint(size_t& nextWorker);
+    void initializeShard();
+    void startShard();
+    bool discoverSite(size_t workerId, const std::string& hostname, int depth);
     void scheduleCrawlers();
-    void writeResultsToConsole(const Socket::SiteStats& stats, int currentDepth);
-    void writeResultsToCsv(const Socket::SiteStats& stats, int currentDepth);
+    void runWorker(size_t workerId);
+    void scheduleAsyncCrawlers();
+    void startAsyncCrawler(size_t loopId, EventLoop* loop, std::string baseUrl, int currentDepth);
+    void handleSiteResults(size_t workerId, Socket::SiteStats stats, int currentDepth);
     
 };
 
@@ -0,0 +1,53 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include "timer_wheel.h"
+
+class EventHandler {
+public:
+    virtual ~EventHandler() = default;
+    virtual void handleEvent(uint32_t events) = 0;
+};
+
+class EventLoop {
+public:
+    using Task = std::function<void()>;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool addFd(int fd, uint32_t events, EventHandler* handler);
+    bool modifyFd(int fd, uint32_t events, EventHandler* handler);
+    void removeFd(int fd);
+
+    uint64_t runAfter(int delayMs, Task task);
+    void cancelTimer(uint64_t timerId);
+
+    void post(Task task);
+    void run();
+    void stop();
+
+private:
+    int epollFd;
+    int wakeFd;
+    std::atomic<bool> running;
+
+    std::mutex tasksMutex;
+    std::vector<Task> pendingTasks;
+
+    TimerWheel timers;
+
+    void wakeup();
+    void runExpiredTimers();
+    void runPendingTasks();
+};
+
+#endif // EVENT_LOOP_H
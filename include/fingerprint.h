@@ -0,0 +1,46 @@
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+uint64_t getFingerprint(const char* data, size_t length);
+uint64_t getUrlFingerprint(std::string_view url);
+
+class FingerprintSet {
+public:
+    explicit FingerprintSet(size_t initialCapacity = 16);
+
+    bool insert(uint64_t fingerprint);
+    bool contains(uint64_t fingerprint) const;
+    size_t size() const { return count; }
+    size_t memoryUsage() const { return slots.size() * sizeof(uint64_t); }
+
+private:
+    std::vector<uint64_t> slots;
+    size_t count;
+    size_t mask;
+
+    void grow();
+};
+
+class BloomFilter {
+public:
+    BloomFilter(size_t expectedItems, double falsePositiveRate);
+
+    bool insert(uint64_t fingerprint);
+    bool mayContain(uint64_t fingerprint) const;
+    size_t memoryUsage() const { return wordCount * sizeof(uint64_t); }
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+    size_t wordCount;
+    uint64_t bitCount;
+    int hashCount;
+};
+
+#endif // FINGERPRINT_H
@@ -0,0 +1,87 @@
+#ifndef FRONTIER_H
+#define FRONTIER_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include "fingerprint.h"
+#include "indexed_heap.h"
+#include "spill_queue.h"
+
+class SiteFrontier {
+public:
+    using Site = std::pair<std::string, int>;
+
+    enum class Order { Fifo, Priority };
+
+    explicit SiteFrontier(int workerCount, size_t bloomFilterHosts = 0, int seenStripeCount = 64);
+
+    void setOrder(Order order);
+    bool setMemoryLimit(size_t bytes, const std::string& spillDirectory = "");
+    bool markDiscovered(const std::string& hostname);
+    bool markDiscovered(uint64_t fingerprint);
+    void push(size_t worker, const Site& site);
+    bool tryPop(size_t worker, Site& site);
+    void addInLink(const std::string& hostname);
+    void recordResponseTime(const std::string& hostname, double averageResponseTime);
+    void setWakeListener(std::function<void(bool)> listener);
+    void completeSite();
+    void hold();
+    void close();
+
+    bool isFinished() const { return outstandingSites.load() == 0 || closed.load(); }
+    size_t pendingCount() const { return static_cast<size_t>(std::max(0L, pendingSites.load())); }
+    size_t outstandingCount() const { return static_cast<size_t>(std::max(0L, outstandingSites.load())); }
+    size_t spilledCount() const { return spillQueue ? spillQueue->size() : 0; }
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Site> sites;
+    };
+
+    struct PrioritySite {
+        Site site;
+        int inLinks;
+        uint64_t sequence;
+    };
+
+    struct SeenStripe {
+        std::mutex mutex;
+        FingerprintSet hostnames;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::unique_ptr<SeenStripe>> seenStripes;
+    std::unique_ptr<BloomFilter> seenFilter;
+
+    Order order;
+    std::mutex priorityMutex;
+    IndexedHeap<PrioritySite> priorityQueue;
+    std::unordered_map<std::string, double> domainResponseTimes;
+    uint64_t nextSequence;
+
+    size_t memoryLimit;
+    std::atomic<long> memoryBytes; // estimated memory used by the sites in the deques
+    std::unique_ptr<SpillQueue> spillQueue;
+
+    std::atomic<long> pendingSites; // may briefly dip below zero while a push is being published
+    std::atomic<long> outstandingSites;
+    std::atomic<bool> closed;
+
+    std::function<void(bool)> wakeListener;
+
+    void wakeWorkers(bool all);
+    bool refill(size_t worker);
+    void pushMemory(size_t worker, Site site);
+    bool popMemory(size_t worker, Site& site);
+    double getPriority(const PrioritySite& site);
+};
+
+#endif // FRONTIER_H
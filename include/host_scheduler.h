@@ -0,0 +1,59 @@
+#ifndef HOST_SCHEDULER_H
+#define HOST_SCHEDULER_H
+
+#include "socket.h"
+#include "timer_wheel.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class HostScheduler {
+public:
+    struct Host {
+        std::unique_ptr<Socket> socket;
+        int depth;
+        size_t shard; // the shard that owns the host, see admit()
+    };
+
+    enum class Work { Fetch, StartSite, Finished };
+
+    HostScheduler(int maxActiveHosts, int workerCount);
+
+    HostScheduler(const HostScheduler&) = delete;
+    HostScheduler& operator=(const HostScheduler&) = delete;
+
+    Work waitForWork(size_t worker, Host*& host, const std::function<bool()>& hasNewSites, const std::function<bool()>& isFinished);
+    Host* admit(size_t worker, std::unique_ptr<Socket> socket, int depth);
+    void schedule(size_t worker, Host* host, int delayMs);
+    void retire(Host* host);
+    void releaseSlot();
+    void notify(bool wakeAll);
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        TimerWheel wheel;
+        std::deque<Host*> readyHosts;
+        std::unordered_map<Host*, std::unique_ptr<Host>> hosts;
+    };
+
+    int maxActiveHosts;
+    std::atomic<int> activeHosts;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    std::mutex idleMutex;
+    std::condition_variable idleCondVar;
+    std::atomic<int> idleWorkers;
+    uint64_t wakeups; // guarded by idleMutex
+
+    bool takeReady(Shard& shard, bool steal, Host*& host, int& timeoutMs);
+    bool reserveSlot();
+    void wakeIdle(bool wakeAll);
+};
+
+#endif // HOST_SCHEDULER_H
@@ -0,0 +1,56 @@
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <string>
+#include <cstddef>
+#include <functional>
+
+class HttpResponseParser {
+public:
+    using BodyHandler = std::function<void(const char* data, size_t length)>;
+
+    HttpResponseParser();
+
+    void setBodyHandler(BodyHandler handler);
+    void reset();
+    size_t feed(const char* data, size_t length);
+    void finish();
+
+    bool isComplete() const { return state == State::Complete; }
+    bool hasError() const { return state == State::Error; }
+    bool isKeepAlive() const;
+    bool hasHeaders() const { return state != State::StatusLine && state != State::Headers; }
+    bool isHtml() const;
+    int getStatusCode() const { return statusCode; }
+    const std::string& getContentType() const { return contentType; }
+    const std::string& getContentEncoding() const { return contentEncoding; }
+    const std::string& getLocation() const { return location; }
+    int getRetryAfter() const { return retryAfter; }
+
+private:
+    enum class State { StatusLine, Headers, Body, ChunkSize, ChunkData, ChunkDataEnd, Trailers, UntilClose, Complete, Error };
+
+    State state;
+    std::string lineBuffer;
+    int statusCode;
+    bool http11;
+    bool connectionClose;
+    bool connectionKeepAlive;
+    bool chunked;
+    bool untilClose; // the body ends when the server closes the connection
+    long long contentLength;
+    long long remainingBytes;
+    std::string contentType;
+    std::string contentEncoding;
+    std::string location;
+    int retryAfter;
+    BodyHandler bodyHandler;
+
+    bool readLine(const char* data, size_t length, size_t& pos);
+    void parseStatusLine();
+    void parseHeaderLine();
+    void startBody();
+    void deliverBody(const char* data, size_t length);
+};
+
+#endif // HTTP_H
@@ -0,0 +1,115 @@
+#ifndef INDEXED_HEAP_H
+#define INDEXED_HEAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 4-ary max-heap of values keyed by a 64-bit id. The position of every key is tracked, so the score of a
+// queued value can be changed in O(log n).
+template <typename T>
+class IndexedHeap {
+public:
+    bool empty() const { return entries.empty(); }
+    size_t size() const { return entries.size(); }
+    bool contains(uint64_t key) const { return positions.count(key) > 0; }
+
+    void push(uint64_t key, double score, T value) {
+        positions[key] = entries.size();
+        entries.push_back(Entry{key, score, std::move(value)});
+        siftUp(entries.size() - 1);
+    }
+
+    // the value with the highest score
+    T pop() {
+        T value = std::move(entries.front().value);
+        positions.erase(entries.front().key);
+        if (entries.size() > 1) {
+            entries.front() = std::move(entries.back());
+            positions[entries.front().key] = 0;
+        }
+        entries.pop_back();
+        if (!entries.empty()) {
+            siftDown(0);
+        }
+        return value;
+    }
+
+    T* find(uint64_t key) {
+        auto it = positions.find(key);
+        return it == positions.end() ? nullptr : &entries[it->second].value;
+    }
+
+    void update(uint64_t key, double score) {
+        auto it = positions.find(key);
+        if (it == positions.end()) {
+            return;
+        }
+        size_t position = it->second;
+        double previousScore = entries[position].score;
+        entries[position].score = score;
+        if (score > previousScore) {
+            siftUp(position);
+        } else {
+            siftDown(position);
+        }
+    }
+
+private:
+    static const size_t ARITY = 4;
+
+    struct Entry {
+        uint64_t key;
+        double score;
+        T value;
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<uint64_t, size_t> positions;
+
+    void move(size_t from, size_t to) {
+        entries[to] = std::move(entries[from]);
+        positions[entries[to].key] = to;
+    }
+
+    void siftUp(size_t position) {
+        Entry entry = std::move(entries[position]);
+        while (position > 0) {
+            size_t parent = (position - 1) / ARITY;
+            if (entries[parent].score >= entry.score) {
+                break;
+            }
+            move(parent, position);
+            position = parent;
+        }
+        positions[entry.key] = position;
+        entries[position] = std::move(entry);
+    }
+
+    void siftDown(size_t position) {
+        Entry entry = std::move(entries[position]);
+        while (true) {
+            size_t first = position * ARITY + 1;
+            if (first >= entries.size()) {
+                break;
+            }
+            size_t best = first;
+            for (size_t child = first + 1; child < first + ARITY && child < entries.size(); child++) {
+                if (entries[child].score > entries[best].score) {
+                    best = child;
+                }
+            }
+            if (entries[best].score <= entry.score) {
+                break;
+            }
+            move(best, position);
+            position = best;
+        }
+        positions[entry.key] = position;
+        entries[position] = std::move(entry);
+    }
+};
+
+#endif // INDEXED_HEAP_H
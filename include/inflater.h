@@ -0,0 +1,45 @@
+#ifndef INFLATER_H
+#define INFLATER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <zlib.h>
+
+// Streaming decoder of gzip and deflate response bodies. The zlib contexts are pooled per thread, so a
+// worker reuses the same few contexts (and their 32 KiB windows) from one response to the next.
+class Inflater {
+public:
+    enum class Encoding { Identity, Gzip, Deflate, Unsupported };
+    using Output = std::function<void(const char* data, size_t length)>;
+
+    static Encoding parseEncoding(std::string_view contentEncoding);
+    static std::unique_ptr<Inflater> acquire(Encoding encoding);
+    static void release(std::unique_ptr<Inflater> inflater);
+
+    ~Inflater();
+
+    Inflater(const Inflater&) = delete;
+    Inflater& operator=(const Inflater&) = delete;
+
+    bool feed(const char* data, size_t length, const Output& output);
+    bool isFinished() const { return finished; }
+    size_t getOutputBytes() const { return outputBytes; }
+
+private:
+    z_stream stream;
+    bool initialized;
+    bool allowRawDeflate; // many servers send "deflate" without the zlib header
+    bool finished;
+    char header[2]; // the first bytes of the body, replayed if it turns out to be raw deflate
+    size_t inputBytes;
+    size_t outputBytes;
+    std::unique_ptr<char[]> outputBuffer;
+
+    Inflater();
+    bool reset(Encoding encoding);
+    int inflateInput(const char* data, size_t length, const Output& output);
+};
+
+#endif // INFLATER_H
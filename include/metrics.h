@@ -0,0 +1,106 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// Log-linear histogram of durations in microseconds: values below 32 are exact, larger values fall in one
+// of 16 sub-buckets per power of two (at most ~6% relative error). Written by a single thread, read by any.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t MAX_VALUE = (uint64_t(1) << 36) - 1; // ~19 hours
+    static constexpr size_t BUCKET_COUNT = (1 << SUB_BUCKET_BITS) + (36 - SUB_BUCKET_BITS) * (1 << (SUB_BUCKET_BITS - 1));
+
+    struct Snapshot {
+        std::array<uint64_t, BUCKET_COUNT> buckets{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        void merge(const Snapshot& other);
+        uint64_t getPercentile(double percentile) const;
+    };
+
+    LatencyHistogram();
+
+    void record(uint64_t micros);
+    void addTo(Snapshot& snapshot) const;
+
+    static size_t getBucket(uint64_t micros);
+    static uint64_t getBucketValue(size_t bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+};
+
+class Metrics {
+public:
+    enum class Stage { Dns, Connect, FirstByte, Download, Parse };
+    static constexpr size_t STAGE_COUNT = 5;
+
+    enum class Counter { Requests, Pages, FailedQueries, ReceivedBytes, DisallowedPages };
+    static constexpr size_t COUNTER_COUNT = 5;
+
+    struct Snapshot {
+        std::array<LatencyHistogram::Snapshot, STAGE_COUNT> stages;
+        std::array<uint64_t, COUNTER_COUNT> counters{};
+        double elapsedSeconds = 0;
+
+        void merge(const Snapshot& other);
+    };
+
+    Metrics();
+    ~Metrics();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    void record(Stage stage, std::chrono::steady_clock::duration duration);
+    void add(Counter counter, uint64_t value = 1);
+    Snapshot collect();
+
+    bool startExport(const std::string& path, int intervalMs);
+    void stopExport();
+    bool writePrometheus(const std::string& path);
+    static bool writePrometheus(const std::string& path, const Snapshot& snapshot);
+    void printSummary(std::ostream& out);
+
+    static const char* getStageName(Stage stage);
+
+private:
+    struct WorkerMetrics {
+        std::array<LatencyHistogram, STAGE_COUNT> stages;
+        std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters{};
+    };
+
+    uint64_t instanceId;
+    std::chrono::steady_clock::time_point startTime;
+    std::mutex workersMutex;
+    std::deque<std::unique_ptr<WorkerMetrics>> workers;
+
+    std::string exportPath;
+    int exportIntervalMs;
+    bool exportStopRequested;
+    std::mutex exportMutex;
+    std::condition_variable exportCondVar;
+    std::thread exporter;
+
+    WorkerMetrics& getWorkerMetrics();
+    void runExporter();
+};
+
+#endif // METRICS_H
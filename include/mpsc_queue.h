@@ -0,0 +1,53 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Unbounded lock-free multi-producer single-consumer queue (Vyukov). push() may be called from any
+// thread, pop() only from the consumer thread.
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head(new Node()), tail(head.load()) {}
+
+    ~MpscQueue() {
+        T value;
+        while (pop(value)) {}
+        delete tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        Node* node = new Node(std::move(value));
+        Node* previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T& value) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false; // empty, or a push is halfway through
+        }
+        value = std::move(next->value);
+        delete tail;
+        tail = next; // the popped node becomes the new stub
+        return true;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+
+        Node() = default;
+        explicit Node(T value) : value(std::move(value)) {}
+    };
+
+    std::atomic<Node*> head;
+    Node* tail;
+};
+
+#endif // MPSC_QUEUE_H
@@ -2,12 +2,52 @@
 #define PARSER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "arena.h"
 
-std::string getHostnameFromUrl(const std::string& url);
+class LinkExtractor {
+public:
+    struct Link {
+        std::string_view host;
+        std::string_view path;
+    };
+
+    explicit LinkExtractor(std::string_view baseUrl = "");
+
+    void reset(std::string_view baseUrl);
+    void feed(const char* data, size_t length, std::vector<Link>& links);
+    void finish(std::vector<Link>& links);
+    bool resolve(std::string_view link, Link& resolved);
+
+private:
+    enum class State { Scanning, CssLinkStart, ReadingLink };
+
+    std::string baseHost;
+    Arena arena;
+    State state;
+    uint16_t matcherState;
+    std::string pendingLink;
+    bool linkTooLong;
+
+    void completeLink(std::string_view link, std::vector<Link>& links);
+};
+
+std::string_view getHostnameFromUrl(std::string_view url);
+
+std::string_view getHostPathFromUrl(std::string_view url);
+
+std::string normalizeUrl(std::string_view url);
+
+bool resolveLink(std::string_view link, std::string_view baseHost, Arena& arena, LinkExtractor::Link& resolved);
 
 std::vector<std::pair<std::string, std::string>> extractUrls(const std::string& httpText, const std::string& baseUrl);
 
-bool verifyUrl(const std::string& url);
+bool verifyUrl(std::string_view url);
+
+// legacy pre-pass of the old extraction pipeline, unused by the crawler and kept as the benchmark baseline
+std::string reformatHttpResponse(const std::string& httpText);
 
-#endif // PARSER_H
\ No newline at end of file
+#endif // PARSER_H
@@ -0,0 +1,11 @@
+#ifndef PUBLIC_SUFFIX_H
+#define PUBLIC_SUFFIX_H
+
+#include <cstddef>
+#include <string_view>
+
+size_t getPublicSuffixLabels(const char* host, size_t length);
+bool hasRegistrableDomain(std::string_view host);
+std::string_view getRegistrableDomain(std::string_view host);
+
+#endif // PUBLIC_SUFFIX_H
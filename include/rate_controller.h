@@ -0,0 +1,31 @@
+#ifndef RATE_CONTROLLER_H
+#define RATE_CONTROLLER_H
+
+// AIMD controller of the request rate of one host: the rate grows by a fixed step while the response times
+// stay near their baseline, and is halved when they rise, on failures and on 429/503 responses.
+class RateController {
+public:
+    struct Limits {
+        int minDelayMs = 0;
+        int maxDelayMs = 30000;
+    };
+
+    RateController(int initialDelayMs, const Limits& limits);
+
+    void setMinDelay(int delayMs);
+    void onResponse(double responseTimeMs);
+    void onOverload(int retryAfterSeconds = -1);
+    int getDelayMs() const;
+
+private:
+    Limits limits;
+    double rate; // requests per second
+    double baselineMs;
+    double recentMs;
+    int samples;
+
+    void decrease();
+    void clampRate();
+};
+
+#endif // RATE_CONTROLLER_H
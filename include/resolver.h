@@ -0,0 +1,74 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <sys/socket.h>
+
+class Resolver {
+public:
+    struct Address {
+        struct sockaddr_storage storage;
+        socklen_t length;
+    };
+
+    struct Resolution {
+        int status = 0; // 0 on success, a getaddrinfo EAI_* code otherwise
+        std::string error;
+        std::vector<Address> addresses;
+    };
+
+    using Callback = std::function<void(const Resolution&)>;
+
+    Resolver(int threadCount = 4, int cacheTtlSeconds = 300, int negativeTtlSeconds = 60, size_t cacheCapacity = 100000);
+    ~Resolver();
+
+    Resolver(const Resolver&) = delete;
+    Resolver& operator=(const Resolver&) = delete;
+
+    bool lookupCached(const std::string& hostname, Resolution& resolution);
+    void resolveAsync(const std::string& hostname, Callback callback);
+    Resolution resolve(const std::string& hostname);
+    void setOverride(const Address& address);
+
+    static Resolution resolveUncached(const std::string& hostname);
+    static bool parseAddress(const std::string& text, Address& address, int& port);
+    static void setPort(Address& address, int port);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct CacheEntry {
+        std::string hostname;
+        Resolution resolution;
+        Clock::time_point expiresAt;
+    };
+
+    std::chrono::seconds cacheTtl;
+    std::chrono::seconds negativeTtl;
+    size_t cacheCapacity;
+    bool hasOverride;
+    Resolution overrideResolution;
+
+    std::mutex resolverMutex;
+    std::condition_variable jobsCondVar;
+    std::list<CacheEntry> cache; // most recently used first
+    std::unordered_map<std::string, std::list<CacheEntry>::iterator> cacheIndex;
+    std::unordered_map<std::string, std::vector<Callback>> inFlight;
+    std::deque<std::string> jobs;
+    bool isShuttingDown;
+    std::vector<std::thread> threads;
+
+    void runWorker();
+    void insertCached(const std::string& hostname, const Resolution& resolution, Clock::time_point expiresAt);
+};
+
+#endif // RESOLVER_H
@@ -0,0 +1,145 @@
+#ifndef RESULT_FORMAT_H
+#define RESULT_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "socket.h"
+
+// Layout of a results file (little-endian, every section aligned to 4 bytes):
+//   header:  "THREADR1", uint32 version, uint32 reserved
+//   blocks:  BlockHeader, the strings first used in the block (lengths, then bytes), the per-site columns
+//            (host id, depth, failed queries, min/max/avg response time, page end, link end), the per-page
+//            columns (path id, response time) and the linked site ids
+//   footer:  one BlockIndexEntry per block, then the FileTrailer
+// Strings are numbered across the whole file, in order of first use. Response times are float
+// milliseconds, NaN when the site has no page.
+
+const char RESULT_FILE_MAGIC[8] = {'T', 'H', 'R', 'E', 'A', 'D', 'R', '1'};
+const char RESULT_INDEX_MAGIC[8] = {'T', 'H', 'R', 'I', 'N', 'D', 'E', 'X'};
+const uint32_t RESULT_BLOCK_MAGIC = 0x314b4c42; // "BLK1"
+const uint32_t RESULT_FORMAT_VERSION = 1;
+
+struct ResultBlockHeader {
+    uint32_t magic;
+    uint32_t blockSize;
+    uint32_t siteCount;
+    uint32_t pageCount;
+    uint32_t linkCount;
+    uint32_t stringCount;
+    uint32_t stringBytes;
+    uint32_t firstStringId;
+};
+
+struct ResultBlockIndexEntry {
+    uint64_t offset;
+    uint32_t siteCount;
+    uint32_t pageCount;
+};
+
+struct ResultFileTrailer {
+    uint64_t indexOffset;
+    uint32_t blockCount;
+    uint32_t stringCount;
+    char magic[8];
+};
+
+class ResultFileWriter {
+public:
+    explicit ResultFileWriter(size_t sitesPerBlock = 1024);
+    ~ResultFileWriter();
+
+    ResultFileWriter(const ResultFileWriter&) = delete;
+    ResultFileWriter& operator=(const ResultFileWriter&) = delete;
+
+    bool open(const std::string& path, bool append = false);
+    bool isOpen() const;
+    void append(const Socket::SiteStats& stats, int depth);
+    bool flush();
+    bool close();
+
+private:
+    size_t sitesPerBlock;
+    std::unique_ptr<char[]> fileBuffer;
+    std::ofstream file;
+    uint64_t fileOffset;
+    std::vector<ResultBlockIndexEntry> blockIndex;
+
+    std::unordered_map<std::string, uint32_t> stringIds;
+    uint32_t stringCount;
+    uint32_t blockFirstStringId;
+    std::vector<uint32_t> newStringLengths;
+    std::string newStringBytes;
+
+    std::vector<uint32_t> hostIds;
+    std::vector<int32_t> depths;
+    std::vector<uint32_t> failedQueries;
+    std::vector<float> minResponseTimes;
+    std::vector<float> maxResponseTimes;
+    std::vector<float> averageResponseTimes;
+    std::vector<uint32_t> pageEnds;
+    std::vector<uint32_t> linkEnds;
+    std::vector<uint32_t> pathIds;
+    std::vector<float> pageResponseTimes;
+    std::vector<uint32_t> linkedHostIds;
+
+    uint32_t getStringId(std::string_view text);
+    void clearBlock();
+    void write(const void* data, size_t size);
+};
+
+struct ResultRecord {
+    std::string_view hostname;
+    int depth;
+    uint32_t failedQueries;
+    float minResponseTime;
+    float maxResponseTime;
+    float averageResponseTime;
+    std::vector<std::pair<std::string_view, float>> pages; // paths, relative to the hostname
+    std::vector<std::string_view> linkedSites;
+};
+
+class ResultFileReader {
+public:
+    ResultFileReader();
+    ~ResultFileReader();
+
+    ResultFileReader(const ResultFileReader&) = delete;
+    ResultFileReader& operator=(const ResultFileReader&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool hasIndex() const;
+    size_t siteCount() const;
+    size_t stringCount() const { return strings.size(); }
+    uint64_t getDataEnd() const;
+    std::vector<ResultBlockIndexEntry> getBlockIndex() const;
+    void forEachSite(const std::function<void(const ResultRecord&)>& visit) const;
+
+private:
+    struct Block {
+        uint64_t offset;
+        const char* columns;
+        ResultBlockHeader header;
+    };
+
+    const char* data;
+    size_t size;
+    bool indexed;
+    size_t sites;
+    std::vector<Block> blocks;
+    std::vector<std::string_view> strings;
+
+    bool readBlock(uint64_t offset, uint64_t end);
+    bool readIndex();
+    void scanBlocks();
+};
+
+#endif // RESULT_FORMAT_H
@@ -0,0 +1,59 @@
+#ifndef RESULT_SINK_H
+#define RESULT_SINK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mpsc_queue.h"
+#include "result_format.h"
+#include "socket.h"
+
+class ResultSink {
+public:
+    explicit ResultSink(bool consoleOutput, int flushIntervalMs = 1000);
+    ~ResultSink();
+
+    bool openCsv(const std::string& path, bool append = false);
+    bool openBinary(const std::string& path, bool append = false);
+    void setWrittenListener(std::function<void(const std::string&)> listener);
+    void start();
+    void submit(Socket::SiteStats stats, int depth);
+    void stop();
+
+private:
+    struct SiteResult {
+        Socket::SiteStats stats;
+        int depth = 0;
+    };
+
+    bool consoleOutput;
+    int flushIntervalMs;
+
+    MpscQueue<SiteResult> queue;
+    std::atomic<bool> writerWaiting;
+    std::atomic<bool> stopRequested;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondVar;
+    std::thread writer;
+
+    std::unique_ptr<char[]> csvBuffer;
+    std::ofstream csvFile;
+    std::string csvText;
+    std::string consoleText;
+    ResultFileWriter binaryFile;
+
+    std::function<void(const std::string&)> writtenListener;
+    std::vector<std::string> writtenSites;
+
+    void runWriter();
+    void formatConsole(const SiteResult& result);
+    void formatCsv(const SiteResult& result);
+};
+
+#endif // RESULT_SINK_H
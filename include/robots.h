@@ -0,0 +1,68 @@
+#ifndef ROBOTS_H
+#define ROBOTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The Allow/Disallow rules and the Crawl-delay that robots.txt sets for one user agent (RFC 9309). Plain
+// prefix rules are compiled into a byte trie, rules with `*` or `$` are matched one by one, longest first.
+class RobotsRules {
+public:
+    RobotsRules();
+
+    static RobotsRules parse(std::string_view text, std::string_view productToken);
+    static std::shared_ptr<const RobotsRules> getAllowAll();
+    static std::shared_ptr<const RobotsRules> getDisallowAll();
+
+    bool isAllowed(std::string_view path) const;
+    int getCrawlDelayMs() const { return crawlDelayMs; }
+
+private:
+    struct TrieNode {
+        int32_t firstChild;
+        int32_t nextSibling;
+        char byte;
+        int8_t rule; // -1 without rule, 0 for Disallow, 1 for Allow
+    };
+
+    struct PatternRule {
+        std::string pattern;
+        bool allow;
+    };
+
+    std::vector<TrieNode> trie;
+    std::vector<PatternRule> patternRules; // longest first
+    int crawlDelayMs;
+
+    void addRule(std::string_view pattern, bool allow);
+    static bool matchesPattern(std::string_view pattern, std::string_view path);
+};
+
+// Compiled robots.txt rules of the most recently crawled hosts, shared by every worker.
+class RobotsCache {
+public:
+    explicit RobotsCache(size_t capacity = 100000);
+
+    RobotsCache(const RobotsCache&) = delete;
+    RobotsCache& operator=(const RobotsCache&) = delete;
+
+    std::shared_ptr<const RobotsRules> lookup(const std::string& hostname);
+    void insert(const std::string& hostname, std::shared_ptr<const RobotsRules> rules);
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const RobotsRules>>;
+
+    size_t capacity;
+    std::mutex cacheMutex;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+};
+
+#endif // ROBOTS_H
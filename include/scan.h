@@ -0,0 +1,24 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+class ByteSet {
+public:
+    explicit ByteSet(const std::string& bytes);
+
+    bool contains(unsigned char byte) const { return table[byte]; }
+    const std::string& getBytes() const { return bytes; }
+
+private:
+    std::string bytes;
+    std::array<bool, 256> table;
+};
+
+size_t findFirstOf(const char* data, size_t length, const ByteSet& set);
+void toLowerAscii(char* data, size_t length);
+const char* getScanKernelName();
+
+#endif // SCAN_H
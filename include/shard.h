@@ -0,0 +1,144 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+#include "event_loop.h"
+#include "metrics.h"
+#include "socket.h"
+
+class ResultSink;
+
+// Messages exchanged between the coordinator and the shards over a stream socket, every one framed as
+// uint32 payload size, uint8 type, payload (little-endian). See shard.cpp for the payloads.
+enum class ShardMessage : uint8_t { Hello = 1, Sites = 2, Result = 3, Status = 4, Stop = 5, Metrics = 6 };
+
+int getShardOwner(std::string_view hostname, int shardCount);
+
+// Connection of a shard process to the coordinator: forwards the sites owned by other shards and the
+// results in batches, receives the sites it owns, and reports when it runs out of work (and its metrics).
+class ShardClient {
+public:
+    using Site = std::pair<std::string, int>;
+
+    ShardClient(int shardIndex, int shardCount);
+    ~ShardClient();
+
+    ShardClient(const ShardClient&) = delete;
+    ShardClient& operator=(const ShardClient&) = delete;
+
+    bool connectTo(const std::string& path);
+    void reportMetrics(Metrics* metrics, int intervalMs);
+    void start(std::function<void(std::vector<Site>&)> onSites, std::function<void()> onStop, std::function<bool()> isIdle);
+    void forwardSite(const std::string& hostname, int depth);
+    void submitResult(const Socket::SiteStats& stats, int depth);
+    void finish();
+
+private:
+    int shardIndex;
+    int shardCount;
+    int fd;
+    Metrics* metrics;
+    int metricsIntervalMs;
+
+    std::function<void(std::vector<Site>&)> onSites;
+    std::function<void()> onStop;
+    std::function<bool()> isIdle;
+
+    std::mutex outputMutex;
+    std::condition_variable outputCondVar;
+    std::string pendingSites; // payload of the next Sites message, without its count
+    uint32_t pendingSiteCount;
+    std::string pendingOutput; // complete messages
+    bool finishRequested;
+    std::atomic<uint64_t> receivedSites;
+    std::atomic<bool> stopped; // onStop() was called
+
+    std::thread reader;
+    std::thread sender;
+
+    void runReader();
+    void runSender();
+    bool writeAll(const std::string& data);
+};
+
+// Coordinator of a sharded crawl: starts the shard processes, routes the sites between them, merges their
+// results into one result sink (and their metrics into one metrics file) and stops them once none has
+// work left and no site is in flight.
+class ShardCoordinator {
+public:
+    explicit ShardCoordinator(int shardCount);
+    ~ShardCoordinator();
+
+    ShardCoordinator(const ShardCoordinator&) = delete;
+    ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+
+    bool listen(const std::string& path);
+    bool exportMetrics(const std::string& path, int intervalMs);
+    bool spawn(const std::function<int(int)>& runShard);
+    void addSite(const std::string& hostname, int depth);
+    bool run(ResultSink& sink);
+
+    uint64_t getRoutedSites() const { return routedSites; }
+    uint64_t getResultCount() const { return resultCount; }
+
+private:
+    class Connection;
+
+    struct Shard {
+        pid_t pid = -1;
+        Connection* connection = nullptr;
+        std::string output; // messages queued before the shard connected
+        uint64_t forwardedSites = 0;
+        uint64_t receivedSites = 0;
+        Metrics::Snapshot metrics; // the latest reported by the shard
+        bool idle = false;
+        bool closed = false;
+    };
+
+    class Listener : public EventHandler {
+    public:
+        explicit Listener(ShardCoordinator& coordinator) : coordinator(coordinator) {}
+        void handleEvent(uint32_t events) override;
+
+    private:
+        ShardCoordinator& coordinator;
+    };
+
+    int shardCount;
+    std::string path;
+    int listenFd;
+    EventLoop loop;
+    Listener listener;
+    std::vector<Shard> shards;
+    std::vector<std::unique_ptr<Connection>> connections;
+    ResultSink* sink;
+    bool stopping;
+    bool failed;
+    uint64_t routedSites;
+    uint64_t resultCount;
+    std::string metricsPath;
+    int metricsIntervalMs;
+
+    void accept();
+    void handleMessage(Connection& connection, ShardMessage type, std::string_view payload);
+    void handleClose(Connection& connection);
+    void send(int shard, const std::string& message);
+    void checkTermination();
+    void checkChildren();
+    void stopShards();
+    bool writeMetrics();
+    void updateMetrics();
+};
+
+#endif // SHARD_H
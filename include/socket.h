@@ -4,10 +4,21 @@
 #include <string>
 #include <vector>
 #include <queue>
-#include <unordered_map>
 #include <chrono>
+#include <functional>
+#include <memory>
+#include "event_loop.h"
+#include "connection_pool.h"
+#include "http.h"
+#include "resolver.h"
+#include "fingerprint.h"
+#include "parser.h"
+#include "metrics.h"
+#include "robots.h"
+#include "rate_controller.h"
+#include "inflater.h"
 
-class Socket {
+class Socket : public EventHandler {
 public:
     struct SiteStats {
         std::string hostname;
@@ -19,28 +30,112 @@ public:
         double averageResponseTime = -1;
     };
 
-    Socket(std::string hostname, int port, int pageLimit, int crawlDelay);
-    SiteStats initiateDiscovery();
+    struct Services {
+        ConnectionPool* connectionPool;
+        Resolver* resolver;
+        Metrics* metrics;
+        RobotsCache* robotsCache;
+        const RateController::Limits* rateLimits; // nullptr for a fixed crawl delay
+
+        Services() : connectionPool(nullptr), resolver(nullptr), metrics(nullptr), robotsCache(nullptr), rateLimits(nullptr) {}
+    };
+
+    Socket(std::string hostname, int port, int pageLimit, int crawlDelay, long long maxBodySize = -1, const Services& services = Services());
+    bool hasPendingPages() const;
+    int getCrawlDelay() const { return rateController ? rateController->getDelayMs() : crawlDelay; }
+    void crawlNextPage();
+    SiteStats finishDiscovery();
+    void initiateDiscoveryAsync(EventLoop* loop, std::function<void(SiteStats&)> onComplete);
+    void handleEvent(uint32_t events) override;
 
 private:
     std::string hostname;
     int port;
     int pageLimit;
     int crawlDelay;
+    long long maxBodySize;
+    int requestedPages = 0;
+    long long bodyBytes = 0;
+    std::unique_ptr<Inflater> inflater; // while the body of the current response is compressed
+    bool responseAborted = false;
     int sock;
+    ConnectionPool* connectionPool;
+    Resolver* resolver;
+    Metrics* metrics;
+    RobotsCache* robotsCache;
+    std::shared_ptr<const RobotsRules> robotsRules;
+    bool fetchingRobots = false;
+    std::string robotsBody;
+    int sentRequests = 0;
+    std::unique_ptr<RateController> rateController;
+    bool reusedConnection = false;
+    HttpResponseParser responseParser;
+    LinkExtractor linkExtractor;
+    std::vector<LinkExtractor::Link> extractedLinks;
 
     std::queue<std::string> pendingPages;
-    std::unordered_map<std::string, bool> discoveredPages;
-    std::unordered_map<std::string, bool> discoveredLinkedSites;
+    FingerprintSet discoveredPages;
+    FingerprintSet discoveredLinkedSites;
+    SiteStats siteStats;
+
+    enum class AsyncState { Idle, Resolving, Connecting, Sending, Receiving };
 
-    std::string startConnection();
+    EventLoop* loop = nullptr;
+    std::function<void(SiteStats&)> onComplete;
+    AsyncState asyncState = AsyncState::Idle;
+    std::string currentPath;
+    std::string pendingRequest;
+    size_t requestOffset = 0;
+    size_t pendingResponseBytes = 0;
+    double pendingResponseTime = -1;
+    uint64_t timeoutTimer = 0;
+    std::vector<Resolver::Address> resolvedAddresses;
+    size_t nextAddress = 0;
+    std::chrono::high_resolution_clock::time_point pageStartTime;
+    std::chrono::steady_clock::time_point lastActivityTime;
+
+    std::chrono::steady_clock::time_point stageStartTime;
+    std::chrono::steady_clock::time_point requestSentTime;
+    std::chrono::steady_clock::time_point firstByteTime;
+    std::chrono::steady_clock::duration parseTime{};
+    bool receivedFirstByte = false;
+
+    std::string resolveHostname(Resolver::Resolution& resolution);
+    std::string startConnection(bool allowReuse = true);
     std::string closeConnection();
+    void releaseConnection();
     std::string createHttpRequest(std::string host, std::string path);
     void handlePageCrawl(const std::string& path, SiteStats& stats);
-    bool sendRequest(const std::string& request, SiteStats& stats);
-    double receiveResponse(std::string& response, const std::chrono::high_resolution_clock::time_point& startTime);
-    void processResponse(const std::string& response, SiteStats& stats);
+    bool needsRobots() const { return robotsCache != nullptr && !robotsRules; }
+    void finishRobots(int statusCode);
+    void applyRobots(std::shared_ptr<const RobotsRules> rules);
+    void queuePage(std::string path);
+    bool sendRequest(const std::string& request, SiteStats& stats, bool countFailure = true);
+    double receiveResponse(size_t& receivedBytes, const std::chrono::high_resolution_clock::time_point& startTime);
+    void startResponse();
+    void feedResponse(const char* data, size_t length);
+    void processBody(const char* data, size_t length);
+    void consumeBody(const char* data, size_t length);
+    void finishResponse(const std::string& path, double responseTime, SiteStats& stats);
+    void enqueueLinks(SiteStats& stats);
     void computeStats(SiteStats& stats);
+    void recordStage(Metrics::Stage stage, std::chrono::steady_clock::time_point startTime);
+    void countFailedQuery(SiteStats& stats);
+
+    void crawlNextPageAsync();
+    void startPageAsync();
+    void connectPageAsync(bool allowReuse);
+    void handleResolvedAsync(const Resolver::Resolution& resolution);
+    void connectNextAddressAsync();
+    std::string startConnectionAsync(Resolver::Address address);
+    void armTimeoutAsync(int delayMs);
+    void handleConnectAsync(uint32_t events);
+    void handleSendAsync();
+    void handleReceiveAsync();
+    void failPageAsync(const std::string& error);
+    void retryPageAsync();
+    void finishPageAsync();
+    void releaseConnectionAsync();
 };
 
 #endif // SOCKET_H
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef SPILL_QUEUE_H
+#define SPILL_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class SpillQueue {
+public:
+    using Site = std::pair<std::string, int>;
+
+    explicit SpillQueue(size_t segmentBytes = 1 << 20);
+    ~SpillQueue();
+
+    SpillQueue(const SpillQueue&) = delete;
+    SpillQueue& operator=(const SpillQueue&) = delete;
+
+    bool open(const std::string& parentDirectory);
+    bool push(const Site& site);
+    size_t popBatch(std::vector<Site>& sites, size_t& lostSites);
+    size_t size() const { return count.load(); }
+
+private:
+    size_t segmentBytes;
+    std::string directory;
+
+    std::mutex mutex;
+    std::deque<std::pair<std::string, size_t>> segments; // paths and site counts, oldest first
+    std::string tail; // encoded sites not yet written to a segment
+    size_t tailCount;
+    size_t nextSegment;
+    std::atomic<size_t> count;
+
+    bool writeTail();
+};
+
+#endif // SPILL_QUEUE_H
@@ -0,0 +1,45 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <unordered_set>
+#include <chrono>
+
+class TimerWheel {
+public:
+    using Task = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    TimerWheel();
+
+    uint64_t schedule(int delayMs, Task task);
+    void cancel(uint64_t timerId);
+    void advance(Clock::time_point now, std::vector<Task>& expired);
+    int nextTimeoutMs(Clock::time_point now) const;
+    bool empty() const { return pendingIds.empty(); }
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 8;
+    static const int SLOTS = 1 << SLOT_BITS;
+
+    struct Timer {
+        uint64_t id;
+        uint64_t expiryTick;
+        Task task;
+    };
+
+    Clock::time_point origin;
+    uint64_t currentTick;
+    uint64_t nextTimerId;
+    std::vector<Timer> slots[LEVELS][SLOTS];
+    std::unordered_set<uint64_t> pendingIds;
+
+    uint64_t toTick(Clock::time_point time) const;
+    void place(Timer timer);
+    void cascade(int level);
+};
+
+#endif // TIMER_WHEEL_H
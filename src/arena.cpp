@@ -0,0 +1,94 @@
+/**
+ * @file arena.cpp
+ * @brief Implementation of a bump allocator for short-lived strings.
+ *
+ * The URLs resolved while parsing a page only live until the page has been processed. Instead of one
+ * heap allocation per string, they are carved out of large blocks by bumping an offset, and the whole
+ * arena is released at once with reset(). The blocks are kept, so once warmed up, parsing a page does not
+ * allocate at all.
+ */
+
+#include "arena.h"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Creates an empty arena.
+ *
+ * @param blockSize The size of the blocks the arena allocates from the heap.
+ */
+Arena::Arena(size_t blockSize) : blockSize(blockSize), currentBlock(0), offset(0) {}
+
+/**
+ * @brief Allocates uninitialized memory that stays valid until the next reset().
+ *
+ * @param size The number of bytes.
+ * @return The allocated memory.
+ */
+char* Arena::allocate(size_t size) {
+    while (currentBlock < blocks.size()) {
+        Block& block = blocks[currentBlock];
+        if (block.size - offset >= size) {
+            char* data = block.data.get() + offset;
+            offset += size;
+            return data;
+        }
+        currentBlock++;
+        offset = 0;
+    }
+
+    Block block;
+    block.size = std::max(blockSize, size);
+    block.data.reset(new char[block.size]);
+    blocks.push_back(std::move(block));
+    currentBlock = blocks.size() - 1;
+    offset = size;
+    return blocks.back().data.get();
+}
+
+/**
+ * @brief Gives back the unused end of the last allocation, e.g. once a string turned out shorter than
+ *        the space reserved for it. Does nothing if another allocation was made since.
+ *
+ * @param data The memory returned by the last call to allocate().
+ * @param size The size that was allocated.
+ * @param usedSize The number of bytes actually used.
+ */
+void Arena::shrinkLast(char* data, size_t size, size_t usedSize) {
+    if (currentBlock < blocks.size() && data + size == blocks[currentBlock].data.get() + offset && usedSize <= size) {
+        offset -= size - usedSize;
+    }
+}
+
+/**
+ * @brief Copies a string into the arena.
+ *
+ * @param text The string to copy.
+ * @return A view of the copy, valid until the next reset().
+ */
+std::string_view Arena::copy(std::string_view text) {
+    char* data = allocate(text.size());
+    memcpy(data, text.data(), text.size());
+    return std::string_view(data, text.size());
+}
+
+/**
+ * @brief Releases every allocation at once. The blocks are kept for reuse.
+ */
+void Arena::reset() {
+    currentBlock = 0;
+    offset = 0;
+}
+
+/**
+ * @brief Returns the total size of the blocks held by the arena.
+ *
+ * @return The capacity in bytes.
+ */
+size_t Arena::capacity() const {
+    size_t total = 0;
+    for (const auto& block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
@@ -0,0 +1,322 @@
+/**
+ * @file checkpoint.cpp
+ * @brief Implementation of the crawl checkpoint, a log of the frontier that a crawl can resume from.
+ *
+ * The checkpoint is log-structured: every site pushed to the frontier is appended as a "discovered"
+ * record (hostname and depth), and every site whose results were written as a "completed" record
+ * (fingerprint of the hostname). Workers only push the records to a lock-free queue; a background thread
+ * encodes them, appends them to the file and syncs it every `flushIntervalMs`. The thread also keeps the
+ * state the log describes, so once the log has grown to twice the size of that state, it rewrites the
+ * state as a new compacted log next to the old one and atomically renames it over it.
+ *
+ * On resume, the log is mapped and replayed: the discovered and completed hostnames are marked as seen,
+ * and the sites that were discovered but not completed are crawled again. Records cut short by a crash
+ * are ignored.
+ */
+
+#include "checkpoint.h"
+#include "fingerprint.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char CHECKPOINT_MAGIC[8] = {'T', 'H', 'R', 'C', 'K', 'P', 'T', '1'};
+const char RECORD_DISCOVERED = 'D';
+const char RECORD_COMPLETED = 'C';
+const size_t CHECKPOINT_WRITE_SIZE = 1 << 20;
+const uint64_t COMPACTION_MIN_BYTES = 64 << 20;
+
+static void appendValue(std::string& buffer, const void* value, size_t size) {
+    buffer.append(static_cast<const char*>(value), size);
+}
+
+static void encodeDiscovered(std::string& buffer, uint64_t fingerprint, const std::string& hostname, int depth) {
+    int32_t recordDepth = depth;
+    uint16_t length = static_cast<uint16_t>(std::min<size_t>(hostname.size(), UINT16_MAX));
+    buffer.push_back(RECORD_DISCOVERED);
+    appendValue(buffer, &fingerprint, sizeof(fingerprint));
+    appendValue(buffer, &recordDepth, sizeof(recordDepth));
+    appendValue(buffer, &length, sizeof(length));
+    buffer.append(hostname.data(), length);
+}
+
+static void encodeCompleted(std::string& buffer, uint64_t fingerprint) {
+    buffer.push_back(RECORD_COMPLETED);
+    appendValue(buffer, &fingerprint, sizeof(fingerprint));
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+/**
+ * @brief Constructs a Checkpoint object, which does nothing until open() is called.
+ *
+ * @param flushIntervalMs The interval in milliseconds at which the log is synced to disk.
+ */
+Checkpoint::Checkpoint(int flushIntervalMs)
+    : flushIntervalMs(std::max(1, flushIntervalMs)), fd(-1), logBytes(0), compactedBytes(0), stopRequested(false) {}
+
+Checkpoint::~Checkpoint() {
+    stop();
+}
+
+/**
+ * @brief Replays a checkpoint log.
+ *
+ * @param path The path of the checkpoint.
+ * @param state Receives the completed sites and the sites left to crawl, shallowest first.
+ * @return True if the checkpoint was read, false if it does not exist or is not a checkpoint.
+ */
+bool Checkpoint::load(const std::string& path, State& state) {
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(sizeof(CHECKPOINT_MAGIC))) {
+        ::close(file);
+        return false;
+    }
+    size_t size = static_cast<size_t>(fileStat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    const char* data = static_cast<const char*>(mapping);
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    if (std::memcmp(data, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        munmap(mapping, size);
+        return false;
+    }
+
+    std::unordered_map<uint64_t, Site> pending;
+    state.completedSites.clear();
+    size_t offset = sizeof(CHECKPOINT_MAGIC);
+    while (offset < size) {
+        char type = data[offset];
+        uint64_t fingerprint;
+        if (type == RECORD_COMPLETED && size - offset >= 9) {
+            std::memcpy(&fingerprint, data + offset + 1, sizeof(fingerprint));
+            pending.erase(fingerprint);
+            state.completedSites.push_back(fingerprint);
+            offset += 9;
+        } else if (type == RECORD_DISCOVERED && size - offset >= 15) {
+            int32_t depth;
+            uint16_t length;
+            std::memcpy(&fingerprint, data + offset + 1, sizeof(fingerprint));
+            std::memcpy(&depth, data + offset + 9, sizeof(depth));
+            std::memcpy(&length, data + offset + 13, sizeof(length));
+            if (size - offset - 15 < length) {
+                break; // cut short by a crash
+            }
+            pending[fingerprint] = std::make_pair(std::string(data + offset + 15, length), depth);
+            offset += 15 + length;
+        } else {
+            break;
+        }
+    }
+    munmap(mapping, size);
+
+    state.pendingSites.clear();
+    for (auto& entry : pending) {
+        state.pendingSites.push_back(std::move(entry.second));
+    }
+    std::sort(state.pendingSites.begin(), state.pendingSites.end(), [](const Site& a, const Site& b) {
+        return a.second != b.second ? a.second < b.second : a.first < b.first;
+    });
+    return true;
+}
+
+/**
+ * @brief Writes the given state as a new checkpoint and starts the background writer.
+ *
+ * @param path The path of the checkpoint, replaced atomically.
+ * @param state The state to start from, empty for a new crawl.
+ * @return True if the checkpoint was written, otherwise false.
+ */
+bool Checkpoint::open(const std::string& path, const State& state) {
+    this->path = path;
+    completedSites = state.completedSites;
+    pendingSites.clear();
+    for (auto& site : state.pendingSites) {
+        pendingSites[getUrlFingerprint(site.first)] = site;
+    }
+
+    if (!compact()) {
+        return false;
+    }
+    stopRequested = false;
+    writer = std::thread(&Checkpoint::runWriter, this);
+    return true;
+}
+
+/**
+ * @brief Logs a site pushed to the frontier. Never blocks on I/O, safe to call from any thread.
+ *
+ * @param hostname The hostname of the site.
+ * @param depth The depth of the site.
+ */
+void Checkpoint::recordDiscovered(const std::string& hostname, int depth) {
+    Record record;
+    record.type = RECORD_DISCOVERED;
+    record.hostname = hostname;
+    record.depth = depth;
+    queue.push(std::move(record));
+}
+
+/**
+ * @brief Logs a site whose results were written. Never blocks on I/O, safe to call from any thread.
+ *
+ * @param hostname The hostname of the site.
+ */
+void Checkpoint::recordCompleted(const std::string& hostname) {
+    Record record;
+    record.type = RECORD_COMPLETED;
+    record.hostname = hostname;
+    record.depth = 0;
+    queue.push(std::move(record));
+}
+
+/**
+ * @brief Writes every queued record, syncs the log and stops the writer thread.
+ */
+void Checkpoint::stop() {
+    if (writer.joinable()) {
+        stopRequested = true;
+        wakeCondVar.notify_one();
+        writer.join();
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void Checkpoint::runWriter() {
+    bool failed = false;
+    uint64_t syncedBytes = logBytes;
+    while (true) {
+        bool stopping = stopRequested.load();
+
+        Record record;
+        while (queue.pop(record)) {
+            apply(record);
+            if (buffer.size() >= CHECKPOINT_WRITE_SIZE && !failed) {
+                failed = !writeBuffer();
+            }
+        }
+
+        if (!failed) {
+            failed = !writeBuffer() || (logBytes != syncedBytes && fdatasync(fd) != 0);
+            syncedBytes = logBytes;
+            if (!failed && logBytes >= COMPACTION_MIN_BYTES && logBytes >= 2 * compactedBytes) {
+                failed = !compact();
+                syncedBytes = logBytes;
+            }
+            if (failed) {
+                std::cerr << " [!] Error: Failed to write the checkpoint " << path << ": " << std::strerror(errno) << std::endl;
+            }
+        }
+        buffer.clear();
+
+        if (stopping) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondVar.wait_for(lock, std::chrono::milliseconds(flushIntervalMs), [this] { return stopRequested.load(); });
+    }
+}
+
+/**
+ * @brief Applies a record to the state kept by the writer and encodes it for the log.
+ *
+ * @param record The record.
+ */
+void Checkpoint::apply(const Record& record) {
+    uint64_t fingerprint = getUrlFingerprint(record.hostname);
+    if (record.type == RECORD_DISCOVERED) {
+        pendingSites[fingerprint] = std::make_pair(record.hostname, record.depth);
+        encodeDiscovered(buffer, fingerprint, record.hostname, record.depth);
+    } else {
+        pendingSites.erase(fingerprint);
+        completedSites.push_back(fingerprint);
+        encodeCompleted(buffer, fingerprint);
+    }
+}
+
+/**
+ * @brief Appends the encoded records to the log.
+ *
+ * @return True if they were written, otherwise false.
+ */
+bool Checkpoint::writeBuffer() {
+    if (!writeAll(fd, buffer.data(), buffer.size())) {
+        return false;
+    }
+    logBytes += buffer.size();
+    buffer.clear();
+    return true;
+}
+
+/**
+ * @brief Replaces the log with the shortest log of the current state.
+ *
+ * The new log is written and synced under a temporary name, then renamed over the old one, so a crash
+ * at any point leaves one complete log behind.
+ *
+ * @return True if the log was replaced, otherwise false.
+ */
+bool Checkpoint::compact() {
+    std::string temporaryPath = path + ".tmp";
+    int file = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        std::cerr << " [!] Error: Unable to create the checkpoint " << temporaryPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    std::string compacted(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    compacted.reserve(compacted.size() + completedSites.size() * 9 + pendingSites.size() * 32);
+    for (uint64_t fingerprint : completedSites) {
+        encodeCompleted(compacted, fingerprint);
+    }
+    for (auto& entry : pendingSites) {
+        encodeDiscovered(compacted, entry.first, entry.second.first, entry.second.second);
+    }
+
+    if (!writeAll(file, compacted.data(), compacted.size()) || fdatasync(file) != 0
+        || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::cerr << " [!] Error: Unable to write the checkpoint " << path << ": " << std::strerror(errno) << std::endl;
+        ::close(file);
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+
+    // records are appended to the compacted log from now on
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = file;
+    if (lseek(fd, 0, SEEK_END) < 0) {
+        return false;
+    }
+    logBytes = compacted.size();
+    compactedBytes = compacted.size();
+    return true;
+}
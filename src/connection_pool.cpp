@@ -0,0 +1,177 @@
+/**
+ * @file connection_pool.cpp
+ * @brief Implementation of the per-host pool of idle keep-alive connections.
+ * 
+ * Connections whose last response allowed keep-alive are parked here after use, so the next request
+ * to the same host can skip the DNS lookup and the TCP handshake. A crawl touches each host only for a
+ * few pages, so the pool also bounds the idle connections overall: every release sweeps the expired
+ * ones, the least recently used one is closed once `maxIdleTotal` is exceeded, and a host's connections
+ * are dropped as soon as its site is finished. Otherwise idle sockets to hosts that are never visited
+ * again would pile up until the process runs out of file descriptors.
+ */
+
+#include "connection_pool.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+
+/**
+ * @brief Constructs a ConnectionPool object with the specified params.
+ * 
+ * @param maxIdlePerHost The maximum number of idle connections kept per host.
+ * @param idleTimeoutMs The time in milliseconds after which an idle connection is discarded.
+ * @param maxIdleTotal The maximum number of idle connections kept over all hosts.
+ */
+ConnectionPool::ConnectionPool(int maxIdlePerHost, int idleTimeoutMs, int maxIdleTotal)
+    : maxIdlePerHost(maxIdlePerHost), idleTimeout(idleTimeoutMs), maxIdleTotal(std::max(0, maxIdleTotal)) {}
+
+ConnectionPool::~ConnectionPool() {
+    for (auto& connection : idleList) {
+        close(connection.fd);
+    }
+}
+
+/**
+ * @brief Takes an idle connection to the given host out of the pool.
+ * 
+ * Expired connections and connections that the server has already closed are discarded on the way.
+ * 
+ * @param hostname The hostname of the server.
+ * @param port The port of the server.
+ * @return The file descriptor of a connected socket, or -1 if no reusable connection is available.
+ */
+int ConnectionPool::acquire(const std::string& hostname, int port) {
+    std::vector<int> staleConnections;
+    int fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        evictExpired(std::chrono::steady_clock::now(), staleConnections);
+
+        auto it = idleConnections.find(makeKey(hostname, port));
+        if (it != idleConnections.end()) {
+            fd = it->second.back()->fd;
+            remove(it->second.back());
+        }
+    }
+
+    for (int staleFd : staleConnections) {
+        close(staleFd);
+    }
+
+    if (fd != -1 && !isAlive(fd)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Returns a connection whose last response allowed keep-alive to the pool.
+ * 
+ * @param hostname The hostname of the server.
+ * @param port The port of the server.
+ * @param fd The file descriptor of the connected socket. Ownership passes to the pool.
+ */
+void ConnectionPool::release(const std::string& hostname, int port, int fd) {
+    std::vector<int> staleConnections;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        auto now = std::chrono::steady_clock::now();
+        evictExpired(now, staleConnections);
+
+        std::string key = makeKey(hostname, port);
+        auto& connections = idleConnections[key];
+        if (static_cast<int>(connections.size()) < maxIdlePerHost && maxIdleTotal > 0) {
+            idleList.push_front({key, fd, now});
+            connections.push_back(idleList.begin());
+            fd = -1;
+
+            if (idleList.size() > maxIdleTotal) {
+                staleConnections.push_back(idleList.back().fd);
+                remove(std::prev(idleList.end()));
+            }
+        } else if (connections.empty()) {
+            idleConnections.erase(key);
+        }
+    }
+
+    for (int staleFd : staleConnections) {
+        close(staleFd);
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+/**
+ * @brief Closes every idle connection to the given host, once no more pages of it will be fetched.
+ * 
+ * @param hostname The hostname of the server.
+ * @param port The port of the server.
+ */
+void ConnectionPool::discard(const std::string& hostname, int port) {
+    std::vector<int> staleConnections;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        auto it = idleConnections.find(makeKey(hostname, port));
+        if (it == idleConnections.end()) {
+            return;
+        }
+        for (auto connection : it->second) {
+            staleConnections.push_back(connection->fd);
+            idleList.erase(connection);
+        }
+        idleConnections.erase(it);
+    }
+
+    for (int staleFd : staleConnections) {
+        close(staleFd);
+    }
+}
+
+/**
+ * @brief Unlinks an idle connection from the LRU list and from its host. The caller closes the fd.
+ * 
+ * @param connection The connection to remove.
+ */
+void ConnectionPool::remove(IdleList::iterator connection) {
+    auto it = idleConnections.find(connection->key);
+    auto& connections = it->second;
+    connections.erase(std::find(connections.begin(), connections.end(), connection));
+    if (connections.empty()) {
+        idleConnections.erase(it);
+    }
+    idleList.erase(connection);
+}
+
+/**
+ * @brief Removes the connections that have been idle for longer than the timeout.
+ * 
+ * The list is ordered by release time, so the expired connections are all at its back.
+ * 
+ * @param now The current time.
+ * @param staleConnections Receives the file descriptors to close once the lock is released.
+ */
+void ConnectionPool::evictExpired(std::chrono::steady_clock::time_point now, std::vector<int>& staleConnections) {
+    while (!idleList.empty() && now - idleList.back().idleSince >= idleTimeout) {
+        staleConnections.push_back(idleList.back().fd);
+        remove(std::prev(idleList.end()));
+    }
+}
+
+std::string ConnectionPool::makeKey(const std::string& hostname, int port) {
+    return hostname + ":" + std::to_string(port);
+}
+
+/**
+ * @brief Checks that an idle connection has not been closed by the server in the meantime.
+ * 
+ * @param fd The file descriptor to check.
+ * @return True if the connection is still open and has no unexpected pending data, otherwise false.
+ */
+bool ConnectionPool::isAlive(int fd) {
+    char byte;
+    ssize_t result = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
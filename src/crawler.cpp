@@ -11,12 +11,55 @@
 #include "socket.h"
 #include "parser.h"
 #include "config.h"
+#include <filesystem>
+#include <unistd.h>
 
-Crawler::Crawler(const Config& config) : config(config), isThreadFinished(false) {}
+// how long the event loop scheduler waits before retrying when the frontier has no site to hand out yet
+const int FRONTIER_RETRY_MS = 10;
 
+Crawler::Crawler(const Config& config)
+    : config(config), connectionPool(4, 30000, config.maxIdleConnections), resolver(config.dnsThreads, config.dnsCacheTtl, config.dnsNegativeTtl, std::max(0, config.dnsCacheSize)),
+      robotsCache(std::max(0, config.robotsCacheSize)), serverPort(80), resultSink(!config.disableConsoleOutput), checkpoint(config.checkpointInterval), isStopRequested(false) {
+    rateLimits.minDelayMs = config.minCrawlDelay;
+    rateLimits.maxDelayMs = config.maxCrawlDelay;
+}
+
+/**
+ * @brief Runs the crawl to completion. Returns once every worker has exited.
+ */
 void Crawler::start() {
     initialize();
-    scheduleCrawlers();
+    if (!config.metricsFile.empty() && !shardClient && !metrics.startExport(config.metricsFile, config.metricsInterval)) {
+        std::cerr << " [!] Error: Unable to write metrics file: " << config.metricsFile << std::endl;
+        exit(1);
+    }
+    resultSink.start();
+    if (config.ioBackend == "epoll") {
+        scheduleAsyncCrawlers();
+    } else {
+        scheduleCrawlers();
+    }
+    if (shardClient) shardClient->finish();
+    resultSink.stop();
+    checkpoint.stop();
+    metrics.stopExport();
+    if (!config.disableConsoleOutput) {
+        metrics.printSummary(std::cout);
+    }
+}
+
+/**
+ * @brief Asks a running crawl to shut down. Safe to call from any thread.
+ * 
+ * Pages being fetched are completed, while pending sites are dropped. With the threads backend, sites
+ * waiting for their next page are dropped as well, the epoll backend lets them finish. start() returns
+ * once all workers have exited.
+ */
+void Crawler::stop() {
+    std::lock_guard<std::mutex> m_lock(m_mutex);
+    isStopRequested = true;
+    if (crawlerState.frontier) crawlerState.frontier->close();
+    m_condVar.notify_all();
 }
 
 Config parseCommandLineArgs(int argc, char *argv[]) {
@@ -42,16 +85,130 @@ Config parseCommandLineArgs(int argc, char *argv[]) {
         .help("Delay between requests in milliseconds")
         .scan<'i', int>();
 
+    program.add_argument("--adaptiveDelay")
+        .help("Adapt the delay of every host to its response times, from --crawlDelay within --minCrawlDelay and --maxCrawlDelay, backing off on slow responses, failures and 429/503")
+        .implicit_value(true)
+        .nargs(0);
+
+    program.add_argument("--minCrawlDelay")
+        .help("Minimum delay between requests to a host in milliseconds with --adaptiveDelay")
+        .scan<'i', int>();
+
+    program.add_argument("--maxCrawlDelay")
+        .help("Maximum delay between requests to a host in milliseconds with --adaptiveDelay")
+        .scan<'i', int>();
+
+    program.add_argument("--maxActiveSites")
+        .help("Maximum number of sites crawled concurrently by the threads backend, including sites waiting for their crawl delay")
+        .scan<'i', int>();
+
+    program.add_argument("--ioBackend")
+        .help("I/O backend: `threads` (one blocking thread per site) or `epoll` (non-blocking event loops)");
+
+    program.add_argument("--ioThreads")
+        .help("Number of event loop threads used by the epoll backend")
+        .scan<'i', int>();
+
+    program.add_argument("--maxConnections")
+        .help("Maximum number of sites crawled concurrently by the epoll backend")
+        .scan<'i', int>();
+
     program.add_argument("--enableCSVOutput", "-csv")
         .help("Enable CSV output of the crawl results in `crawl_results.csv`")
         .implicit_value(true)
         .nargs(0);
 
+    program.add_argument("--enableBinaryOutput", "-bin")
+        .help("Enable binary output of the crawl results in `crawl_results.trb` (read it with threadr-dump)")
+        .implicit_value(true)
+        .nargs(0);
+
     program.add_argument("--disableConsoleOutput", "-out")
         .help("Disable console output of the crawl results")
         .implicit_value(true)
         .nargs(0);    
 
+    program.add_argument("--dnsThreads")
+        .help("Number of threads running DNS lookups")
+        .scan<'i', int>();
+
+    program.add_argument("--dnsCacheTtl")
+        .help("Time in seconds a resolved hostname is cached")
+        .scan<'i', int>();
+
+    program.add_argument("--dnsNegativeTtl")
+        .help("Time in seconds a failed DNS lookup (e.g. NXDOMAIN) is cached")
+        .scan<'i', int>();
+
+    program.add_argument("--dnsCacheSize")
+        .help("Number of hostnames whose DNS lookups are cached")
+        .scan<'i', int>();
+
+    program.add_argument("--connectTo")
+        .help("Connect to this address (e.g. `127.0.0.1:8080`) for every host instead of resolving the hostnames, to crawl a local test server");
+
+    program.add_argument("--ignoreRobots")
+        .help("Crawl every page without fetching robots.txt, and use --crawlDelay even where robots.txt sets a Crawl-delay")
+        .implicit_value(true)
+        .nargs(0);
+
+    program.add_argument("--robotsCacheSize")
+        .help("Number of hosts whose compiled robots.txt rules are cached")
+        .scan<'i', int>();
+
+    program.add_argument("--bloomFilterHosts")
+        .help("Deduplicate hostnames with a Bloom filter sized for this many hosts (1% false positives) instead of an exact set")
+        .scan<'i', int>();
+
+    program.add_argument("--frontierOrder")
+        .help("Order in which sites are crawled: `fifo` (breadth-first) or `priority` (by in-links, depth and responsiveness)");
+
+    program.add_argument("--frontierMemoryLimit")
+        .help("Memory budget in MiB of the pending sites, the sites beyond it are spilled to disk (0 for no limit)")
+        .scan<'i', int>();
+
+    program.add_argument("--frontierSpillDir")
+        .help("Directory for the spilled frontier segments, the system temporary directory if not set");
+
+    program.add_argument("--maxBodySize")
+        .help("Maximum number of body bytes downloaded per page, -1 for no limit")
+        .scan<'i', int>();
+
+    program.add_argument("--checkpointFile")
+        .help("Log the frontier to this file, so an interrupted crawl can be resumed with --resume");
+
+    program.add_argument("--checkpointInterval")
+        .help("Interval in milliseconds at which the checkpoint is synced to disk")
+        .scan<'i', int>();
+
+    program.add_argument("--resume")
+        .help("Resume the crawl from the checkpoint (`crawl_checkpoint.bin` unless --checkpointFile is given) and append to the results files")
+        .implicit_value(true)
+        .nargs(0);
+
+    program.add_argument("--metricsFile")
+        .help("Export the stage latencies and crawl counters to this file in the Prometheus text format");
+
+    program.add_argument("--metricsInterval")
+        .help("Interval in milliseconds at which the metrics file is rewritten")
+        .scan<'i', int>();
+
+    program.add_argument("--shards")
+        .help("Split the crawl over this many crawler processes, each crawling the hosts whose hostname hash falls in its shard")
+        .scan<'i', int>();
+
+    program.add_argument("--shardSocket")
+        .help("Path of the Unix domain socket connecting the shards to the coordinator, in the system temporary directory if not set");
+
+    program.add_argument("--maxIdleConnections")
+        .help("Maximum number of idle keep-alive connections kept open over all hosts")
+        .scan<'i', int>();
+
+    program.add_argument("--disableKeepAlive")
+        .help("Open a new connection for every page instead of reusing keep-alive connections")
+        .implicit_value(true)
+        .nargs(0);
+
     program.add_argument("-vb", "--verbose")
         .help("Enable verbose output")
         .implicit_value(true)
@@ -90,10 +247,37 @@ Config parseCommandLineArgs(int argc, char *argv[]) {
             std::string var, val, url;
             while (configFile >> var >> val) {
                 if (var == "crawlDelay") config.crawlDelay = std::stoi(val);
+                else if (var == "adaptiveDelay") config.adaptiveDelay = (val == "true" || val == "1");
+                else if (var == "minCrawlDelay") config.minCrawlDelay = std::stoi(val);
+                else if (var == "maxCrawlDelay") config.maxCrawlDelay = std::stoi(val);
                 else if (var == "maxThreads") config.maxThreads = std::stoi(val);
                 else if (var == "depthLimit") config.depthLimit = std::stoi(val);
                 else if (var == "pageLimit") config.pageLimit = std::stoi(val);
                 else if (var == "linkedSitesLimit") config.linkedSitesLimit = std::stoi(val);
+                else if (var == "maxActiveSites") config.maxActiveSites = std::stoi(val);
+                else if (var == "ioBackend") config.ioBackend = val;
+                else if (var == "ioThreads") config.ioThreads = std::stoi(val);
+                else if (var == "maxConnections") config.maxConnections = std::stoi(val);
+                else if (var == "maxIdleConnections") config.maxIdleConnections = std::stoi(val);
+                else if (var == "keepAlive") config.keepAlive = (val == "true" || val == "1");
+                else if (var == "dnsThreads") config.dnsThreads = std::stoi(val);
+                else if (var == "dnsCacheTtl") config.dnsCacheTtl = std::stoi(val);
+                else if (var == "dnsNegativeTtl") config.dnsNegativeTtl = std::stoi(val);
+                else if (var == "dnsCacheSize") config.dnsCacheSize = std::stoi(val);
+                else if (var == "connectTo") config.connectTo = val;
+                else if (var == "obeyRobots") config.obeyRobots = (val == "true" || val == "1");
+                else if (var == "robotsCacheSize") config.robotsCacheSize = std::stoi(val);
+                else if (var == "bloomFilterHosts") config.bloomFilterHosts = std::stoi(val);
+                else if (var == "maxBodySize") config.maxBodySize = std::stoi(val);
+                else if (var == "frontierOrder") config.frontierOrder = val;
+                else if (var == "frontierMemoryLimit") config.frontierMemoryLimit = std::stoi(val);
+                else if (var == "frontierSpillDir") config.frontierSpillDir = val;
+                else if (var == "checkpointFile") config.checkpointFile = val;
+                else if (var == "checkpointInterval") config.checkpointInterval = std::stoi(val);
+                else if (var == "metricsFile") config.metricsFile = val;
+                else if (var == "metricsInterval") config.metricsInterval = std::stoi(val);
+                else if (var == "shards") config.shards = std::stoi(val);
+                else if (var == "shardSocket") config.shardSocket = val;
                 else if (var == "startUrls") {
                     if (std::stoi(val) > 0) configFileHasStartUrls = true;
                     for (int i = 0; i < std::stoi(val); i++) {
@@ -132,14 +316,151 @@ Config parseCommandLineArgs(int argc, char *argv[]) {
         config.crawlDelay = program.get<int>("--crawlDelay");
     }
 
+    if (program.present<bool>("--adaptiveDelay")) {
+        config.adaptiveDelay = true;
+    }
+
+    if (program.present<int>("--minCrawlDelay")) {
+        config.minCrawlDelay = program.get<int>("--minCrawlDelay");
+    }
+
+    if (program.present<int>("--maxCrawlDelay")) {
+        config.maxCrawlDelay = program.get<int>("--maxCrawlDelay");
+    }
+
+    if (program.present<int>("--maxActiveSites")) {
+        config.maxActiveSites = program.get<int>("--maxActiveSites");
+    }
+
+    if (program.present("--ioBackend")) {
+        config.ioBackend = program.get<std::string>("--ioBackend");
+    }
+
+    if (program.present<int>("--ioThreads")) {
+        config.ioThreads = program.get<int>("--ioThreads");
+    }
+
+    if (program.present<int>("--maxConnections")) {
+        config.maxConnections = program.get<int>("--maxConnections");
+    }
+
+    if (config.ioBackend != "threads" && config.ioBackend != "epoll") {
+        std::cerr << " [!] Error: Unknown I/O backend: " << config.ioBackend << " (expected `threads` or `epoll`)" << std::endl;
+        exit(1);
+    }
+
     if (program.present<bool>("--enableCSVOutput")) {
         config.enableCSVOutput = true;
     }
 
+    if (program.present<bool>("--enableBinaryOutput")) {
+        config.enableBinaryOutput = true;
+    }
+
     if (program.present<bool>("--disableConsoleOutput")) {
         config.disableConsoleOutput = true;
     }
 
+    if (program.present<int>("--dnsThreads")) {
+        config.dnsThreads = program.get<int>("--dnsThreads");
+    }
+
+    if (program.present<int>("--dnsCacheTtl")) {
+        config.dnsCacheTtl = program.get<int>("--dnsCacheTtl");
+    }
+
+    if (program.present<int>("--dnsNegativeTtl")) {
+        config.dnsNegativeTtl = program.get<int>("--dnsNegativeTtl");
+    }
+
+    if (program.present<int>("--dnsCacheSize")) {
+        config.dnsCacheSize = program.get<int>("--dnsCacheSize");
+    }
+
+    if (program.present("--connectTo")) {
+        config.connectTo = program.get<std::string>("--connectTo");
+    }
+
+    if (program.present<bool>("--ignoreRobots")) {
+        config.obeyRobots = false;
+    }
+
+    if (program.present<int>("--robotsCacheSize")) {
+        config.robotsCacheSize = program.get<int>("--robotsCacheSize");
+    }
+
+    if (program.present<int>("--bloomFilterHosts")) {
+        config.bloomFilterHosts = program.get<int>("--bloomFilterHosts");
+    }
+
+    if (program.present("--frontierOrder")) {
+        config.frontierOrder = program.get<std::string>("--frontierOrder");
+    }
+
+    if (config.frontierOrder != "fifo" && config.frontierOrder != "priority") {
+        std::cerr << " [!] Error: Unknown frontier order: " << config.frontierOrder << " (expected `fifo` or `priority`)" << std::endl;
+        exit(1);
+    }
+
+    if (program.present<int>("--frontierMemoryLimit")) {
+        config.frontierMemoryLimit = program.get<int>("--frontierMemoryLimit");
+    }
+
+    if (program.present("--frontierSpillDir")) {
+        config.frontierSpillDir = program.get<std::string>("--frontierSpillDir");
+    }
+
+    if (program.present<int>("--maxBodySize")) {
+        config.maxBodySize = program.get<int>("--maxBodySize");
+    }
+
+    if (program.present("--checkpointFile")) {
+        config.checkpointFile = program.get<std::string>("--checkpointFile");
+    }
+
+    if (program.present<int>("--checkpointInterval")) {
+        config.checkpointInterval = program.get<int>("--checkpointInterval");
+    }
+
+    if (program.present<bool>("--resume")) {
+        config.resume = true;
+        if (config.checkpointFile.empty()) config.checkpointFile = "crawl_checkpoint.bin";
+    }
+
+    if (program.present("--metricsFile")) {
+        config.metricsFile = program.get<std::string>("--metricsFile");
+    }
+
+    if (program.present<int>("--metricsInterval")) {
+        config.metricsInterval = program.get<int>("--metricsInterval");
+    }
+
+    if (program.present<int>("--shards")) {
+        config.shards = program.get<int>("--shards");
+    }
+
+    if (program.present("--shardSocket")) {
+        config.shardSocket = program.get<std::string>("--shardSocket");
+    }
+
+    if (config.shards < 1) {
+        std::cerr << " [!] Error: The number of shards must be at least 1" << std::endl;
+        exit(1);
+    }
+
+    if (config.shards > 1 && !config.checkpointFile.empty()) {
+        std::cerr << " [!] Error: Checkpoints are not supported with --shards" << std::endl;
+        exit(1);
+    }
+
+    if (program.present<int>("--maxIdleConnections")) {
+        config.maxIdleConnections = program.get<int>("--maxIdleConnections");
+    }
+
+    if (program.present<bool>("--disableKeepAlive")) {
+        config.keepAlive = false;
+    }
+
     if (program.present<bool>("--verbose")) {
         config.verbose = true;
     }
@@ -153,7 +474,7 @@ Config parseCommandLineArgs(int argc, char *argv[]) {
     }
 
     // check start URLs are provided
-    if (config.startUrls.empty() && !configFileHasStartUrls) {
+    if (config.startUrls.empty() && !configFileHasStartUrls && !config.resume) {
         std::cerr << " [!] Error: No start URLs provided. Specify start URLs in the command line or configuration file." << std::endl;
         std::cerr << program;
         exit(1);
@@ -201,24 +522,162 @@ Config readConfigFile() {
  * This method initializes the crawler state with start URLs and marks them as discovered.
  */
 void Crawler::initialize() {
-    crawlerState.threadsCount = 0;
+    if (!config.connectTo.empty()) {
+        Resolver::Address address;
+        if (!Resolver::parseAddress(config.connectTo, address, serverPort)) {
+            std::cerr << " [!] Error: Invalid address: " << config.connectTo << " (expected `ip:port`)" << std::endl;
+            exit(1);
+        }
+        resolver.setOverride(address);
+    }
+
+    crawlerState.activeSites = 0;
+    int workerCount = config.ioBackend == "epoll" ? config.ioThreads : config.maxThreads;
+    crawlerState.frontier.reset(new SiteFrontier(workerCount, config.bloomFilterHosts));
+    if (config.frontierOrder == "priority") crawlerState.frontier->setOrder(SiteFrontier::Order::Priority);
+    if (config.frontierMemoryLimit > 0
+        && !crawlerState.frontier->setMemoryLimit(static_cast<size_t>(config.frontierMemoryLimit) << 20, config.frontierSpillDir)) {
+        std::cerr << " [!] Warning: The frontier cannot spill to disk, it is kept in memory" << std::endl;
+    }
+
+    size_t nextWorker = 0;
+    if (!config.checkpointFile.empty()) initializeCheckpoint(nextWorker);
+    if (config.shardIndex >= 0) initializeShard();
+
     for (auto& url : config.startUrls) {
-        crawlerState.pendingSites.push(std::make_pair(getHostnameFromUrl(url), 0));
-        crawlerState.discoveredSites[getHostnameFromUrl(url)] = true;
+        std::string normalizedUrl = normalizeUrl(url);
+        discoverSite(nextWorker++, std::string(getHostnameFromUrl(normalizedUrl)), 0);
     }
 
-    // init the CSV file
-    if (config.enableCSVOutput)  initializeResultsFile();
+    // init the results files
+    if (config.enableCSVOutput || config.enableBinaryOutput)  initializeResultsFile();
     
     std::cout << " [*] Crawler initialized successfully!" << std::endl;
 }
 
+/**
+ * @brief Restores the frontier from the checkpoint when resuming, and starts logging to the checkpoint.
+ * 
+ * A site is logged as completed once its results were flushed to the results files, so a resumed crawl
+ * neither loses nor repeats results.
+ * 
+ * @param nextWorker The worker whose deque gets the next restored site, advanced for every site.
+ */
+void Crawler::initializeCheckpoint(size_t& nextWorker) {
+    Checkpoint::State state;
+    if (config.resume) {
+        if (Checkpoint::load(config.checkpointFile, state)) {
+            SiteFrontier& frontier = *crawlerState.frontier;
+            for (uint64_t fingerprint : state.completedSites) {
+                frontier.markDiscovered(fingerprint);
+            }
+            for (auto& site : state.pendingSites) {
+                if (frontier.markDiscovered(site.first)) {
+                    frontier.push(nextWorker++, site);
+                }
+            }
+            std::cout << " [*] Resumed from " << config.checkpointFile << ": " << state.completedSites.size()
+                      << " sites completed, " << state.pendingSites.size() << " sites pending" << std::endl;
+        } else {
+            std::cerr << " [!] Warning: No checkpoint found at " << config.checkpointFile << ", starting a new crawl" << std::endl;
+        }
+    }
+
+    if (!checkpoint.open(config.checkpointFile, state)) {
+        exit(1);
+    }
+    resultSink.setWrittenListener([this](const std::string& hostname) { checkpoint.recordCompleted(hostname); });
+}
+
+/**
+ * @brief Connects this shard process to the coordinator, which routes the sites it owns to it.
+ * 
+ * The frontier is held open until the coordinator stops the crawl, as other shards may still find
+ * sites for this one after it ran out of work.
+ */
+void Crawler::initializeShard() {
+    shardClient.reset(new ShardClient(config.shardIndex, config.shards));
+    if (!shardClient->connectTo(config.shardSocket)) {
+        exit(1);
+    }
+    if (!config.metricsFile.empty()) {
+        shardClient->reportMetrics(&metrics, config.metricsInterval); // the coordinator writes the metrics file
+    }
+    crawlerState.frontier->hold();
+}
+
+/**
+ * @brief Starts receiving the sites of this shard, once the workers can be woken up for them.
+ */
+void Crawler::startShard() {
+    SiteFrontier& frontier = *crawlerState.frontier;
+    auto wakeScheduler = [this] {
+        std::lock_guard<std::mutex> m_lock(m_mutex);
+        m_condVar.notify_all();
+    };
+    shardClient->start(
+        [this, wakeScheduler, nextWorker = size_t(0)](std::vector<ShardClient::Site>& sites) mutable {
+            for (auto& site : sites) {
+                discoverSite(nextWorker++, site.first, site.second);
+            }
+            wakeScheduler();
+        },
+        [&frontier, wakeScheduler] {
+            frontier.completeSite();
+            wakeScheduler();
+        },
+        [&frontier] { return frontier.outstandingCount() == 1; }); // only the hold is left
+}
+
+/**
+ * @brief Queues a site unless it was already discovered.
+ * 
+ * In a sharded crawl, a site owned by another shard is forwarded to it instead, once per shard.
+ * 
+ * @param workerId The index of the worker whose deque gets the site.
+ * @param hostname The hostname of the site.
+ * @param depth The depth of the site.
+ * @return True if the site was queued, false if it was already discovered.
+ */
+bool Crawler::discoverSite(size_t workerId, const std::string& hostname, int depth) {
+    SiteFrontier& frontier = *crawlerState.frontier;
+    if (!frontier.markDiscovered(hostname)) {
+        return false;
+    }
+    if (shardClient && getShardOwner(hostname, config.shards) != config.shardIndex) {
+        shardClient->forwardSite(hostname, depth);
+        return true;
+    }
+    if (checkpoint.isOpen()) checkpoint.recordDiscovered(hostname, depth);
+    frontier.push(workerId, std::make_pair(hostname, depth));
+    return true;
+}
+
+/**
+ * @brief Collects the crawl-wide services shared by every Socket.
+ * 
+ * @return The shared connection pool (unless keep-alive is disabled), resolver, metrics, robots.txt cache
+ *         (unless robots.txt is ignored) and crawl delay limits (if the delay is adaptive).
+ */
+Socket::Services Crawler::socketServices() {
+    Socket::Services services;
+    services.connectionPool = config.keepAlive ? &connectionPool : nullptr;
+    services.resolver = &resolver;
+    services.metrics = &metrics;
+    services.robotsCache = config.obeyRobots ? &robotsCache : nullptr;
+    services.rateLimits = config.adaptiveDelay ? &rateLimits : nullptr;
+    return services;
+}
+
+/**
+ * @brief Creates the enabled results files, which stay open in the result sink for the whole crawl.
+ */
 void Crawler::initializeResultsFile() {
-    std::ofstream csvFile("crawl_results.csv");
-    if (csvFile.is_open()) {
-        csvFile << "WEBSITE,DEPTH,PAGES DISCOVERED,FAILED QUERIES,LINKED SITES,MIN RESPONSE TIME (ms),MAX RESPONSE TIME (ms),AVG RESPONSE TIME (ms),DISCOVERED PAGES\n";
-        csvFile.close();
-    } else {
+    if (config.enableBinaryOutput && !resultSink.openBinary("crawl_results.trb", config.resume)) {
+        std::cerr << " [!] Error: Unable to open binary results file" << std::endl;
+        exit(1);
+    }
+    if (config.enableCSVOutput && !resultSink.openCsv("crawl_results.csv", config.resume)) {
         std::cerr << " [!] Error: Unable to open CSV file" << std::endl;
         exit(1);
     }
@@ -228,119 +687,246 @@ void Crawler::initializeResultsFile() {
 /**
  * @brief Schedules crawlers for processing URLs.
  * 
- * It schedules crawlers to process URLs until all URLs have been crawled or no more threads are available.
+ * It starts a fixed pool of `maxThreads` workers that crawl up to `maxActiveSites` sites at once until
+ * the crawl is finished, then joins them.
  */
 void Crawler::scheduleCrawlers() {
-    while (crawlerState.threadsCount != 0 || !crawlerState.pendingSites.empty()) {
-        std::unique_lock<std::mutex> m_lock(m_mutex);
+    crawlerState.scheduler.reset(new HostScheduler(config.maxActiveSites, std::max(1, config.maxThreads)));
+    HostScheduler& scheduler = *crawlerState.scheduler;
+    crawlerState.frontier->setWakeListener([&scheduler](bool wakeAll) { scheduler.notify(wakeAll); });
+    if (shardClient) startShard();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::max(1, config.maxThreads); i++) {
+        workers.emplace_back(&Crawler::runWorker, this, static_cast<size_t>(i));
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
 
-        while (!crawlerState.pendingSites.empty() && crawlerState.threadsCount < config.maxThreads) {
-            auto nextSite = crawlerState.pendingSites.front();
-            crawlerState.pendingSites.pop();
-            crawlerState.threadsCount++;
 
-            std::thread(&Crawler::startCrawler, this, nextSite.first, nextSite.second).detach();
+/**
+ * @brief Main loop of a pool worker.
+ * 
+ * A worker repeatedly asks the host scheduler for work: either fetching the next page of a host whose
+ * crawl delay has elapsed, or starting a new site taken from the frontier (its own deque first, stealing
+ * from the others when it is empty). After each page the host is parked in the scheduler until its next
+ * fetch is allowed, so the worker never sleeps on the crawl delay. It exits once the crawl is finished,
+ * that is when no site is pending or in progress, or when a stop was requested.
+ * 
+ * @param workerId The index of the worker, which selects its deque in the frontier.
+ */
+void Crawler::runWorker(size_t workerId) {
+    HostScheduler& scheduler = *crawlerState.scheduler;
+    SiteFrontier& frontier = *crawlerState.frontier;
+    auto hasNewSites = [&frontier] { return frontier.pendingCount() > 0; };
+    auto isFinished = [&frontier] { return frontier.isFinished(); };
+
+    while (true) {
+        HostScheduler::Host* host = nullptr;
+        HostScheduler::Work work = scheduler.waitForWork(workerId, host, hasNewSites, isFinished);
+        if (work == HostScheduler::Work::Finished) {
+            return;
+        }
+
+        if (work == HostScheduler::Work::StartSite) {
+            SiteFrontier::Site nextSite;
+            if (!frontier.tryPop(workerId, nextSite)) {
+                scheduler.releaseSlot(); // another worker took it first
+                continue;
+            }
+            std::unique_ptr<Socket> clientSocket(new Socket(nextSite.first, serverPort, config.pageLimit, config.crawlDelay, config.maxBodySize, socketServices()));
+            host = scheduler.admit(workerId, std::move(clientSocket), nextSite.second);
+        }
 
-            
+        if (host->socket->hasPendingPages()) {
+            host->socket->crawlNextPage();
         }
 
-        m_condVar.wait(m_lock, [this] { return isThreadFinished; });
-        isThreadFinished = false;
+        if (host->socket->hasPendingPages()) {
+            scheduler.schedule(workerId, host, host->socket->getCrawlDelay()); // robots.txt may set its own
+        } else {
+            Socket::SiteStats stats = host->socket->finishDiscovery();
+            int currentDepth = host->depth;
+            scheduler.retire(host);
+            handleSiteResults(workerId, std::move(stats), currentDepth);
+        }
     }
 }
 
 
 /**
- * @brief Starts crawling a given URL.
+ * @brief Schedules crawlers on a set of event loops for processing URLs.
  * 
- * @param baseUrl The base URL of the website to crawl.
- * @param currentDepth The current depth of the crawling process.
+ * Instead of a pool of blocking workers, every site is handed to one of `ioThreads` event loops
+ * (round robin), which multiplex up to `maxConnections` sites overall.
  */
-void Crawler::startCrawler(std::string baseUrl, int currentDepth) {
-    Socket clientSocket(baseUrl, 80, config.pageLimit, config.crawlDelay);
-    Socket::SiteStats stats = clientSocket.initiateDiscovery();
-    std::lock_guard<std::mutex> m_lock(m_mutex);
-    // std::cout << "Console output is " << (config.disableConsoleOutput ? "disabled" : "enabled") << std::endl;
-    // output the stats
-    if (config.enableCSVOutput) writeResultsToCsv(stats, currentDepth);
-    if (!config.disableConsoleOutput) writeResultsToConsole(stats, currentDepth);
-
-    if (currentDepth < config.depthLimit) {
-        for (int i = 0; i < std::min(static_cast<int>(stats.linkedSites.size()), config.linkedSitesLimit); i++) {
-            std::string site = stats.linkedSites[i];
-            if (crawlerState.discoveredSites.find(site) == crawlerState.discoveredSites.end()) {
-                crawlerState.pendingSites.push(std::make_pair(site, currentDepth + 1));
-                crawlerState.discoveredSites[site] = true;
-            }
+void Crawler::scheduleAsyncCrawlers() {
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    std::vector<std::thread> loopThreads;
+    for (int i = 0; i < std::max(1, config.ioThreads); i++) {
+        loops.emplace_back(new EventLoop());
+        loopThreads.emplace_back(&EventLoop::run, loops.back().get());
+    }
+
+    SiteFrontier& frontier = *crawlerState.frontier;
+    if (shardClient) startShard();
+    size_t nextLoop = 0;
+    std::unique_lock<std::mutex> m_lock(m_mutex);
+    while (true) {
+        m_condVar.wait(m_lock, [this, &frontier] {
+            return isStopRequested || frontier.isFinished() || (frontier.pendingCount() > 0 && crawlerState.activeSites < config.maxConnections);
+        });
+        if (isStopRequested || frontier.isFinished()) {
+            break;
+        }
+
+        // prefer the sites discovered by the loop the next site is handed to
+        size_t loopId = nextLoop++ % loops.size();
+        SiteFrontier::Site nextSite;
+        if (!frontier.tryPop(loopId, nextSite)) {
+            // the pending count may briefly run ahead of the deques: sleep until a site completes or new
+            // sites arrive instead of spinning on the lock, with a timeout in case neither happens
+            m_condVar.wait_for(m_lock, std::chrono::milliseconds(FRONTIER_RETRY_MS));
+            continue;
         }
+        crawlerState.activeSites++;
+
+        EventLoop* loop = loops[loopId].get();
+        loop->post([this, loopId, loop, nextSite] { startAsyncCrawler(loopId, loop, nextSite.first, nextSite.second); });
     }
 
-    crawlerState.threadsCount--;
-    isThreadFinished = true;
-    m_condVar.notify_one();
+    // after a stop, let the sites still in flight finish before tearing the loops down
+    m_condVar.wait(m_lock, [this] { return crawlerState.activeSites == 0; });
+    m_lock.unlock();
+
+    for (auto& loop : loops) loop->stop();
+    for (auto& thread : loopThreads) thread.join();
 }
 
-void Crawler::writeResultsToConsole(const Socket::SiteStats& stats, int currentDepth) {
-    std::cout << "----------------------------------------------------------------------------" << std::endl;
-    std::cout << " - Website: " << stats.hostname << std::endl;
-    std::cout << " - Depth (distance from the starting pages): " << currentDepth << std::endl;
-    std::cout << " - Pages Discovered: " << stats.discoveredPages.size() << std::endl;
-    std::cout << " - Failed Queries: " << stats.failedQueries << std::endl;
-    std::cout << " - Linked Sites: " << stats.linkedSites.size() << std::endl;
 
-    if (stats.minResponseTime < 0) std::cout << " - Min. Response Time: -" << std::endl;
-    else std::cout << " - Min. Response Time: " << stats.minResponseTime << "ms" << std::endl;
+/**
+ * @brief Starts crawling a given URL on an event loop. Runs on the loop thread.
+ * 
+ * @param loopId The index of the event loop, which selects its deque in the frontier.
+ * @param loop The event loop that drives the site's connections.
+ * @param baseUrl The base URL of the website to crawl.
+ * @param currentDepth The current depth of the crawling process.
+ */
+void Crawler::startAsyncCrawler(size_t loopId, EventLoop* loop, std::string baseUrl, int currentDepth) {
+    Socket* clientSocket = new Socket(baseUrl, serverPort, config.pageLimit, config.crawlDelay, config.maxBodySize, socketServices());
+    clientSocket->initiateDiscoveryAsync(loop, [this, loopId, loop, clientSocket, currentDepth](Socket::SiteStats& stats) {
+        handleSiteResults(loopId, std::move(stats), currentDepth);
+        {
+            std::lock_guard<std::mutex> m_lock(m_mutex);
+            crawlerState.activeSites--;
+        }
+        m_condVar.notify_all();
 
-    if (stats.maxResponseTime < 0) std::cout << " - Max. Response Time: -" << std::endl;
-    else std::cout << " - Max. Response Time: " << stats.maxResponseTime << "ms" << std::endl;
+        // the socket is still on the call stack, so it is released on the next loop iteration
+        loop->post([clientSocket] { delete clientSocket; });
+    });
+}
 
-    if (stats.averageResponseTime < 0) std::cout << " - Avg Response Time: -" << std::endl;
-    else std::cout << " - Avg Response Time: " << stats.averageResponseTime << "ms" << std::endl;
 
-    if (!stats.discoveredPages.empty()) {
-        std::cout << "\n [*] List of visited pages:" << std::endl;
-        std::cout << "    " << std::setw(15) << "Response Time" << "    " << "URL" << std::endl;
-        for (auto& page : stats.discoveredPages) {
-            std::cout << "    " << std::setw(13) << page.second << "ms" << "    " << page.first << std::endl;
+/**
+ * @brief Outputs the statistics of a crawled site and queues its linked sites.
+ * 
+ * No global lock is taken and no I/O is done: the output is handed to the result sink's writer thread,
+ * and linked sites go through the striped discovered set into the worker's own frontier deque.
+ * 
+ * @param workerId The index of the worker that crawled the site.
+ * @param stats The statistics of the crawled site.
+ * @param currentDepth The current depth of the crawling process.
+ */
+void Crawler::handleSiteResults(size_t workerId, Socket::SiteStats stats, int currentDepth) {
+    SiteFrontier& frontier = *crawlerState.frontier;
+    frontier.recordResponseTime(stats.hostname, stats.averageResponseTime);
+
+    // every link raises the priority of the sites still waiting, only the first ones are followed
+    for (int i = 0; i < static_cast<int>(stats.linkedSites.size()); i++) {
+        bool follow = currentDepth < config.depthLimit && i < config.linkedSitesLimit;
+        if (!follow || !discoverSite(workerId, stats.linkedSites[i], currentDepth + 1)) {
+            frontier.addInLink(stats.linkedSites[i]);
         }
     }
-}
 
+    // output the stats (the sink also reports the written sites to the checkpoint), a shard's are merged by the coordinator
+    if (shardClient) {
+        shardClient->submitResult(stats, currentDepth);
+    } else if (config.enableCSVOutput || config.enableBinaryOutput || !config.disableConsoleOutput || checkpoint.isOpen()) {
+        resultSink.submit(std::move(stats), currentDepth);
+    }
+
+    frontier.completeSite();
+}
 
 /**
- * @brief Writes the crawling results to a CSV file.
+ * @brief Runs a crawl split over `shards` crawler processes, coordinated by this one.
  * 
- * @param stats The statistics to write to the CSV file.
+ * The shards are forked before this process starts any thread. The coordinator routes the start sites and
+ * the linked sites to their shards and writes the results (and the metrics) of all of them to one set of files.
+ * 
+ * @param config The configuration of the crawl.
+ * @return True if every shard completed its part of the crawl, otherwise false.
  */
-void Crawler::writeResultsToCsv(const Socket::SiteStats& stats, int currentDepth) {
-    std::lock_guard<std::mutex> csvLock(csvMutex);
-    std::ofstream csvFile("crawl_results.csv", std::ios::app);
-    if (csvFile.is_open()) {
-        csvFile << stats.hostname << ",";
-        csvFile << currentDepth << ",";
-        csvFile << stats.discoveredPages.size() << ",";
-        csvFile << stats.failedQueries << ",";
-        csvFile << stats.linkedSites.size() << ",";
-        csvFile << (stats.minResponseTime < 0 ? "-" : std::to_string(stats.minResponseTime)) << ",";
-        csvFile << (stats.maxResponseTime < 0 ? "-" : std::to_string(stats.maxResponseTime)) << ",";
-        csvFile << (stats.averageResponseTime < 0 ? "-" : std::to_string(stats.averageResponseTime)) << ",";
-        
-        if (stats.discoveredPages.empty()) {
-            csvFile << "None";
-        } else {
-            for (size_t i = 0; i < stats.discoveredPages.size(); ++i) {
-                csvFile << stats.discoveredPages[i].first;
-                if (i != stats.discoveredPages.size() - 1) {
-                    csvFile << "; "; // semicolon as delimiter n the cell
-                }
-            }
+static bool runShardedCrawl(const Config& config) {
+    std::string socketPath = config.shardSocket;
+    if (socketPath.empty()) {
+        std::error_code error;
+        socketPath = (std::filesystem::temp_directory_path(error) / ("threadr-" + std::to_string(getpid()) + ".sock")).string();
+    }
+
+    ShardCoordinator coordinator(config.shards);
+    if (!coordinator.listen(socketPath)) {
+        return false;
+    }
+    if (!config.metricsFile.empty() && !coordinator.exportMetrics(config.metricsFile, config.metricsInterval)) {
+        std::cerr << " [!] Error: Unable to write metrics file: " << config.metricsFile << std::endl;
+        return false;
+    }
+    bool spawned = coordinator.spawn([&config, &socketPath](int shardIndex) {
+        Config shardConfig = config;
+        shardConfig.shardIndex = shardIndex;
+        shardConfig.shardSocket = socketPath;
+        shardConfig.startUrls.clear();
+        shardConfig.enableCSVOutput = false;
+        shardConfig.enableBinaryOutput = false;
+        shardConfig.disableConsoleOutput = true;
+        try {
+            Crawler crawler(shardConfig);
+            crawler.start();
+        } catch (const std::exception& e) {
+            std::cerr << " [!] Error: Exception occurred during crawling. " << e.what() << std::endl;
+            return 1;
         }
-        csvFile << "\n";
+        return 0;
+    });
+    if (!spawned) {
+        return false;
+    }
 
-        csvFile.close();
-    } else {
-        std::cerr << " [!] Error: Failed to open CSV file for writing." << std::endl;
+    ResultSink resultSink(!config.disableConsoleOutput);
+    if (config.enableBinaryOutput && !resultSink.openBinary("crawl_results.trb")) {
+        std::cerr << " [!] Error: Unable to open binary results file" << std::endl;
+        return false;
     }
+    if (config.enableCSVOutput && !resultSink.openCsv("crawl_results.csv")) {
+        std::cerr << " [!] Error: Unable to open CSV file" << std::endl;
+        return false;
+    }
+    resultSink.start();
+    for (auto& url : config.startUrls) {
+        coordinator.addSite(std::string(getHostnameFromUrl(normalizeUrl(url))), 0);
+    }
+
+    bool completed = coordinator.run(resultSink);
+    resultSink.stop();
+    std::cout << " [*] Shards: " << config.shards << ", Sites: " << coordinator.getResultCount()
+              << ", Routed sites: " << coordinator.getRoutedSites() << std::endl;
+    return completed;
 }
 
 int main(int argc, char *argv[]) {
@@ -354,9 +940,16 @@ int main(int argc, char *argv[]) {
     }
 
     try {
-        Crawler crawler(config);
         auto startTime = std::chrono::steady_clock::now();
-        crawler.start();
+        if (config.shards > 1) {
+            if (!runShardedCrawl(config)) {
+                std::cerr << " [!] Error: The sharded crawl failed" << std::endl;
+                return 1;
+            }
+        } else {
+            Crawler crawler(config);
+            crawler.start();
+        }
         auto endTime = std::chrono::steady_clock::now(); // Stop measuring time
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime); // Calculate duration
 
@@ -0,0 +1,180 @@
+/**
+ * @file event_loop.cpp
+ * @brief Implementation of the epoll based event loop used by the non-blocking fetch engine.
+ *
+ * A single EventLoop multiplexes many non-blocking sockets on one thread. It dispatches readiness
+ * events to registered handlers, runs one-shot timers (kept in a hierarchical timer wheel) and executes
+ * tasks posted from other threads.
+ */
+
+#include "event_loop.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+const int MAX_EVENTS_PER_WAIT = 256;
+
+/**
+ * @brief Creates the epoll instance and the eventfd used to wake the loop from other threads.
+ */
+EventLoop::EventLoop() : running(false) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        throw std::runtime_error("Cannot create epoll instance: " + std::string(strerror(errno)));
+    }
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd == -1) {
+        close(epollFd);
+        throw std::runtime_error("Cannot create eventfd: " + std::string(strerror(errno)));
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr; // a null handler marks the wakeup descriptor
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+EventLoop::~EventLoop() {
+    close(wakeFd);
+    close(epollFd);
+}
+
+/**
+ * @brief Registers a file descriptor with the loop.
+ *
+ * @param fd The file descriptor to watch.
+ * @param events The epoll event mask to watch for.
+ * @param handler The handler invoked when the descriptor becomes ready.
+ * @return True if the descriptor was registered, false otherwise.
+ */
+bool EventLoop::addFd(int fd, uint32_t events, EventHandler* handler) {
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = handler;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+/**
+ * @brief Changes the event mask of an already registered file descriptor.
+ *
+ * @param fd The registered file descriptor.
+ * @param events The new epoll event mask.
+ * @param handler The handler invoked when the descriptor becomes ready.
+ * @return True if the registration was updated, false otherwise.
+ */
+bool EventLoop::modifyFd(int fd, uint32_t events, EventHandler* handler) {
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = handler;
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+/**
+ * @brief Stops watching a file descriptor. Must be called before the descriptor is closed.
+ *
+ * @param fd The file descriptor to remove.
+ */
+void EventLoop::removeFd(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+/**
+ * @brief Schedules a task to run on the loop thread after a delay. Must be called from the loop thread.
+ *
+ * @param delayMs The delay in milliseconds.
+ * @param task The task to run.
+ * @return An identifier that can be passed to cancelTimer.
+ */
+uint64_t EventLoop::runAfter(int delayMs, Task task) {
+    return timers.schedule(delayMs, std::move(task));
+}
+
+/**
+ * @brief Cancels a timer that has not fired yet. Must be called from the loop thread.
+ *
+ * @param timerId The identifier returned by runAfter.
+ */
+void EventLoop::cancelTimer(uint64_t timerId) {
+    timers.cancel(timerId);
+}
+
+/**
+ * @brief Queues a task to run on the loop thread. Safe to call from any thread.
+ *
+ * @param task The task to run.
+ */
+void EventLoop::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        pendingTasks.push_back(std::move(task));
+    }
+    wakeup();
+}
+
+/**
+ * @brief Runs the loop on the calling thread until stop() is called.
+ */
+void EventLoop::run() {
+    struct epoll_event events[MAX_EVENTS_PER_WAIT];
+    running = true;
+
+    while (running) {
+        int readyCount = epoll_wait(epollFd, events, MAX_EVENTS_PER_WAIT, timers.nextTimeoutMs(TimerWheel::Clock::now()));
+        if (readyCount == -1 && errno != EINTR) {
+            std::cerr << " [!] Error: epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < readyCount; i++) {
+            EventHandler* handler = static_cast<EventHandler*>(events[i].data.ptr);
+            if (handler == nullptr) {
+                uint64_t counter;
+                while (read(wakeFd, &counter, sizeof(counter)) > 0) {}
+                continue;
+            }
+            handler->handleEvent(events[i].events);
+        }
+
+        runExpiredTimers();
+        runPendingTasks();
+    }
+}
+
+/**
+ * @brief Asks the loop to exit after the current iteration. Safe to call from any thread.
+ */
+void EventLoop::stop() {
+    running = false;
+    wakeup();
+}
+
+void EventLoop::wakeup() {
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        std::cerr << " [!] Error: Cannot wake event loop: " << strerror(errno) << std::endl;
+    }
+}
+
+void EventLoop::runExpiredTimers() {
+    std::vector<Task> expired;
+    timers.advance(TimerWheel::Clock::now(), expired);
+    for (auto& task : expired) {
+        task();
+    }
+}
+
+void EventLoop::runPendingTasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        tasks.swap(pendingTasks);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
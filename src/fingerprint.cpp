@@ -0,0 +1,202 @@
+/**
+ * @file fingerprint.cpp
+ * @brief Implementation of 64-bit URL fingerprints and the compact sets used to deduplicate them.
+ *
+ * Instead of keeping every discovered URL or hostname as a string in a node based container (around
+ * 100 bytes per entry), the crawler keeps a 64-bit fingerprint of it: in an open addressing table of
+ * fingerprints for exact deduplication (8 to 16 bytes per entry), or in a Bloom filter for the global
+ * hostname set of very large crawls (about 1.2 bytes per entry at a 1% false positive rate).
+ */
+
+#include "fingerprint.h"
+#include <algorithm>
+#include <cmath>
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// keep the table at most three quarters full (the capacity is a power of two)
+const size_t MAX_LOAD_NUMERATOR = 3;
+const size_t MAX_LOAD_DENOMINATOR = 4;
+
+/**
+ * @brief Mixes the bits of a 64-bit value (the MurmurHash3 finalizer).
+ *
+ * @param value The value to mix.
+ * @return The mixed value.
+ */
+static uint64_t mix(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+/**
+ * @brief Computes the 64-bit fingerprint of a byte string.
+ *
+ * @param data The bytes to fingerprint.
+ * @param length The number of bytes.
+ * @return The fingerprint, never 0.
+ */
+uint64_t getFingerprint(const char* data, size_t length) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= FNV_PRIME;
+    }
+    hash = mix(hash ^ length);
+    return hash == 0 ? 1 : hash; // 0 marks the empty slots of a FingerprintSet
+}
+
+/**
+ * @brief Computes the fingerprint of a normalized URL, hostname or path.
+ *
+ * A trailing slash of a non-root path does not change the fingerprint, so "/docs" and "/docs/" are
+ * treated as the same page.
+ *
+ * @param url The normalized URL.
+ * @return The fingerprint.
+ */
+uint64_t getUrlFingerprint(std::string_view url) {
+    size_t length = url.size();
+    if (length > 1 && url[length - 1] == '/') {
+        length--;
+    }
+    return getFingerprint(url.data(), length);
+}
+
+/**
+ * @brief Creates an empty fingerprint set.
+ *
+ * @param initialCapacity The number of fingerprints the set can hold before it grows.
+ */
+FingerprintSet::FingerprintSet(size_t initialCapacity) : count(0) {
+    size_t capacity = 16;
+    while (capacity * MAX_LOAD_NUMERATOR / MAX_LOAD_DENOMINATOR < initialCapacity) {
+        capacity *= 2;
+    }
+    slots.assign(capacity, 0);
+    mask = capacity - 1;
+}
+
+/**
+ * @brief Adds a fingerprint to the set.
+ *
+ * @param fingerprint The fingerprint, as returned by getFingerprint (never 0).
+ * @return True if the fingerprint was not in the set yet, false otherwise.
+ */
+bool FingerprintSet::insert(uint64_t fingerprint) {
+    if ((count + 1) * MAX_LOAD_DENOMINATOR > slots.size() * MAX_LOAD_NUMERATOR) {
+        grow();
+    }
+
+    // the fingerprints are already well mixed, so their low bits pick the slot (linear probing)
+    for (size_t slot = fingerprint & mask;; slot = (slot + 1) & mask) {
+        if (slots[slot] == fingerprint) {
+            return false;
+        }
+        if (slots[slot] == 0) {
+            slots[slot] = fingerprint;
+            count++;
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Checks if a fingerprint is in the set.
+ *
+ * @param fingerprint The fingerprint to look for.
+ * @return True if the fingerprint is in the set, otherwise false.
+ */
+bool FingerprintSet::contains(uint64_t fingerprint) const {
+    for (size_t slot = fingerprint & mask;; slot = (slot + 1) & mask) {
+        if (slots[slot] == fingerprint) {
+            return true;
+        }
+        if (slots[slot] == 0) {
+            return false;
+        }
+    }
+}
+
+void FingerprintSet::grow() {
+    std::vector<uint64_t> oldSlots(slots.size() * 2, 0);
+    oldSlots.swap(slots);
+    mask = slots.size() - 1;
+
+    for (uint64_t fingerprint : oldSlots) {
+        if (fingerprint == 0) continue;
+        size_t slot = fingerprint & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = fingerprint;
+    }
+}
+
+/**
+ * @brief Creates an empty Bloom filter sized for a number of items and a false positive rate.
+ *
+ * @param expectedItems The number of items the filter is sized for.
+ * @param falsePositiveRate The probability that an item that was never inserted is reported as present.
+ */
+BloomFilter::BloomFilter(size_t expectedItems, double falsePositiveRate) {
+    const double LN2 = std::log(2.0);
+    double bits = -static_cast<double>(std::max<size_t>(expectedItems, 1)) * std::log(falsePositiveRate) / (LN2 * LN2);
+
+    wordCount = std::max<size_t>(1, static_cast<size_t>(std::ceil(bits / 64)));
+    bitCount = static_cast<uint64_t>(wordCount) * 64;
+    hashCount = std::max(1, static_cast<int>(std::round(bits / std::max<size_t>(expectedItems, 1) * LN2)));
+
+    words.reset(new std::atomic<uint64_t>[wordCount]);
+    for (size_t i = 0; i < wordCount; i++) {
+        words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Adds a fingerprint to the filter. Safe to call from any thread.
+ *
+ * Two threads inserting the same new fingerprint at the same time may both see it as new.
+ *
+ * @param fingerprint The fingerprint to add.
+ * @return True if the fingerprint was definitely not in the filter before, false if it may have been.
+ */
+bool BloomFilter::insert(uint64_t fingerprint) {
+    // double hashing: the i-th probe is h1 + i * h2, both derived from the fingerprint
+    uint64_t h1 = fingerprint;
+    uint64_t h2 = mix(fingerprint) | 1;
+    bool isNew = false;
+
+    for (int i = 0; i < hashCount; i++) {
+        uint64_t bit = (h1 + i * h2) % bitCount;
+        uint64_t flag = 1ULL << (bit % 64);
+        if ((words[bit / 64].fetch_or(flag, std::memory_order_relaxed) & flag) == 0) {
+            isNew = true;
+        }
+    }
+    return isNew;
+}
+
+/**
+ * @brief Checks if a fingerprint may have been added to the filter. Safe to call from any thread.
+ *
+ * @param fingerprint The fingerprint to look for.
+ * @return False if the fingerprint was definitely never added, true if it probably was.
+ */
+bool BloomFilter::mayContain(uint64_t fingerprint) const {
+    uint64_t h1 = fingerprint;
+    uint64_t h2 = mix(fingerprint) | 1;
+
+    for (int i = 0; i < hashCount; i++) {
+        uint64_t bit = (h1 + i * h2) % bitCount;
+        if ((words[bit / 64].load(std::memory_order_relaxed) & (1ULL << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,371 @@
+/**
+ * @file frontier.cpp
+ * @brief Implementation of the sharded, work-stealing site frontier.
+ * 
+ * Every worker owns a deque of pending sites: it pushes the sites it discovers to its own deque and
+ * takes work from the front of it, and only when it runs dry it steals from the back of the other
+ * workers' deques. Discovered hostnames are deduplicated by their 64-bit fingerprint, either exactly in a
+ * fingerprint set split into independently locked stripes, or approximately in a lock-free Bloom filter
+ * for crawls with too many hosts to remember exactly. Enqueueing a linked site therefore only ever contends with the few workers touching the same
+ * deque or stripe, instead of serializing every worker on one global lock. Idle workers wait in the
+ * scheduler, which the frontier wakes through a listener whenever new work arrives or the crawl ends.
+ * 
+ * With a memory limit, the deques form the hot head of the frontier: once they hold more sites than the
+ * limit allows, new sites are spilled to segment files on disk (see SpillQueue), and whole segments are
+ * read back into the deques as they drain.
+ * 
+ * In priority order, the deques are replaced by a single indexed heap: the site with the best score is
+ * crawled first, where the score rewards in-links and penalizes depth and slow domains. Every link found
+ * to a site that is still queued in memory raises its score in O(log n).
+ */
+
+#include "frontier.h"
+#include "public_suffix.h"
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+const double BLOOM_FALSE_POSITIVE_RATE = 0.01;
+
+// weights of the site score in priority order
+const double IN_LINK_WEIGHT = 4.0;
+const double DEPTH_WEIGHT = 2.0;
+const double RESPONSE_TIME_WEIGHT = 1.0;
+const double RESPONSE_TIME_SCALE_MS = 100.0;
+const double SEQUENCE_WEIGHT = 1e-12; // breaks ties in discovery order
+
+// estimated memory used by a site in a deque, on top of its hostname
+const size_t SITE_MEMORY_OVERHEAD = sizeof(SiteFrontier::Site) + 16;
+
+static long getSiteMemory(const SiteFrontier::Site& site) {
+    return static_cast<long>(SITE_MEMORY_OVERHEAD + site.first.size());
+}
+
+/**
+ * @brief Constructs a SiteFrontier object with the specified params.
+ * 
+ * @param workerCount The number of workers, each of which gets its own deque.
+ * @param bloomFilterHosts If not 0, hostnames are deduplicated with a Bloom filter sized for this many hosts.
+ * @param seenStripeCount The number of independently locked stripes of the discovered hostnames set.
+ */
+SiteFrontier::SiteFrontier(int workerCount, size_t bloomFilterHosts, int seenStripeCount)
+    : order(Order::Fifo), nextSequence(0), memoryLimit(0), memoryBytes(0), pendingSites(0), outstandingSites(0), closed(false) {
+    for (int i = 0; i < std::max(1, workerCount); i++) {
+        queues.emplace_back(new WorkerQueue());
+    }
+    if (bloomFilterHosts > 0) {
+        seenFilter.reset(new BloomFilter(bloomFilterHosts, BLOOM_FALSE_POSITIVE_RATE));
+        return;
+    }
+    for (int i = 0; i < std::max(1, seenStripeCount); i++) {
+        seenStripes.emplace_back(new SeenStripe());
+    }
+}
+
+/**
+ * @brief Sets the order in which sites are crawled. Must be called before the crawl starts.
+ * 
+ * @param order Fifo crawls sites breadth-first (per worker, with work stealing), Priority by score.
+ */
+void SiteFrontier::setOrder(Order order) {
+    this->order = order;
+}
+
+/**
+ * @brief Bounds the memory used by the pending sites, spilling the sites beyond it to disk.
+ * 
+ * Must be called before the crawl starts.
+ * 
+ * @param bytes The memory budget of the deques, 0 for no limit.
+ * @param spillDirectory The directory the segment files are created in, the system temporary directory if empty.
+ * @return True if the limit is in effect, false if the spill directory could not be created.
+ */
+bool SiteFrontier::setMemoryLimit(size_t bytes, const std::string& spillDirectory) {
+    memoryLimit = bytes;
+    spillQueue.reset();
+    if (bytes == 0) {
+        return true;
+    }
+    spillQueue.reset(new SpillQueue());
+    if (!spillQueue->open(spillDirectory)) {
+        spillQueue.reset();
+        memoryLimit = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Marks a hostname as discovered.
+ * 
+ * With a Bloom filter, a small fraction of new hostnames is wrongly reported as already discovered.
+ * 
+ * @param hostname The hostname to mark.
+ * @return True if the hostname was seen for the first time, false if it was already discovered.
+ */
+bool SiteFrontier::markDiscovered(const std::string& hostname) {
+    return markDiscovered(getUrlFingerprint(hostname));
+}
+
+/**
+ * @brief Marks a hostname as discovered by its fingerprint, e.g. when restoring a checkpoint.
+ * 
+ * @param fingerprint The fingerprint of the hostname, see getUrlFingerprint().
+ * @return True if the hostname was seen for the first time, false if it was already discovered.
+ */
+bool SiteFrontier::markDiscovered(uint64_t fingerprint) {
+    if (seenFilter) {
+        return seenFilter->insert(fingerprint);
+    }
+
+    // the stripe is picked with the high bits, the set uses the low bits
+    SeenStripe& stripe = *seenStripes[(fingerprint >> 32) % seenStripes.size()];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.hostnames.insert(fingerprint);
+}
+
+/**
+ * @brief Queues a site on the deque of the given worker.
+ * 
+ * Must be called either before the crawl starts or by a worker that has not yet called completeSite()
+ * for the site it is processing, so the crawl cannot be considered finished in between.
+ * 
+ * @param worker The index of the worker that discovered the site.
+ * @param site The hostname of the site and its depth.
+ */
+void SiteFrontier::push(size_t worker, const Site& site) {
+    outstandingSites++;
+    long siteMemory = getSiteMemory(site);
+    bool spilled = spillQueue && memoryBytes.load() + siteMemory > static_cast<long>(memoryLimit) && spillQueue->push(site);
+    if (!spilled) {
+        memoryBytes += siteMemory;
+        pushMemory(worker, site);
+    }
+    pendingSites++;
+
+    wakeWorkers(false);
+}
+
+/**
+ * @brief Takes a site without blocking, from the worker's own deque first and then from the others.
+ * 
+ * @param worker The index of the worker asking for work.
+ * @param site Receives the hostname of the site and its depth.
+ * @return True if a site was taken, false if no site is pending.
+ */
+bool SiteFrontier::tryPop(size_t worker, Site& site) {
+    if (closed.load()) {
+        return false;
+    }
+
+    bool refilled = false;
+    while (true) {
+        if (popMemory(worker, site)) {
+            pendingSites--;
+            memoryBytes -= getSiteMemory(site);
+            // read the next segment back before the deques run dry
+            if (spillQueue && memoryBytes.load() < static_cast<long>(memoryLimit / 2) && spillQueue->size() > 0) {
+                refill(worker);
+            }
+            return true;
+        }
+
+        if (refilled || !refill(worker)) {
+            return false;
+        }
+        refilled = true;
+    }
+}
+
+/**
+ * @brief Moves the oldest batch of spilled sites to the deque of the given worker.
+ * 
+ * @param worker The index of the worker that gets the sites.
+ * @return True if sites were moved, otherwise false.
+ */
+bool SiteFrontier::refill(size_t worker) {
+    if (!spillQueue || spillQueue->size() == 0) {
+        return false;
+    }
+
+    std::vector<Site> sites;
+    size_t lostSites = 0;
+    spillQueue->popBatch(sites, lostSites);
+    for (Site& site : sites) {
+        memoryBytes += getSiteMemory(site);
+        pushMemory(worker, std::move(site));
+    }
+
+    // sites that could not be read back are given up, so the crawl can still finish
+    for (size_t i = 0; i < lostSites; i++) {
+        pendingSites--;
+        completeSite();
+    }
+    if (sites.size() > 1) {
+        wakeWorkers(true);
+    }
+    return !sites.empty();
+}
+
+/**
+ * @brief Queues a site in memory: on the deque of the given worker, or in the priority queue.
+ * 
+ * @param worker The index of the worker that discovered the site.
+ * @param site The hostname of the site and its depth.
+ */
+void SiteFrontier::pushMemory(size_t worker, Site site) {
+    if (order == Order::Priority) {
+        PrioritySite prioritySite;
+        uint64_t fingerprint = getUrlFingerprint(site.first);
+        prioritySite.inLinks = site.second > 0 ? 1 : 0; // the site was found on a page of the previous depth
+        prioritySite.site = std::move(site);
+
+        std::lock_guard<std::mutex> lock(priorityMutex);
+        prioritySite.sequence = nextSequence++;
+        double priority = getPriority(prioritySite);
+        priorityQueue.push(fingerprint, priority, std::move(prioritySite));
+        return;
+    }
+
+    WorkerQueue& queue = *queues[worker % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.sites.push_back(std::move(site));
+}
+
+/**
+ * @brief Takes a site queued in memory: the best scored one, or from the deques.
+ * 
+ * @param worker The index of the worker asking for work.
+ * @param site Receives the hostname of the site and its depth.
+ * @return True if a site was taken, otherwise false.
+ */
+bool SiteFrontier::popMemory(size_t worker, Site& site) {
+    if (order == Order::Priority) {
+        std::lock_guard<std::mutex> lock(priorityMutex);
+        if (priorityQueue.empty()) {
+            return false;
+        }
+        site = std::move(priorityQueue.pop().site);
+        return true;
+    }
+
+    size_t own = worker % queues.size();
+    for (size_t i = 0; i < queues.size(); i++) {
+        WorkerQueue& queue = *queues[(own + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.sites.empty()) {
+            // the own deque is used from the front, the others are stolen from the back
+            if (i == 0) {
+                site = std::move(queue.sites.front());
+                queue.sites.pop_front();
+            } else {
+                site = std::move(queue.sites.back());
+                queue.sites.pop_back();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Counts a link to an already discovered site, which raises its score if it is still queued.
+ * 
+ * Only has an effect in priority order, and not for sites spilled to disk.
+ * 
+ * @param hostname The hostname of the linked site.
+ */
+void SiteFrontier::addInLink(const std::string& hostname) {
+    if (order != Order::Priority) {
+        return;
+    }
+    uint64_t fingerprint = getUrlFingerprint(hostname);
+    std::lock_guard<std::mutex> lock(priorityMutex);
+    PrioritySite* site = priorityQueue.find(fingerprint);
+    if (site != nullptr) {
+        site->inLinks++;
+        priorityQueue.update(fingerprint, getPriority(*site));
+    }
+}
+
+/**
+ * @brief Records how fast a crawled site responded, which scores the queued sites of the same domain.
+ * 
+ * Only has an effect in priority order. Sites already queued keep their score until they get a new in-link.
+ * 
+ * @param hostname The hostname of the crawled site.
+ * @param averageResponseTime The average response time of its pages in milliseconds, negative if unknown.
+ */
+void SiteFrontier::recordResponseTime(const std::string& hostname, double averageResponseTime) {
+    if (order != Order::Priority || averageResponseTime < 0) {
+        return;
+    }
+    std::string domain(getRegistrableDomain(hostname));
+    std::lock_guard<std::mutex> lock(priorityMutex);
+    auto it = domainResponseTimes.find(domain);
+    if (it == domainResponseTimes.end()) {
+        domainResponseTimes.emplace(std::move(domain), averageResponseTime);
+    } else {
+        it->second = (it->second + averageResponseTime) / 2; // favors the recent sites of the domain
+    }
+}
+
+/**
+ * @brief Scores a queued site, higher is crawled first. Must be called with the priority lock held.
+ * 
+ * @param site The queued site.
+ * @return The score of the site.
+ */
+double SiteFrontier::getPriority(const PrioritySite& site) {
+    double priority = IN_LINK_WEIGHT * std::log2(1.0 + site.inLinks) - DEPTH_WEIGHT * site.site.second;
+    if (!domainResponseTimes.empty()) {
+        auto it = domainResponseTimes.find(std::string(getRegistrableDomain(site.site.first)));
+        if (it != domainResponseTimes.end()) {
+            priority -= RESPONSE_TIME_WEIGHT * std::log2(1.0 + it->second / RESPONSE_TIME_SCALE_MS);
+        }
+    }
+    return priority - SEQUENCE_WEIGHT * static_cast<double>(site.sequence);
+}
+
+/**
+ * @brief Sets the callback used to wake waiting workers. Must be set before the crawl starts.
+ * 
+ * @param listener Callback invoked after a push (with false, one worker is enough) and when the crawl
+ *                 finishes or the frontier is closed (with true, every worker must re-check).
+ */
+void SiteFrontier::setWakeListener(std::function<void(bool)> listener) {
+    wakeListener = std::move(listener);
+}
+
+/**
+ * @brief Reports that a popped site has been fully processed, after its linked sites were pushed.
+ * 
+ * The crawl is finished once every pushed site has been completed.
+ */
+void SiteFrontier::completeSite() {
+    if (--outstandingSites == 0) {
+        wakeWorkers(true);
+    }
+}
+
+/**
+ * @brief Keeps the crawl from finishing until the matching completeSite(), e.g. while other processes
+ *        may still send sites.
+ */
+void SiteFrontier::hold() {
+    outstandingSites++;
+}
+
+/**
+ * @brief Stops handing out sites and releases every waiting worker.
+ */
+void SiteFrontier::close() {
+    closed = true;
+    wakeWorkers(true);
+}
+
+void SiteFrontier::wakeWorkers(bool all) {
+    if (wakeListener) {
+        wakeListener(all);
+    }
+}
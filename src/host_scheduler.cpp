@@ -0,0 +1,241 @@
+/**
+ * @file host_scheduler.cpp
+ * @brief Implementation of the politeness scheduler used by the worker pool.
+ * 
+ * Instead of sleeping for the crawl delay between two pages of the same host, a worker parks the host
+ * in a timer wheel keyed by its next allowed fetch time and moves on to whichever host is ready now, or
+ * starts a new site from the frontier. Politeness is still enforced per host (one fetch in flight, then
+ * the delay), but worker threads never sit idle while there is a host they are allowed to fetch from.
+ * 
+ * Like the frontier, the scheduler is sharded per worker: every worker parks the hosts it fetched from in
+ * its own timer wheel and ready queue, under its own lock. Only a worker that has nothing to do on its own
+ * shard and cannot start a new site steals ready hosts from the other shards, and then sleeps on a shared
+ * condition variable until one of them, or the frontier, has work again.
+ */
+
+#include "host_scheduler.h"
+#include <algorithm>
+
+/**
+ * @brief Constructs a HostScheduler object with the specified params.
+ * 
+ * @param maxActiveHosts The maximum number of sites being crawled at once, waiting hosts included.
+ * @param workerCount The number of workers, each of which gets its own shard.
+ */
+HostScheduler::HostScheduler(int maxActiveHosts, int workerCount)
+    : maxActiveHosts(std::max(1, maxActiveHosts)), activeHosts(0), idleWorkers(0), wakeups(0) {
+    for (int i = 0; i < std::max(1, workerCount); i++) {
+        shards.emplace_back(new Shard());
+    }
+}
+
+/**
+ * @brief Waits until the calling worker has something to do.
+ * 
+ * The worker's own shard is checked first, then a new site is started if a slot is free, and only then
+ * are ready hosts stolen from the other shards.
+ * 
+ * @param worker The index of the calling worker, which selects its shard.
+ * @param host Receives the host to fetch from when Work::Fetch is returned.
+ * @param hasNewSites Tells whether the frontier has pending sites.
+ * @param isFinished Tells whether the crawl is over.
+ * @return Work::Fetch to fetch the next page of `host`, Work::StartSite to take a new site from the
+ *         frontier (a slot has been reserved for it, see releaseSlot()), or Work::Finished to exit.
+ */
+HostScheduler::Work HostScheduler::waitForWork(size_t worker, Host*& host, const std::function<bool()>& hasNewSites, const std::function<bool()>& isFinished) {
+    size_t own = worker % shards.size();
+    bool idle = false;
+    uint64_t seenWakeups = 0;
+
+    while (true) {
+        if (isFinished()) {
+            if (idle) idleWorkers--;
+            return Work::Finished;
+        }
+
+        int timeoutMs = -1;
+        if (takeReady(*shards[own], false, host, timeoutMs)) {
+            if (idle) idleWorkers--;
+            return Work::Fetch;
+        }
+
+        if (hasNewSites() && reserveSlot()) {
+            if (idle) idleWorkers--;
+            return Work::StartSite;
+        }
+
+        if (!idle) {
+            // announce the worker before looking at the other shards, so no work published meanwhile is missed
+            idle = true;
+            idleWorkers++;
+            std::lock_guard<std::mutex> lock(idleMutex);
+            seenWakeups = wakeups;
+            continue;
+        }
+
+        for (size_t i = 1; i < shards.size(); i++) {
+            if (takeReady(*shards[(own + i) % shards.size()], true, host, timeoutMs)) {
+                idleWorkers--;
+                return Work::Fetch;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex);
+        auto isWoken = [this, seenWakeups] { return wakeups != seenWakeups; };
+        if (timeoutMs < 0) {
+            idleCondVar.wait(lock, isWoken);
+        } else if (timeoutMs > 0) {
+            idleCondVar.wait_for(lock, std::chrono::milliseconds(timeoutMs), isWoken);
+        }
+        seenWakeups = wakeups;
+    }
+}
+
+/**
+ * @brief Takes a host whose crawl delay has elapsed from a shard.
+ * 
+ * @param shard The shard to take the host from.
+ * @param steal Whether the shard belongs to another worker, whose own hosts are then taken from the back.
+ * @param host Receives the host.
+ * @param timeoutMs Lowered to the time in milliseconds until the next host of the shard becomes ready.
+ * @return True if a host was taken, otherwise false.
+ */
+bool HostScheduler::takeReady(Shard& shard, bool steal, Host*& host, int& timeoutMs) {
+    std::vector<TimerWheel::Task> expired;
+    bool hasMore = false;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto now = TimerWheel::Clock::now();
+        shard.wheel.advance(now, expired);
+        for (auto& task : expired) {
+            task();
+        }
+
+        if (shard.readyHosts.empty()) {
+            int shardTimeoutMs = shard.wheel.nextTimeoutMs(now);
+            if (shardTimeoutMs >= 0 && (timeoutMs < 0 || shardTimeoutMs < timeoutMs)) {
+                timeoutMs = shardTimeoutMs;
+            }
+            return false;
+        }
+
+        if (steal) {
+            host = shard.readyHosts.back();
+            shard.readyHosts.pop_back();
+        } else {
+            host = shard.readyHosts.front();
+            shard.readyHosts.pop_front();
+        }
+        hasMore = !shard.readyHosts.empty();
+    }
+
+    if (hasMore) {
+        wakeIdle(false);
+    }
+    return true;
+}
+
+/**
+ * @brief Reserves a slot for a new site if fewer than `maxActiveHosts` sites are being crawled.
+ * 
+ * @return True if a slot was reserved, otherwise false.
+ */
+bool HostScheduler::reserveSlot() {
+    int active = activeHosts.load();
+    while (active < maxActiveHosts) {
+        if (activeHosts.compare_exchange_weak(active, active + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Takes ownership of a newly started site, using the slot reserved by Work::StartSite.
+ * 
+ * @param worker The index of the worker that started the site, whose shard owns the host.
+ * @param socket The Socket crawling the site.
+ * @param depth The depth of the site.
+ * @return The host handle to pass to schedule() and retire().
+ */
+HostScheduler::Host* HostScheduler::admit(size_t worker, std::unique_ptr<Socket> socket, int depth) {
+    size_t own = worker % shards.size();
+    std::unique_ptr<Host> host(new Host{std::move(socket), depth, own});
+    Host* handle = host.get();
+
+    Shard& shard = *shards[own];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.hosts[handle] = std::move(host);
+    return handle;
+}
+
+/**
+ * @brief Parks a host on the worker's shard until its next fetch is allowed.
+ * 
+ * @param worker The index of the worker that fetched from the host.
+ * @param host The host to park.
+ * @param delayMs The time in milliseconds until the host may be fetched from again.
+ */
+void HostScheduler::schedule(size_t worker, Host* host, int delayMs) {
+    Shard& shard = *shards[worker % shards.size()];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (delayMs <= 0) {
+            shard.readyHosts.push_back(host);
+        } else {
+            shard.wheel.schedule(delayMs, [&shard, host] { shard.readyHosts.push_back(host); });
+        }
+    }
+    // a sleeping worker may need to shorten its timeout for this host
+    wakeIdle(false);
+}
+
+/**
+ * @brief Destroys a host whose site is fully crawled and frees its slot.
+ * 
+ * @param host The host to destroy.
+ */
+void HostScheduler::retire(Host* host) {
+    {
+        Shard& shard = *shards[host->shard];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.hosts.erase(host);
+    }
+    releaseSlot();
+}
+
+/**
+ * @brief Frees a slot reserved by Work::StartSite, e.g. when another worker took the site first.
+ */
+void HostScheduler::releaseSlot() {
+    activeHosts--;
+    wakeIdle(false);
+}
+
+/**
+ * @brief Wakes waiting workers after a change outside the scheduler, such as new sites in the frontier.
+ * 
+ * @param wakeAll Whether every waiting worker must re-check (e.g. the crawl finished) or just one.
+ */
+void HostScheduler::notify(bool wakeAll) {
+    wakeIdle(wakeAll);
+}
+
+/**
+ * @brief Wakes idle workers, without touching the shared lock while every worker is busy.
+ * 
+ * @param wakeAll Whether every idle worker must re-check or just one.
+ */
+void HostScheduler::wakeIdle(bool wakeAll) {
+    if (!wakeAll && idleWorkers.load() == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(idleMutex);
+    wakeups++;
+    if (wakeAll) {
+        idleCondVar.notify_all();
+    } else {
+        idleCondVar.notify_one();
+    }
+}
@@ -0,0 +1,308 @@
+/**
+ * @file http.cpp
+ * @brief Implementation of an incremental HTTP/1.1 response parser.
+ *
+ * The parser consumes a response chunk by chunk as it is received and works out the message framing
+ * (Content-Length, chunked transfer encoding or read-until-close), so the end of a response can be
+ * detected without waiting for the server to close the connection. The decoded body (without chunk
+ * framing) is handed to a body handler as it arrives, and the headers the crawler acts upon (status,
+ * Content-Type, Content-Encoding, Location, Retry-After) are kept.
+ */
+
+#include "http.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+const size_t MAX_LINE_LENGTH = 8192;
+
+/**
+ * @brief Checks if two strings are equal, ignoring ASCII case.
+ *
+ * @param a The first string.
+ * @param b The second string.
+ * @return True if the strings are equal ignoring case, otherwise false.
+ */
+static bool equalsIgnoreCase(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return tolower(static_cast<unsigned char>(x)) == tolower(static_cast<unsigned char>(y));
+    });
+}
+
+/**
+ * @brief Checks if a comma separated header value contains a token, ignoring ASCII case.
+ *
+ * @param value The header value.
+ * @param token The token to look for.
+ * @return True if the token is part of the value, otherwise false.
+ */
+static bool containsToken(const std::string& value, const std::string& token) {
+    size_t start = 0;
+    while (start < value.size()) {
+        size_t end = value.find(',', start);
+        if (end == std::string::npos) end = value.size();
+
+        size_t first = start, last = end;
+        while (first < last && (value[first] == ' ' || value[first] == '\t')) first++;
+        while (last > first && (value[last - 1] == ' ' || value[last - 1] == '\t')) last--;
+
+        if (equalsIgnoreCase(value.substr(first, last - first), token)) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+HttpResponseParser::HttpResponseParser() {
+    reset();
+}
+
+/**
+ * @brief Sets the callback that receives the decoded body of each response, chunk by chunk.
+ *
+ * @param handler The callback, invoked from feed().
+ */
+void HttpResponseParser::setBodyHandler(BodyHandler handler) {
+    bodyHandler = std::move(handler);
+}
+
+/**
+ * @brief Prepares the parser for a new response.
+ */
+void HttpResponseParser::reset() {
+    state = State::StatusLine;
+    lineBuffer.clear();
+    statusCode = 0;
+    http11 = false;
+    connectionClose = false;
+    connectionKeepAlive = false;
+    chunked = false;
+    untilClose = false;
+    contentLength = -1;
+    remainingBytes = 0;
+    contentType.clear();
+    contentEncoding.clear();
+    location.clear();
+    retryAfter = -1;
+}
+
+/**
+ * @brief Feeds the next chunk of the response to the parser.
+ *
+ * @param data The received bytes.
+ * @param length The number of received bytes.
+ * @return The number of bytes that belong to the current response. Any remaining bytes follow the end of the message.
+ */
+size_t HttpResponseParser::feed(const char* data, size_t length) {
+    size_t pos = 0;
+
+    while (pos < length && state != State::Complete && state != State::Error) {
+        switch (state) {
+            case State::StatusLine:
+                if (readLine(data, length, pos)) {
+                    if (lineBuffer.empty()) break; // tolerate stray CRLF before the status line
+                    parseStatusLine();
+                    lineBuffer.clear();
+                }
+                break;
+
+            case State::Headers:
+                if (readLine(data, length, pos)) {
+                    if (lineBuffer.empty()) {
+                        startBody();
+                    } else {
+                        parseHeaderLine();
+                    }
+                    lineBuffer.clear();
+                }
+                break;
+
+            case State::Body:
+            case State::ChunkData: {
+                size_t available = std::min(static_cast<long long>(length - pos), remainingBytes);
+                deliverBody(data + pos, available);
+                pos += available;
+                remainingBytes -= available;
+                if (remainingBytes == 0) {
+                    state = (state == State::Body) ? State::Complete : State::ChunkDataEnd;
+                }
+                break;
+            }
+
+            case State::ChunkSize:
+                if (readLine(data, length, pos)) {
+                    char* end = nullptr;
+                    remainingBytes = strtoll(lineBuffer.c_str(), &end, 16);
+                    if (end == lineBuffer.c_str() || remainingBytes < 0) {
+                        state = State::Error;
+                    } else {
+                        state = (remainingBytes == 0) ? State::Trailers : State::ChunkData;
+                    }
+                    lineBuffer.clear();
+                }
+                break;
+
+            case State::ChunkDataEnd:
+                if (readLine(data, length, pos)) {
+                    state = lineBuffer.empty() ? State::ChunkSize : State::Error;
+                    lineBuffer.clear();
+                }
+                break;
+
+            case State::Trailers:
+                if (readLine(data, length, pos)) {
+                    if (lineBuffer.empty()) state = State::Complete;
+                    lineBuffer.clear();
+                }
+                break;
+
+            case State::UntilClose:
+                deliverBody(data + pos, length - pos);
+                pos = length;
+                break;
+
+            case State::Complete:
+            case State::Error:
+                break;
+        }
+    }
+
+    return pos;
+}
+
+/**
+ * @brief Signals that the peer closed the connection, which ends a read-until-close body.
+ */
+void HttpResponseParser::finish() {
+    if (state == State::UntilClose) {
+        state = State::Complete;
+    } else if (state != State::Complete) {
+        state = State::Error;
+    }
+}
+
+/**
+ * @brief Checks if the connection can be reused for another request once this response is complete.
+ *
+ * @return True if the server allows keeping the connection open, otherwise false. A body read until
+ *         the server closed the connection leaves nothing to reuse.
+ */
+bool HttpResponseParser::isKeepAlive() const {
+    if (state != State::Complete || connectionClose || untilClose) {
+        return false;
+    }
+    return http11 || connectionKeepAlive;
+}
+
+/**
+ * @brief Checks if the body is an HTML document, the only kind of body links are extracted from.
+ *
+ * A response without Content-Type is assumed to be HTML.
+ *
+ * @return True if the Content-Type is missing, text/html or application/xhtml+xml, otherwise false.
+ */
+bool HttpResponseParser::isHtml() const {
+    size_t typeEnd = std::min(contentType.find(';'), contentType.size());
+    while (typeEnd > 0 && (contentType[typeEnd - 1] == ' ' || contentType[typeEnd - 1] == '\t')) typeEnd--;
+
+    std::string mediaType = contentType.substr(0, typeEnd);
+    return mediaType.empty() || equalsIgnoreCase(mediaType, "text/html") || equalsIgnoreCase(mediaType, "application/xhtml+xml");
+}
+
+/**
+ * @brief Accumulates bytes up to the next CRLF (or bare LF) into the line buffer.
+ *
+ * @param data The received bytes.
+ * @param length The number of received bytes.
+ * @param pos The current read position, advanced past the consumed bytes.
+ * @return True if a full line is available in the line buffer, false if more data is needed.
+ */
+bool HttpResponseParser::readLine(const char* data, size_t length, size_t& pos) {
+    const char* lineEnd = static_cast<const char*>(memchr(data + pos, '\n', length - pos));
+    size_t end = lineEnd ? lineEnd - data : length;
+
+    lineBuffer.append(data + pos, end - pos);
+    pos = lineEnd ? end + 1 : length;
+
+    if (lineBuffer.size() > MAX_LINE_LENGTH) {
+        state = State::Error;
+        return false;
+    }
+    if (!lineEnd) {
+        return false;
+    }
+    if (!lineBuffer.empty() && lineBuffer.back() == '\r') {
+        lineBuffer.pop_back();
+    }
+    return true;
+}
+
+void HttpResponseParser::parseStatusLine() {
+    // e.g. "HTTP/1.1 200 OK"
+    if (lineBuffer.compare(0, 5, "HTTP/") != 0 || lineBuffer.size() < 12) {
+        state = State::Error;
+        return;
+    }
+
+    http11 = lineBuffer.compare(5, 3, "1.1") == 0;
+    statusCode = atoi(lineBuffer.c_str() + 9);
+    state = State::Headers;
+}
+
+void HttpResponseParser::parseHeaderLine() {
+    size_t colon = lineBuffer.find(':');
+    if (colon == std::string::npos) {
+        return;
+    }
+
+    std::string name = lineBuffer.substr(0, colon);
+    size_t valueStart = lineBuffer.find_first_not_of(" \t", colon + 1);
+    std::string value = valueStart == std::string::npos ? "" : lineBuffer.substr(valueStart);
+
+    if (equalsIgnoreCase(name, "Content-Length")) {
+        contentLength = strtoll(value.c_str(), nullptr, 10);
+    } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+        chunked = containsToken(value, "chunked");
+    } else if (equalsIgnoreCase(name, "Content-Type")) {
+        contentType = value;
+    } else if (equalsIgnoreCase(name, "Content-Encoding")) {
+        contentEncoding = value;
+    } else if (equalsIgnoreCase(name, "Location")) {
+        location = value;
+    } else if (equalsIgnoreCase(name, "Retry-After")) {
+        retryAfter = isdigit(static_cast<unsigned char>(value[0])) ? atoi(value.c_str()) : -1; // an HTTP-date is ignored
+    } else if (equalsIgnoreCase(name, "Connection")) {
+        connectionClose = containsToken(value, "close");
+        connectionKeepAlive = containsToken(value, "keep-alive");
+    }
+}
+
+/**
+ * @brief Chooses the body framing once all headers have been read.
+ */
+void HttpResponseParser::startBody() {
+    if (statusCode >= 100 && statusCode < 200) {
+        reset(); // interim response, the real one follows
+        return;
+    }
+
+    if (statusCode == 204 || statusCode == 304) {
+        state = State::Complete;
+    } else if (chunked) {
+        state = State::ChunkSize;
+    } else if (contentLength >= 0) {
+        remainingBytes = contentLength;
+        state = (contentLength == 0) ? State::Complete : State::Body;
+    } else {
+        state = State::UntilClose;
+        untilClose = true;
+    }
+}
+
+void HttpResponseParser::deliverBody(const char* data, size_t length) {
+    if (length > 0 && bodyHandler) {
+        bodyHandler(data, length);
+    }
+}
@@ -0,0 +1,177 @@
+/**
+ * @file inflater.cpp
+ * @brief Implementation of the streaming gzip/deflate body decoder.
+ *
+ * The body is inflated chunk by chunk as it is received and every decoded chunk is handed on right
+ * away, so a compressed page is scanned for links without ever being buffered whole. zlib detects the
+ * gzip and zlib headers by itself; a "deflate" body without the zlib header (raw deflate, as sent by a
+ * number of servers) is retried as such when its first bytes fail the header check. Those two bytes may
+ * arrive in separate chunks, so they are kept until the check has passed and replayed for the retry.
+ */
+
+#include "inflater.h"
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+const size_t OUTPUT_BUFFER_SIZE = 32768;
+const int WINDOW_BITS = 15;
+const int DETECT_HEADER = 32; // added to the window bits: accept both the gzip and the zlib header
+const size_t HEADER_SIZE = 2; // of a zlib stream, the bytes its header check is made on
+// contexts kept per thread; a thread decoding more bodies at once (an event loop) allocates the others
+const size_t MAX_POOLED_INFLATERS = 16;
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return tolower(static_cast<unsigned char>(x)) == tolower(static_cast<unsigned char>(y));
+    });
+}
+
+/**
+ * @brief Parses the Content-Encoding of a response.
+ *
+ * @param contentEncoding The value of the Content-Encoding header, empty if there is none.
+ * @return The encoding, Unsupported for any other encoding or for several stacked ones.
+ */
+Inflater::Encoding Inflater::parseEncoding(std::string_view contentEncoding) {
+    size_t start = contentEncoding.find_first_not_of(" \t");
+    if (start == std::string_view::npos) {
+        return Encoding::Identity;
+    }
+    contentEncoding = contentEncoding.substr(start, contentEncoding.find_last_not_of(" \t") - start + 1);
+
+    if (equalsIgnoreCase(contentEncoding, "gzip") || equalsIgnoreCase(contentEncoding, "x-gzip")) {
+        return Encoding::Gzip;
+    }
+    if (equalsIgnoreCase(contentEncoding, "deflate")) {
+        return Encoding::Deflate;
+    }
+    if (equalsIgnoreCase(contentEncoding, "identity")) {
+        return Encoding::Identity;
+    }
+    return Encoding::Unsupported;
+}
+
+static std::vector<std::unique_ptr<Inflater>>& getPool() {
+    thread_local std::vector<std::unique_ptr<Inflater>> pool;
+    return pool;
+}
+
+/**
+ * @brief Takes a decoder from the calling thread's pool, or creates one.
+ *
+ * @param encoding The encoding of the body, Gzip or Deflate.
+ * @return The decoder, ready for a new body, or nullptr if zlib cannot allocate its state.
+ */
+std::unique_ptr<Inflater> Inflater::acquire(Encoding encoding) {
+    std::vector<std::unique_ptr<Inflater>>& pool = getPool();
+    std::unique_ptr<Inflater> inflater;
+    if (!pool.empty()) {
+        inflater = std::move(pool.back());
+        pool.pop_back();
+    } else {
+        inflater.reset(new Inflater());
+    }
+    if (!inflater->reset(encoding)) {
+        return nullptr;
+    }
+    return inflater;
+}
+
+/**
+ * @brief Gives a decoder back to the calling thread's pool once its body is done.
+ *
+ * @param inflater The decoder, may be nullptr.
+ */
+void Inflater::release(std::unique_ptr<Inflater> inflater) {
+    std::vector<std::unique_ptr<Inflater>>& pool = getPool();
+    if (inflater && pool.size() < MAX_POOLED_INFLATERS) {
+        pool.push_back(std::move(inflater));
+    }
+}
+
+Inflater::Inflater() : initialized(false), allowRawDeflate(false), finished(false), header(), inputBytes(0), outputBytes(0),
+                       outputBuffer(new char[OUTPUT_BUFFER_SIZE]) {
+    stream = z_stream();
+}
+
+Inflater::~Inflater() {
+    if (initialized) {
+        inflateEnd(&stream);
+    }
+}
+
+/**
+ * @brief Decodes the next chunk of the body.
+ *
+ * @param data The encoded bytes.
+ * @param length The number of encoded bytes.
+ * @param output Called with every decoded chunk.
+ * @return False if the body is corrupt, otherwise true. The bytes after the end of the stream are ignored.
+ */
+bool Inflater::feed(const char* data, size_t length, const Output& output) {
+    size_t offset = inputBytes;
+    inputBytes += length;
+    if (offset < HEADER_SIZE) {
+        std::copy(data, data + std::min(length, HEADER_SIZE - offset), header + offset);
+    }
+
+    int result = inflateInput(data, length, output);
+    bool failedHeader = (result == Z_DATA_ERROR || result == Z_NEED_DICT) && stream.total_in <= HEADER_SIZE;
+    if (failedHeader && allowRawDeflate && outputBytes == 0) {
+        allowRawDeflate = false;
+        if (inflateReset2(&stream, -WINDOW_BITS) != Z_OK) {
+            return false;
+        }
+        // the header bytes of the previous chunks are gone from the caller, this chunk is still there
+        size_t retained = std::min(offset, HEADER_SIZE);
+        result = retained > 0 ? inflateInput(header, retained, output) : Z_OK;
+        if (result == Z_OK) {
+            result = inflateInput(data, length, output);
+        }
+    }
+    return result == Z_OK;
+}
+
+/**
+ * @brief Runs the input through zlib until it is consumed or the stream ends, handing on the output.
+ *
+ * @return Z_OK, or the zlib error the input caused.
+ */
+int Inflater::inflateInput(const char* data, size_t length, const Output& output) {
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(length);
+
+    while (!finished) {
+        stream.next_out = reinterpret_cast<Bytef*>(outputBuffer.get());
+        stream.avail_out = static_cast<uInt>(OUTPUT_BUFFER_SIZE);
+        int result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_STREAM_END) {
+            finished = true;
+        } else if (result != Z_OK && result != Z_BUF_ERROR) {
+            return result;
+        }
+
+        size_t produced = OUTPUT_BUFFER_SIZE - stream.avail_out;
+        if (produced > 0) {
+            outputBytes += produced;
+            output(outputBuffer.get(), produced);
+        }
+        if (stream.avail_out > 0) {
+            break; // the input is consumed, and zlib holds no more output
+        }
+    }
+    return Z_OK;
+}
+
+bool Inflater::reset(Encoding encoding) {
+    allowRawDeflate = encoding == Encoding::Deflate;
+    finished = false;
+    inputBytes = 0;
+    outputBytes = 0;
+    if (!initialized) {
+        initialized = inflateInit2(&stream, WINDOW_BITS + DETECT_HEADER) == Z_OK;
+        return initialized;
+    }
+    return inflateReset2(&stream, WINDOW_BITS + DETECT_HEADER) == Z_OK;
+}
@@ -0,0 +1,360 @@
+/**
+ * @file metrics.cpp
+ * @brief Implementation of the per-stage latency histograms and crawl counters.
+ *
+ * Every thread that fetches pages (pool workers and event loops) records into its own set of histograms
+ * and counters, found through a thread-local pointer, so recording is a few relaxed atomic increments
+ * without any lock or shared cache line. The per-thread values are merged on demand, to periodically
+ * export a Prometheus text file (for the node exporter's textfile collector) and to print a summary at
+ * the end of the crawl.
+ */
+
+#include "metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+static std::atomic<uint64_t> nextMetricsId(1);
+
+/**
+ * @brief Constructs an empty histogram.
+ */
+LatencyHistogram::LatencyHistogram() : count(0), sum(0), max(0) {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Computes the bucket of a duration.
+ *
+ * @param micros The duration in microseconds.
+ * @return The index of the bucket.
+ */
+size_t LatencyHistogram::getBucket(uint64_t micros) {
+    const uint64_t subBuckets = uint64_t(1) << SUB_BUCKET_BITS;
+    const uint64_t halfSubBuckets = subBuckets / 2;
+    micros = std::min(micros, MAX_VALUE);
+    if (micros < subBuckets) {
+        return static_cast<size_t>(micros);
+    }
+    int exponent = (63 - __builtin_clzll(micros)) - (SUB_BUCKET_BITS - 1);
+    uint64_t subBucket = micros >> exponent; // in [halfSubBuckets, subBuckets)
+    return static_cast<size_t>(subBuckets + (exponent - 1) * halfSubBuckets + (subBucket - halfSubBuckets));
+}
+
+/**
+ * @brief Gets the value a bucket stands for, the middle of its range.
+ *
+ * @param bucket The index of the bucket.
+ * @return The duration in microseconds.
+ */
+uint64_t LatencyHistogram::getBucketValue(size_t bucket) {
+    const uint64_t subBuckets = uint64_t(1) << SUB_BUCKET_BITS;
+    const uint64_t halfSubBuckets = subBuckets / 2;
+    if (bucket < subBuckets) {
+        return bucket;
+    }
+    int exponent = static_cast<int>((bucket - subBuckets) / halfSubBuckets) + 1;
+    uint64_t subBucket = (bucket - subBuckets) % halfSubBuckets + halfSubBuckets;
+    return (subBucket << exponent) + (uint64_t(1) << (exponent - 1));
+}
+
+/**
+ * @brief Records a duration. Must only be called by the thread owning the histogram.
+ *
+ * @param micros The duration in microseconds.
+ */
+void LatencyHistogram::record(uint64_t micros) {
+    buckets[getBucket(micros)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(micros, std::memory_order_relaxed);
+    if (micros > max.load(std::memory_order_relaxed)) {
+        max.store(micros, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Adds the current values of the histogram to a snapshot. Safe to call from any thread.
+ *
+ * @param snapshot The snapshot to add to.
+ */
+void LatencyHistogram::addTo(Snapshot& snapshot) const {
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        snapshot.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+    }
+    snapshot.count += count.load(std::memory_order_relaxed);
+    snapshot.sum += sum.load(std::memory_order_relaxed);
+    snapshot.max = std::max(snapshot.max, max.load(std::memory_order_relaxed));
+}
+
+void LatencyHistogram::Snapshot::merge(const Snapshot& other) {
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
+
+/**
+ * @brief Estimates a percentile of the recorded durations.
+ *
+ * @param percentile The percentile, between 0 and 100.
+ * @return The duration in microseconds, 0 if nothing was recorded.
+ */
+uint64_t LatencyHistogram::Snapshot::getPercentile(double percentile) const {
+    uint64_t total = 0;
+    for (uint64_t bucket : buckets) total += bucket; // the count may be ahead of the buckets while recording
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(getBucketValue(i), max);
+        }
+    }
+    return max;
+}
+
+
+Metrics::Metrics()
+    : instanceId(nextMetricsId++), startTime(std::chrono::steady_clock::now()), exportIntervalMs(0), exportStopRequested(false) {}
+
+Metrics::~Metrics() {
+    stopExport();
+}
+
+/**
+ * @brief Records the duration of a stage of a request on the calling thread.
+ *
+ * @param stage The stage.
+ * @param duration The duration of the stage.
+ */
+void Metrics::record(Stage stage, std::chrono::steady_clock::duration duration) {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    getWorkerMetrics().stages[static_cast<size_t>(stage)].record(static_cast<uint64_t>(std::max<int64_t>(0, micros)));
+}
+
+/**
+ * @brief Increments a counter on the calling thread.
+ *
+ * @param counter The counter.
+ * @param value The increment.
+ */
+void Metrics::add(Counter counter, uint64_t value) {
+    getWorkerMetrics().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Merges the histograms and counters of every thread.
+ *
+ * @return The merged values.
+ */
+Metrics::Snapshot Metrics::collect() {
+    Snapshot snapshot;
+    snapshot.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::lock_guard<std::mutex> lock(workersMutex);
+    for (auto& worker : workers) {
+        for (size_t i = 0; i < STAGE_COUNT; i++) {
+            worker->stages[i].addTo(snapshot.stages[i]);
+        }
+        for (size_t i = 0; i < COUNTER_COUNT; i++) {
+            snapshot.counters[i] += worker->counters[i].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+/**
+ * @brief Adds the values of another process or set of threads, e.g. of a shard of the crawl.
+ *
+ * @param other The values to add. The elapsed time is the longest of the two.
+ */
+void Metrics::Snapshot::merge(const Snapshot& other) {
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        stages[i].merge(other.stages[i]);
+    }
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        counters[i] += other.counters[i];
+    }
+    elapsedSeconds = std::max(elapsedSeconds, other.elapsedSeconds);
+}
+
+/**
+ * @brief Starts a thread writing the metrics to a Prometheus text file at a fixed interval.
+ *
+ * @param path The path of the file, replaced atomically on every export.
+ * @param intervalMs The interval between two exports in milliseconds.
+ * @return True if the first export succeeded, otherwise false.
+ */
+bool Metrics::startExport(const std::string& path, int intervalMs) {
+    exportPath = path;
+    exportIntervalMs = std::max(1, intervalMs);
+    if (!writePrometheus(exportPath)) {
+        return false;
+    }
+    exportStopRequested = false;
+    exporter = std::thread(&Metrics::runExporter, this);
+    return true;
+}
+
+/**
+ * @brief Stops the export thread, after writing the final values.
+ */
+void Metrics::stopExport() {
+    if (!exporter.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(exportMutex);
+        exportStopRequested = true;
+    }
+    exportCondVar.notify_one();
+    exporter.join();
+    writePrometheus(exportPath);
+}
+
+/**
+ * @brief Writes the metrics in the Prometheus text exposition format.
+ *
+ * Stage durations are exported as summaries (in seconds, with the 0.5, 0.9 and 0.99 quantiles).
+ *
+ * @param path The path of the file, which is written under a temporary name then renamed.
+ * @return True if the file was written, otherwise false.
+ */
+bool Metrics::writePrometheus(const std::string& path) {
+    return writePrometheus(path, collect());
+}
+
+/**
+ * @brief Writes merged metrics in the Prometheus text exposition format, see writePrometheus(path).
+ *
+ * @param path The path of the file, which is written under a temporary name then renamed.
+ * @param snapshot The values to write.
+ * @return True if the file was written, otherwise false.
+ */
+bool Metrics::writePrometheus(const std::string& path, const Snapshot& snapshot) {
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream out(temporaryPath, std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out << std::setprecision(9);
+    out << "# HELP threadr_stage_duration_seconds Duration of the stages of the requests.\n";
+    out << "# TYPE threadr_stage_duration_seconds summary\n";
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        const LatencyHistogram::Snapshot& stage = snapshot.stages[i];
+        const char* name = getStageName(static_cast<Stage>(i));
+        for (double quantile : {0.5, 0.9, 0.99}) {
+            out << "threadr_stage_duration_seconds{stage=\"" << name << "\",quantile=\"" << quantile << "\"} "
+                << stage.getPercentile(quantile * 100) / 1e6 << "\n";
+        }
+        out << "threadr_stage_duration_seconds_sum{stage=\"" << name << "\"} " << stage.sum / 1e6 << "\n";
+        out << "threadr_stage_duration_seconds_count{stage=\"" << name << "\"} " << stage.count << "\n";
+    }
+
+    const char* counterNames[COUNTER_COUNT] = {"threadr_requests_total", "threadr_pages_total", "threadr_failed_queries_total", "threadr_received_bytes_total",
+                                               "threadr_disallowed_pages_total"};
+    const char* counterHelp[COUNTER_COUNT] = {"Requests sent.", "HTML pages crawled.", "Failed queries.", "Response bytes received.",
+                                              "Pages skipped because robots.txt disallows them."};
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        out << "# HELP " << counterNames[i] << " " << counterHelp[i] << "\n";
+        out << "# TYPE " << counterNames[i] << " counter\n";
+        out << counterNames[i] << " " << snapshot.counters[i] << "\n";
+    }
+
+    double pagesPerSecond = snapshot.elapsedSeconds > 0 ? snapshot.counters[static_cast<size_t>(Counter::Pages)] / snapshot.elapsedSeconds : 0;
+    out << "# HELP threadr_pages_per_second HTML pages crawled per second since the start of the crawl.\n";
+    out << "# TYPE threadr_pages_per_second gauge\n";
+    out << "threadr_pages_per_second " << pagesPerSecond << "\n";
+    out << "# HELP threadr_uptime_seconds Time since the start of the crawl.\n";
+    out << "# TYPE threadr_uptime_seconds gauge\n";
+    out << "threadr_uptime_seconds " << snapshot.elapsedSeconds << "\n";
+
+    out.close();
+    if (out.fail() || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Prints the counters and the p50/p90/p99 of every stage.
+ *
+ * @param out The output stream.
+ */
+void Metrics::printSummary(std::ostream& out) {
+    Snapshot snapshot = collect();
+    uint64_t pages = snapshot.counters[static_cast<size_t>(Counter::Pages)];
+    double pagesPerSecond = snapshot.elapsedSeconds > 0 ? pages / snapshot.elapsedSeconds : 0;
+
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(3);
+    summary << "----------------------------------------------------------------------------\n";
+    summary << " [*] Requests: " << snapshot.counters[static_cast<size_t>(Counter::Requests)]
+            << ", Pages: " << pages << " (" << std::setprecision(1) << pagesPerSecond << "/s)"
+            << ", Failed Queries: " << snapshot.counters[static_cast<size_t>(Counter::FailedQueries)]
+            << ", Disallowed: " << snapshot.counters[static_cast<size_t>(Counter::DisallowedPages)]
+            << ", Received: " << snapshot.counters[static_cast<size_t>(Counter::ReceivedBytes)] << " bytes\n";
+    summary << std::setprecision(3);
+    summary << "    " << std::setw(10) << "Stage" << std::setw(10) << "Count"
+            << std::setw(12) << "p50 (ms)" << std::setw(12) << "p90 (ms)" << std::setw(12) << "p99 (ms)" << std::setw(12) << "max (ms)" << "\n";
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        const LatencyHistogram::Snapshot& stage = snapshot.stages[i];
+        summary << "    " << std::setw(10) << getStageName(static_cast<Stage>(i)) << std::setw(10) << stage.count
+                << std::setw(12) << stage.getPercentile(50) / 1e3 << std::setw(12) << stage.getPercentile(90) / 1e3
+                << std::setw(12) << stage.getPercentile(99) / 1e3 << std::setw(12) << stage.max / 1e3 << "\n";
+    }
+    out << summary.str() << std::flush;
+}
+
+/**
+ * @brief Gets the name of a stage, as used in the exported metrics.
+ */
+const char* Metrics::getStageName(Stage stage) {
+    switch (stage) {
+        case Stage::Dns: return "dns";
+        case Stage::Connect: return "connect";
+        case Stage::FirstByte: return "ttfb";
+        case Stage::Download: return "download";
+        case Stage::Parse: return "parse";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Gets the histograms and counters of the calling thread, creating them on first use.
+ */
+Metrics::WorkerMetrics& Metrics::getWorkerMetrics() {
+    thread_local uint64_t cachedId = 0;
+    thread_local WorkerMetrics* cachedMetrics = nullptr;
+    if (cachedId == instanceId) {
+        return *cachedMetrics;
+    }
+
+    std::lock_guard<std::mutex> lock(workersMutex);
+    workers.emplace_back(new WorkerMetrics());
+    cachedId = instanceId;
+    cachedMetrics = workers.back().get();
+    return *cachedMetrics;
+}
+
+void Metrics::runExporter() {
+    std::unique_lock<std::mutex> lock(exportMutex);
+    while (!exportCondVar.wait_for(lock, std::chrono::milliseconds(exportIntervalMs), [this] { return exportStopRequested; })) {
+        lock.unlock();
+        writePrometheus(exportPath);
+        lock.lock();
+    }
+}
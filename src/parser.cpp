@@ -7,74 +7,183 @@
  */
 
 #include "parser.h"
+#include "scan.h"
+#include "public_suffix.h"
 #include <iostream>
 #include <string>
 #include <vector>
-#include <map>
 #include <algorithm>
+#include <array>
+#include <queue>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
 
 const std::vector<std::string> URL_PREFIXES = {"https://", "http://"};
 const std::vector<std::string> URL_STARTS = {"href=\"", "href='", "src=\"", "src='", "url(", "http://", "https://"};
-const std::string URL_END_CHARS = "\"'#? ),";
+const std::string URL_END_CHARS = "\"'#? ),<>\t\r\n\f";
+
+// indices into URL_STARTS of the patterns that are part of the URL itself, and of the CSS url( pattern
+const int URL_START_HTTP = 5;
+const int URL_START_HTTPS = 6;
+const int URL_START_CSS = 4;
+
+// links longer than this are dropped instead of buffered
+const size_t MAX_LINK_LENGTH = 2048;
+
+/**
+ * @brief Collects the bytes a pattern can start with, in both cases.
+ * 
+ * @param patterns The patterns.
+ * @return The possible first bytes.
+ */
+static std::string getFirstBytes(const std::vector<std::string>& patterns) {
+    std::string firstBytes;
+    for (const auto& pattern : patterns) {
+        if (pattern.empty()) continue;
+        firstBytes.push_back(static_cast<char>(tolower(static_cast<unsigned char>(pattern[0]))));
+        firstBytes.push_back(static_cast<char>(toupper(static_cast<unsigned char>(pattern[0]))));
+    }
+    return firstBytes;
+}
+
+/**
+ * @brief Multi-pattern matcher that finds every link start pattern in a single pass.
+ * 
+ * An Aho-Corasick automaton over the URL_STARTS patterns, compiled into a dense, case-insensitive DFA:
+ * each input byte costs one table lookup, whatever the number of patterns, and matches are reported in
+ * document order without building a lowercased copy of the document. While the automaton is in its
+ * root state, the scan kernels skip ahead to the next byte that can start a pattern.
+ */
+class LinkStartMatcher {
+public:
+    explicit LinkStartMatcher(const std::vector<std::string>& patterns) : firstBytes(getFirstBytes(patterns)) {
+        transitions.push_back(State());
+        matches.push_back(-1);
+
+        // build the trie of the lowercased patterns
+        for (size_t i = 0; i < patterns.size(); i++) {
+            uint16_t state = 0;
+            for (char ch : patterns[i]) {
+                unsigned char symbol = static_cast<unsigned char>(tolower(static_cast<unsigned char>(ch)));
+                if (transitions[state][symbol] == 0) {
+                    transitions[state][symbol] = static_cast<uint16_t>(transitions.size());
+                    transitions.push_back(State());
+                    matches.push_back(-1);
+                }
+                state = transitions[state][symbol];
+            }
+            matches[state] = static_cast<int>(i);
+        }
+
+        // turn it into a DFA: missing transitions follow the failure links (breadth first)
+        std::vector<uint16_t> failure(transitions.size(), 0);
+        std::queue<uint16_t> pending;
+        for (int symbol = 0; symbol < 256; symbol++) {
+            if (transitions[0][symbol] != 0) pending.push(transitions[0][symbol]);
+        }
+        while (!pending.empty()) {
+            uint16_t state = pending.front();
+            pending.pop();
+            if (matches[state] == -1) matches[state] = matches[failure[state]];
+
+            for (int symbol = 0; symbol < 256; symbol++) {
+                uint16_t next = transitions[state][symbol];
+                if (next != 0) {
+                    failure[next] = transitions[failure[state]][symbol];
+                    pending.push(next);
+                } else {
+                    transitions[state][symbol] = transitions[failure[state]][symbol];
+                }
+            }
+        }
+
+        // case-insensitive: upper case letters behave like their lower case counterparts
+        for (auto& state : transitions) {
+            for (int symbol = 'A'; symbol <= 'Z'; symbol++) {
+                state[symbol] = state[tolower(symbol)];
+            }
+        }
+    }
+
+    /**
+     * @brief Finds the first pattern occurrence ending at or after a position.
+     * 
+     * The automaton state is carried in and out, so a pattern split across two chunks of a document is
+     * still found when the chunks are scanned one after the other.
+     * 
+     * @param data The chunk to scan.
+     * @param length The length of the chunk.
+     * @param pos The position to start scanning from.
+     * @param state The automaton state, 0 at the start of a document. Reset to 0 after a match.
+     * @param pattern Receives the index of the matched pattern.
+     * @return The position right after the match, or std::string::npos if no pattern ends in the chunk.
+     */
+    size_t findNext(const char* data, size_t length, size_t pos, uint16_t& state, int& pattern) const {
+        for (; pos < length; pos++) {
+            if (state == 0) {
+                pos += findFirstOf(data + pos, length - pos, firstBytes);
+                if (pos == length) break;
+            }
+            state = transitions[state][static_cast<unsigned char>(data[pos])];
+            if (matches[state] != -1) {
+                pattern = matches[state];
+                state = 0;
+                return pos + 1;
+            }
+        }
+        return std::string::npos;
+    }
+
+private:
+    using State = std::array<uint16_t, 256>;
+
+    ByteSet firstBytes;
+    std::vector<State> transitions;
+    std::vector<int> matches;
+};
 
 /**
  * @brief Extracts the hostname from a given URL.
  * 
  * @param url The URL from which to extract the hostname.
- * @return The extracted hostname.
+ * @return A view of the hostname within the URL, empty if the URL is not an http(s) URL.
  */
-std::string getHostnameFromUrl(const std::string& url) {
+std::string_view getHostnameFromUrl(std::string_view url) {
     for (const auto& prefix : URL_PREFIXES) {
         if (url.compare(0, prefix.size(), prefix) == 0) {
             size_t start = prefix.size();
             size_t end = url.find('/', start);
-            return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            return url.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
         }
     }
-    return "";
+    return std::string_view();
 }
 
 /**
  * @brief Extracts the host path from a given URL.
  * 
  * @param url The URL from which to extract the host path.
- * @return The extracted host path.
+ * @return A view of the host path within the URL, or "/" if the URL has no path.
  */
-std::string getHostPathFromUrl(const std::string& url) {
+std::string_view getHostPathFromUrl(std::string_view url) {
     for (const auto& prefix : URL_PREFIXES) {
         if (url.compare(0, prefix.size(), prefix) == 0) {
             size_t start = url.find('/', prefix.size());
-            return start == std::string::npos ? "/" : url.substr(start);
+            return start == std::string_view::npos ? std::string_view("/") : url.substr(start);
         }
     }
-    return "/";
-}
-
-/**
- * @brief Checks if a string ends with a given suffix.
- * 
- * @param str The string to check.
- * @param suffix The suffix to check for.
- * @return True if the string ends with the suffix, otherwise false.
- */
-bool hasSuffix(const std::string& str, const std::string& suffix) {
-    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    return std::string_view("/");
 }
 
 /**
- * @brief Verifies if a domain is allowed based on a list of predefined domains.
+ * @brief Verifies if a domain is allowed, i.e. it is below a known public suffix.
  * 
- * @param url The URL to verify.
+ * @param url The hostname to verify.
  * @return True if the domain is allowed, otherwise false.
  */
-bool verifyDomain(const std::string& url) {
-    const std::string ALLOWED_DOMAINS[] = {".com", ".sg", ".net", ".co", ".org", ".me", ".ro", ".html", ".htmx", ".gov", ".edu", ".uk", ".io", ".info", ".biz", ".us", ".ca", ".au", ".de", ".fr", ".it", ".nl", ".se", ".no", ".jp", ".br", ".es", ".mx", ".ru", ".ch", ".at", ".dk", ".be", ".nz", ".pl", ".cz", ".gr", ".pt", ".fi", ".hu", ".cn", ".tr", ".kr", ".tw", ".hk", ".vn", ".id", ".ph", ".my", ".th", ".ae", ".sa", ".il", ".eg", ".za", ".ua", ".ar", ".cl", ".pe", ".co", ".ve", ".ec", ".bo", ".py", ".uy", ".cr", ".pa", ".do", ".gt", ".sv", ".hn", ".ni", ".pr", ".jm", ".bb", ".tt", ".bs", ".gd", ".lc", ".vc", ".sr", ".gy", ".mq", ".gp", ".gf", ".aw", ".cw", ".sx", ".bq", ".an", ".pm", ".gl", ".fo", ".is", ".ie", ".lu", ".mc", ".ad", ".li", ".je", ".gg", ".im", ".gi", ".mt", ".cy", ".ax", ".fk", ".gs", ".bv", ".hm", ".tf", ".um", ".aq", ".io", ".sh", ".ac", ".cp", ".dg", ".eu", ".int", ".mil", ".museum", ".aero", ".arpa", ".cat", ".coop", ".jobs", ".pro", ".tel", ".travel", ".be", ".nz", ".pl",};
-    for (const auto& domain : ALLOWED_DOMAINS) {
-        if (hasSuffix(url, domain)) {
-            return true;
-        }
-    }
-    return false;
+bool verifyDomain(std::string_view url) {
+    return hasRegistrableDomain(url);
 }
 
 /**
@@ -83,8 +192,8 @@ bool verifyDomain(const std::string& url) {
  * @param url The URL to verify.
  * @return True if the URL is valid, otherwise false.
  */
-bool verifyUrl(const std::string& url) {
-    std::string urlDomain = getHostnameFromUrl(url);
+bool verifyUrl(std::string_view url) {
+    std::string_view urlDomain = getHostnameFromUrl(url);
     return urlDomain.empty() || verifyDomain(urlDomain);
 }
 
@@ -94,10 +203,13 @@ bool verifyUrl(const std::string& url) {
  * @param url The URL to verify.
  * @return True if the URL type is allowed, otherwise false.
  */
-bool verifyType(const std::string& url) {
-    const std::string FORBIDDEN_TYPES[] = {".css", ".pdf", ".png", "js", ".jpeg", ".jpg", ".ico"};
+bool verifyType(std::string_view url) {
+    static const std::string_view FORBIDDEN_TYPES[] = {".css", ".pdf", ".png", "js", ".jpeg", ".jpg", ".ico"};
     for (const auto& type : FORBIDDEN_TYPES) {
-        if (url.find(type) != std::string::npos) {
+        auto it = std::search(url.begin(), url.end(), type.begin(), type.end(), [](char a, char b) {
+            return tolower(static_cast<unsigned char>(a)) == b;
+        });
+        if (it != url.end()) {
             return false;
         }
     }
@@ -105,91 +217,402 @@ bool verifyType(const std::string& url) {
 }
 
 /**
- * @brief Reformat HTTP response text to lowercase and remove unwanted characters.
+ * @brief Builds the translation table used by reformatHttpResponse.
  * 
- * @param httpText The HTTP response text to reformat.
- * @return The reformatted HTTP response text.
+ * @return A table mapping each byte to its lowercased replacement, or to 0 if the byte is removed.
  */
-std::string reformatHttpResponse(const std::string& httpText) {
+static std::array<char, 256> buildReformatTable() {
     const std::string ALLOWED_CHARS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789.,/\":#?+-_= ";
-    std::map<char, char> charMap;
+    std::array<char, 256> table{};
 
     for (char ch : ALLOWED_CHARS) {
-        charMap[ch] = ch;
+        table[static_cast<unsigned char>(ch)] = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
     }
 
-    charMap['\n'] = ' ';
-    charMap['\t'] = ' ';
+    table['\n'] = ' ';
+    table['\t'] = ' ';
+    return table;
+}
+
+/**
+ * @brief Reformat HTTP response text to lowercase and remove unwanted characters.
+ * 
+ * Legacy: the crawler no longer uses it, it only serves as the baseline of the parser benchmark.
+ * 
+ * @param httpText The HTTP response text to reformat.
+ * @return The reformatted HTTP response text.
+ */
+std::string reformatHttpResponse(const std::string& httpText) {
+    static const std::array<char, 256> reformatTable = buildReformatTable();
 
-    std::string result;
+    std::string result(httpText.size(), '\0');
+    size_t length = 0;
     for (char ch : httpText) {
-        if (charMap.find(ch) != charMap.end()) {
-            result += tolower(charMap[ch]);
-        }
+        char mapped = reformatTable[static_cast<unsigned char>(ch)];
+        result[length] = mapped;
+        length += (mapped != '\0');
     }
+    result.resize(length);
     return result;
 }
 
+/**
+ * @brief Removes the "." and ".." segments of a URL path in place (RFC 3986, section 5.2.4).
+ * 
+ * @param path The path, starting with '/'.
+ * @param length The length of the path.
+ * @return The length of the path without dot segments, never more than the original length.
+ */
+static size_t removeDotSegments(char* path, size_t length) {
+    size_t out = 0; // the kept segments are compacted to the front, out never passes the segment being read
+    size_t start = 1;
+    bool trailingSlash = false;
+
+    while (start <= length) {
+        const char* slash = static_cast<const char*>(memchr(path + start, '/', length - start));
+        size_t end = slash ? slash - path : length;
+        size_t segmentLength = end - start;
+
+        if (segmentLength == 1 && path[start] == '.') {
+            trailingSlash = true;
+        } else if (segmentLength == 2 && path[start] == '.' && path[start + 1] == '.') {
+            while (out > 0 && path[--out] != '/') {}
+            trailingSlash = true;
+        } else if (end == length && segmentLength == 0) {
+            trailingSlash = true; // the path ends with '/'
+        } else {
+            path[out] = '/';
+            memmove(path + out + 1, path + start, segmentLength);
+            out += segmentLength + 1;
+            trailingSlash = false;
+        }
+        start = end + 1;
+    }
+
+    if (out == 0 || trailingSlash) {
+        path[out++] = '/';
+    }
+    return out;
+}
 
 /**
- * @brief Extracts URLs from HTTP response text.
+ * @brief Normalizes an absolute http(s) URL in place so that equivalent URLs compare equal.
  * 
- * @param httpText The HTTP response text containing URLs.
- * @param baseUrl The base URL from which the HTTP response was retrieved.
- * @return A vector of pairs representing the extracted URLs and their corresponding host paths.
+ * The scheme and hostname are lowercased, user info, the default port, a trailing dot of the hostname
+ * and the fragment are removed, dot segments are resolved and an empty path becomes "/".
+ * 
+ * @param url The URL, in a buffer with room for at least one more byte (an empty path grows to "/").
+ * @param length The length of the URL.
+ * @return The length of the normalized URL, or std::string_view::npos if the URL is not an http(s) URL with a hostname.
  */
-std::vector<std::pair<std::string, std::string>> extractUrls(const std::string& httpText, const std::string& baseUrl) {
-    std::string httpRaw = reformatHttpResponse(httpText);
-    std::vector<std::pair<std::string, std::string>> extractedUrls;
+static size_t normalizeUrlInPlace(char* url, size_t length) {
+    const size_t npos = std::string_view::npos;
+    std::string_view view(url, length);
 
-    size_t startPos = 0;
-    std::string baseHost = getHostnameFromUrl(baseUrl);
+    size_t schemeEnd = view.find("://");
+    if (schemeEnd == npos) {
+        return npos;
+    }
+    toLowerAscii(url, schemeEnd);
+    std::string_view scheme = view.substr(0, schemeEnd);
+    bool https = (scheme == "https");
+    if (!https && scheme != "http") {
+        return npos;
+    }
 
-    while (startPos < httpRaw.size()) {
-        size_t foundPos = std::string::npos; // pos of found url
-        std::string foundUrl; // the actual found url
+    size_t authorityStart = schemeEnd + 3;
+    size_t authorityEnd = std::min(view.find_first_of("/?#", authorityStart), length);
+    size_t fragmentStart = std::min(view.find('#', authorityEnd), length);
+    size_t queryStart = std::min(view.find('?', authorityEnd), fragmentStart);
 
-        for (const auto& startText : URL_STARTS) {
-            foundPos = httpRaw.find(startText, startPos);
-            if (foundPos != std::string::npos) {
-                foundPos += startText.size();
-                break;
-            }
+    std::string_view authority = view.substr(authorityStart, authorityEnd - authorityStart);
+    size_t userInfoEnd = authority.rfind('@');
+    std::string_view host = (userInfoEnd == npos) ? authority : authority.substr(userInfoEnd + 1);
+    toLowerAscii(const_cast<char*>(host.data()), host.size());
+
+    std::string_view port;
+    size_t portStart = host.rfind(':');
+    if (portStart != npos && host.find(']', portStart) == npos) {
+        port = host.substr(portStart + 1);
+        host = host.substr(0, portStart);
+        if (port.empty() || (!https && port == "80") || (https && port == "443")) {
+            port = std::string_view();
         }
+    }
+    if (!host.empty() && host.back() == '.') {
+        host.remove_suffix(1);
+    }
+    if (host.empty()) {
+        return npos;
+    }
 
-        if (foundPos != std::string::npos) {
-            size_t endPos = httpRaw.find_first_of(URL_END_CHARS, foundPos);
-            if (endPos == std::string::npos) {
-                endPos = httpRaw.size();
-            }
-            foundUrl = httpRaw.substr(foundPos, endPos - foundPos);
+    // compact hostname and port, then path and query, towards the front of the buffer
+    size_t out = authorityStart;
+    memmove(url + out, host.data(), host.size());
+    out += host.size();
+    if (!port.empty()) {
+        url[out++] = ':';
+        memmove(url + out, port.data(), port.size());
+        out += port.size();
+    }
 
-            if (!foundUrl.empty() && foundUrl[0] == '/') {
+    size_t queryLength = fragmentStart - queryStart;
+    if (queryStart == authorityEnd) {
+        memmove(url + out + 1, url + queryStart, queryLength); // may use the extra byte when nothing was removed
+        url[out++] = '/';
+    } else {
+        size_t pathLength = removeDotSegments(url + authorityEnd, queryStart - authorityEnd);
+        memmove(url + out, url + authorityEnd, pathLength);
+        out += pathLength;
+        memmove(url + out, url + queryStart, queryLength);
+    }
+    return out + queryLength;
+}
 
-                // std::cout << " >>>>>BR1 BEF>>>>> Found URL: " << foundUrl << std::endl;
+/**
+ * @brief Normalizes an absolute http(s) URL so that equivalent URLs compare equal.
+ * 
+ * @param url The absolute URL.
+ * @return The normalized URL, or an empty string if the URL is not an http(s) URL with a hostname.
+ */
+std::string normalizeUrl(std::string_view url) {
+    std::string buffer(url);
+    buffer.push_back('\0');
 
-                foundUrl = baseUrl + foundUrl;
-            } else if (!foundUrl.empty() && foundUrl.find("http") == std::string::npos) {
-                
-                // std::cout << " >>>>>BR2 BEF>>>>> Found URL: " << foundUrl << std::endl;
+    size_t length = normalizeUrlInPlace(&buffer[0], url.size());
+    if (length == std::string_view::npos) {
+        return "";
+    }
+    buffer.resize(length);
+    return buffer;
+}
 
-                foundUrl = "http:/" + baseHost + "/" + foundUrl;
-            }
+/**
+ * @brief Resolves a link found in a document and checks that it can be crawled.
+ * 
+ * The absolute URL is assembled and normalized directly in the arena, without temporary strings.
+ * Links with other schemes (mailto:, javascript:, data:, ...) are rejected.
+ * 
+ * @param link The link, absolute or relative (e.g. from a page or a Location header).
+ * @param baseHost The hostname of the document the link was found in.
+ * @param arena The arena the resolved URL is stored in.
+ * @param resolved Receives views of the hostname and path of the resolved URL, valid until the arena is reset.
+ * @return True if the link resolves to an allowed http(s) URL, otherwise false.
+ */
+bool resolveLink(std::string_view link, std::string_view baseHost, Arena& arena, LinkExtractor::Link& resolved) {
+    if (link.empty()) {
+        return false;
+    }
+
+    std::string_view parts[4];
+    size_t schemeEnd = link.find("://");
+    size_t colon = link.find(':');
+    if (schemeEnd != std::string_view::npos && schemeEnd == colon) {
+        parts[0] = link;
+    } else if (link.compare(0, 2, "//") == 0) {
+        parts[0] = "http:";
+        parts[1] = link;
+    } else if (colon != std::string_view::npos && link.find('/') > colon) {
+        return false; // mailto:, javascript:, data:, tel:, ...
+    } else {
+        parts[0] = "http://";
+        parts[1] = baseHost;
+        parts[2] = (link[0] == '/') ? "" : "/";
+        parts[3] = link;
+    }
+
+    size_t size = 1; // normalizing may need one more byte
+    for (const auto& part : parts) {
+        size += part.size();
+    }
+    char* url = arena.allocate(size);
+    size_t length = 0;
+    for (const auto& part : parts) {
+        if (part.empty()) continue;
+        memcpy(url + length, part.data(), part.size());
+        length += part.size();
+    }
+
+    length = normalizeUrlInPlace(url, length);
+    if (length == std::string_view::npos) {
+        arena.shrinkLast(url, size, 0);
+        return false;
+    }
+    arena.shrinkLast(url, size, length);
+
+    std::string_view foundUrl(url, length);
+    if (!verifyUrl(foundUrl) || !verifyType(foundUrl)) {
+        return false;
+    }
+    resolved.host = getHostnameFromUrl(foundUrl);
+    resolved.path = getHostPathFromUrl(foundUrl);
+    return !resolved.host.empty();
+}
+
+/**
+ * @brief Returns the link start matcher shared by every extractor.
+ * 
+ * @return The matcher over URL_STARTS.
+ */
+static const LinkStartMatcher& getLinkStartMatcher() {
+    static const LinkStartMatcher matcher(URL_STARTS);
+    return matcher;
+}
+
+/**
+ * @brief Constructs a LinkExtractor object for a document.
+ * 
+ * @param baseUrl The base URL (or hostname) from which the document is retrieved.
+ */
+LinkExtractor::LinkExtractor(std::string_view baseUrl) {
+    reset(baseUrl);
+}
+
+/**
+ * @brief Prepares the extractor for a new document, releasing the links of the previous one.
+ * 
+ * @param baseUrl The base URL (or hostname) from which the document is retrieved.
+ */
+void LinkExtractor::reset(std::string_view baseUrl) {
+    std::string_view host = getHostnameFromUrl(baseUrl);
+    baseHost.assign(host.empty() ? baseUrl : host);
+    arena.reset();
+    state = State::Scanning;
+    matcherState = 0;
+    pendingLink.clear();
+    linkTooLong = false;
+}
+
+/**
+ * @brief Scans the next chunk of the document.
+ * 
+ * Links are reported in document order as soon as their end is seen. A link that lies within the chunk
+ * is resolved straight from it. Only a link start pattern or a link split across chunks is carried over
+ * to the next call (up to MAX_LINK_LENGTH bytes, longer links are dropped), so the document itself
+ * never has to be kept.
+ * 
+ * @param data The chunk.
+ * @param length The length of the chunk.
+ * @param links Receives the host and path of the links completed in this chunk, valid until the next reset().
+ */
+void LinkExtractor::feed(const char* data, size_t length, std::vector<Link>& links) {
+    static const ByteSet urlEndChars(URL_END_CHARS);
+    const LinkStartMatcher& matcher = getLinkStartMatcher();
 
-            // std::cout << " >>>>>>>>>>>>>>>> Found URL: " << foundUrl << std::endl;
+    size_t pos = 0;
+    size_t linkStart = std::string_view::npos; // the start of the link in this chunk, npos if it is carried over in pendingLink
+    while (pos < length) {
+        if (state == State::Scanning) {
+            int pattern = -1;
+            pos = matcher.findNext(data, length, pos, matcherState, pattern);
+            if (pos == std::string_view::npos) {
+                return;
+            }
 
-            if (verifyUrl(foundUrl) && verifyType(foundUrl)) {
-                std::string urlHost = getHostnameFromUrl(foundUrl);
-                if (!urlHost.empty()) {
-                    extractedUrls.push_back({urlHost, getHostPathFromUrl(foundUrl)});
+            pendingLink.clear();
+            linkTooLong = false;
+            linkStart = pos;
+            if (pattern == URL_START_HTTP || pattern == URL_START_HTTPS) {
+                // the scheme is part of the link
+                if (pos >= URL_STARTS[pattern].size()) {
+                    linkStart = pos - URL_STARTS[pattern].size();
+                } else {
+                    pendingLink = URL_STARTS[pattern];
+                    linkStart = std::string_view::npos;
                 }
             }
-            startPos = endPos;
+            state = (pattern == URL_START_CSS) ? State::CssLinkStart : State::ReadingLink;
+        } else if (state == State::CssLinkStart) {
+            if (data[pos] == ' ' || data[pos] == '"' || data[pos] == '\'') {
+                pos++;
+            } else {
+                linkStart = pos;
+                state = State::ReadingLink;
+            }
         } else {
-            break;
+            size_t end = pos + findFirstOf(data + pos, length - pos, urlEndChars);
+            if (end < length && linkStart != std::string_view::npos) {
+                pos = end;
+                completeLink(std::string_view(data + linkStart, end - linkStart), links);
+                continue; // the scan resumes at the end character
+            }
+
+            size_t start = (linkStart != std::string_view::npos) ? linkStart : pos;
+            if (!linkTooLong) {
+                if (pendingLink.size() + (end - start) > MAX_LINK_LENGTH) {
+                    linkTooLong = true;
+                    pendingLink.clear();
+                } else {
+                    pendingLink.append(data + start, end - start);
+                }
+            }
+            linkStart = std::string_view::npos;
+            pos = end;
+            if (pos < length) {
+                completeLink(pendingLink, links);
+            }
         }
     }
 
-    return extractedUrls;
+    if (state == State::ReadingLink && linkStart != std::string_view::npos) {
+        pendingLink.assign(data + linkStart, length - linkStart); // an empty link started at the end of the chunk
+    }
+}
+
+/**
+ * @brief Signals the end of the document, which ends a link running up to the last byte.
+ * 
+ * @param links Receives the host and path of that link, if any.
+ */
+void LinkExtractor::finish(std::vector<Link>& links) {
+    if (state == State::ReadingLink) {
+        completeLink(pendingLink, links);
+    }
+    state = State::Scanning;
+    matcherState = 0;
+}
+
+/**
+ * @brief Resolves a link against the document, e.g. the target of a redirect.
+ * 
+ * @param link The link.
+ * @param resolved Receives the host and path of the link, valid until the next reset().
+ * @return True if the link resolves to an allowed http(s) URL, otherwise false.
+ */
+bool LinkExtractor::resolve(std::string_view link, Link& resolved) {
+    return resolveLink(link, baseHost, arena, resolved);
+}
+
+void LinkExtractor::completeLink(std::string_view link, std::vector<Link>& links) {
+    Link resolved;
+    if (!linkTooLong && link.size() <= MAX_LINK_LENGTH && resolveLink(link, baseHost, arena, resolved)) {
+        links.push_back(resolved);
+    }
+    pendingLink.clear();
+    linkTooLong = false;
+    state = State::Scanning;
 }
 
+/**
+ * @brief Extracts URLs from HTTP response text.
+ * 
+ * The raw response is scanned once by the link start matcher. Links are reported in document order,
+ * relative links are resolved against the base host and the scan resumes after the end of each link.
+ * 
+ * @param httpText The HTTP response text containing URLs.
+ * @param baseUrl The base URL (or hostname) from which the HTTP response was retrieved.
+ * @return A vector of pairs representing the extracted URLs and their corresponding host paths.
+ */
+std::vector<std::pair<std::string, std::string>> extractUrls(const std::string& httpText, const std::string& baseUrl) {
+    std::vector<LinkExtractor::Link> links;
+    LinkExtractor extractor(baseUrl);
+    extractor.feed(httpText.data(), httpText.size(), links);
+    extractor.finish(links);
+
+    std::vector<std::pair<std::string, std::string>> extractedUrls;
+    extractedUrls.reserve(links.size());
+    for (const auto& link : links) {
+        extractedUrls.emplace_back(link.host, link.path);
+    }
+    return extractedUrls;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file public_suffix.cpp
+ * @brief Lookup of public suffixes (".com", ".co.uk", ...) in the trie generated from the public suffix list.
+ *
+ * The trie is generated at build time from data/public_suffix_list.dat. Lookups walk the host labels
+ * from right to left, with one binary search among the children of the current node per label, and do
+ * not allocate.
+ */
+
+#include "public_suffix.h"
+#include "public_suffix_trie.h"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Finds the child of a trie node with a given label.
+ *
+ * @param node The parent node.
+ * @param label The label to look for.
+ * @param length The length of the label.
+ * @return The child node, or nullptr if there is none.
+ */
+static const SuffixTrieNode* findChild(const SuffixTrieNode& node, const char* label, size_t length) {
+    size_t low = node.firstChild;
+    size_t high = node.firstChild + node.childCount;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        const SuffixTrieNode& child = SUFFIX_TRIE[middle];
+        int order = memcmp(SUFFIX_LABELS + child.labelOffset, label, std::min<size_t>(child.labelLength, length));
+        if (order == 0) {
+            order = (child.labelLength < length) ? -1 : (child.labelLength > length ? 1 : 0);
+        }
+        if (order == 0) {
+            return &child;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Computes the number of labels of the public suffix of a host, following the public suffix list
+ *        algorithm (the longest matching rule wins, exception rules override wildcard rules).
+ *
+ * @param host The lowercased hostname, without port.
+ * @param length The length of the hostname.
+ * @return The number of labels of the public suffix, or 0 if no rule matches the host.
+ */
+size_t getPublicSuffixLabels(const char* host, size_t length) {
+    const SuffixTrieNode* node = &SUFFIX_TRIE[0];
+    size_t suffixLabels = 0;
+    size_t depth = 0;
+    size_t labelEnd = length;
+
+    while (labelEnd > 0) {
+        size_t labelStart = labelEnd;
+        while (labelStart > 0 && host[labelStart - 1] != '.') {
+            labelStart--;
+        }
+        depth++;
+
+        if (findChild(*node, "*", 1) != nullptr) {
+            suffixLabels = depth;
+        }
+
+        node = findChild(*node, host + labelStart, labelEnd - labelStart);
+        if (node == nullptr) {
+            break;
+        }
+        if (node->flags & SUFFIX_EXCEPTION) {
+            return depth - 1;
+        }
+        if (node->flags & SUFFIX_RULE) {
+            suffixLabels = depth;
+        }
+
+        if (labelStart == 0) {
+            break;
+        }
+        labelEnd = labelStart - 1;
+    }
+    return suffixLabels;
+}
+
+/**
+ * @brief Checks if a host is below a known public suffix, i.e. it has a registrable domain.
+ *
+ * "www.example.co.uk" and "example.com" qualify, while "co.uk", "localhost" or "index.html" do not.
+ * A port and a trailing dot are ignored.
+ *
+ * @param host The lowercased hostname.
+ * @return True if the host has a registrable domain, otherwise false.
+ */
+bool hasRegistrableDomain(std::string_view host) {
+    size_t length = std::min(host.find(':'), host.size());
+    if (length > 0 && host[length - 1] == '.') {
+        length--;
+    }
+    if (length == 0 || host[0] == '.') {
+        return false;
+    }
+
+    size_t labels = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (host[i] == '.') {
+            if (i + 1 < length && host[i + 1] == '.') {
+                return false; // empty label
+            }
+            labels++;
+        }
+    }
+
+    size_t suffixLabels = getPublicSuffixLabels(host.data(), length);
+    return suffixLabels > 0 && labels > suffixLabels;
+}
+
+/**
+ * @brief Gets the registrable domain of a host, i.e. its public suffix plus one label.
+ *
+ * "www.example.co.uk" gives "example.co.uk". A host without a registrable domain is returned as is.
+ * A port and a trailing dot are ignored.
+ *
+ * @param host The lowercased hostname.
+ * @return The registrable domain, a view into `host`.
+ */
+std::string_view getRegistrableDomain(std::string_view host) {
+    size_t length = std::min(host.find(':'), host.size());
+    if (length > 0 && host[length - 1] == '.') {
+        length--;
+    }
+    host = host.substr(0, length);
+
+    size_t suffixLabels = getPublicSuffixLabels(host.data(), length);
+    if (suffixLabels == 0) {
+        return host;
+    }
+
+    // walk back over the suffix labels and one more
+    size_t start = length;
+    for (size_t labels = 0; labels <= suffixLabels; labels++) {
+        size_t dot = start == 0 ? std::string_view::npos : host.rfind('.', start - 1);
+        if (dot == std::string_view::npos) {
+            return host;
+        }
+        start = dot;
+    }
+    return host.substr(start + 1);
+}
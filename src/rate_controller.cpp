@@ -0,0 +1,103 @@
+/**
+ * @file rate_controller.cpp
+ * @brief Implementation of the adaptive per-host crawl delay.
+ *
+ * The controller works on the request rate of the host, the inverse of the delay between two of its
+ * pages. While the response times stay close to the fastest ones seen recently, the host is keeping up,
+ * so the rate grows by RATE_INCREASE requests per second after each response. When they rise above the
+ * baseline, or the host fails, times out or answers 429/503, the rate is halved (a Retry-After header
+ * can push the delay further). The delay never leaves the configured floor and ceiling, and the floor is
+ * raised to the Crawl-delay of robots.txt when there is one.
+ */
+
+#include "rate_controller.h"
+#include <algorithm>
+
+const double RATE_INCREASE = 0.5;
+const double RATE_DECREASE = 0.5;
+const double MAX_RATE = 1000; // requests per second, once the delay is below a millisecond
+
+// a response is slow when the average of the recent ones exceeds the baseline by this factor plus the slack
+const double LATENCY_TOLERANCE = 1.5;
+const double LATENCY_SLACK_MS = 20;
+const double RECENT_WEIGHT = 0.3;
+const double BASELINE_DRIFT = 0.05;
+
+/**
+ * @brief Constructs a RateController object.
+ *
+ * @param initialDelayMs The delay between two pages until the host has been measured.
+ * @param limits The floor and ceiling of the delay.
+ */
+RateController::RateController(int initialDelayMs, const Limits& limits)
+    : limits(limits), baselineMs(0), recentMs(0), samples(0) {
+    rate = initialDelayMs > 0 ? 1000.0 / initialDelayMs : MAX_RATE;
+    clampRate();
+}
+
+/**
+ * @brief Raises the floor of the delay, e.g. to the Crawl-delay of robots.txt.
+ *
+ * @param delayMs The minimum delay between two pages in milliseconds.
+ */
+void RateController::setMinDelay(int delayMs) {
+    limits.minDelayMs = std::max(limits.minDelayMs, delayMs);
+    limits.maxDelayMs = std::max(limits.maxDelayMs, limits.minDelayMs);
+    clampRate();
+}
+
+/**
+ * @brief Adjusts the rate after a successful response.
+ *
+ * @param responseTimeMs The time to the first byte of the response in milliseconds.
+ */
+void RateController::onResponse(double responseTimeMs) {
+    if (samples++ == 0) {
+        baselineMs = responseTimeMs;
+        recentMs = responseTimeMs;
+    } else {
+        recentMs += RECENT_WEIGHT * (responseTimeMs - recentMs);
+        baselineMs = std::min(responseTimeMs, baselineMs + BASELINE_DRIFT * (recentMs - baselineMs));
+    }
+
+    if (recentMs > baselineMs * LATENCY_TOLERANCE + LATENCY_SLACK_MS) {
+        decrease();
+        return;
+    }
+    rate += RATE_INCREASE;
+    clampRate();
+}
+
+/**
+ * @brief Backs off after a failure, a timeout or a 429/503 response.
+ *
+ * @param retryAfterSeconds The Retry-After of the response in seconds, -1 if none.
+ */
+void RateController::onOverload(int retryAfterSeconds) {
+    decrease();
+    if (retryAfterSeconds > 0) {
+        rate = std::min(rate, 1.0 / retryAfterSeconds);
+        clampRate();
+    }
+}
+
+/**
+ * @brief Gets the delay before the next page of the host.
+ *
+ * @return The delay in milliseconds.
+ */
+int RateController::getDelayMs() const {
+    return static_cast<int>(1000.0 / rate);
+}
+
+void RateController::decrease() {
+    rate *= RATE_DECREASE;
+    clampRate();
+    recentMs = baselineMs; // the next responses tell whether the host recovered at the lower rate
+}
+
+void RateController::clampRate() {
+    double maxRate = limits.minDelayMs > 0 ? 1000.0 / limits.minDelayMs : MAX_RATE;
+    double minRate = limits.maxDelayMs > 0 ? 1000.0 / limits.maxDelayMs : MAX_RATE;
+    rate = std::max(minRate, std::min(rate, maxRate));
+}
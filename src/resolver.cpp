@@ -0,0 +1,284 @@
+/**
+ * @file resolver.cpp
+ * @brief Implementation of the shared, thread-safe DNS resolver with a TTL cache.
+ * 
+ * Lookups run on a small pool of resolver threads using getaddrinfo (IPv4 and IPv6), so neither the
+ * crawler workers nor the event loops block on DNS. Results are cached per hostname: successful lookups
+ * for the cache TTL, failed ones (e.g. NXDOMAIN) for the shorter negative TTL. Most hosts are resolved
+ * only once (their later pages reuse pooled connections), so expired entries are rarely looked up again:
+ * the cache is bounded, evicting the least recently used hostname. Concurrent lookups of the same
+ * hostname are coalesced into a single query.
+ */
+
+#include "resolver.h"
+#include <netdb.h>
+#include <netinet/in.h>
+#include <cstring>
+#include <future>
+
+/**
+ * @brief Constructs a Resolver object and starts its resolver threads.
+ * 
+ * @param threadCount The number of threads running lookups concurrently.
+ * @param cacheTtlSeconds How long successful lookups are cached, in seconds.
+ * @param negativeTtlSeconds How long failed lookups are cached, in seconds.
+ * @param cacheCapacity The maximum number of cached hostnames, 0 to disable the cache.
+ */
+Resolver::Resolver(int threadCount, int cacheTtlSeconds, int negativeTtlSeconds, size_t cacheCapacity)
+    : cacheTtl(cacheTtlSeconds), negativeTtl(negativeTtlSeconds), cacheCapacity(cacheCapacity), hasOverride(false),
+      isShuttingDown(false) {
+    for (int i = 0; i < std::max(1, threadCount); i++) {
+        threads.emplace_back(&Resolver::runWorker, this);
+    }
+}
+
+Resolver::~Resolver() {
+    {
+        std::lock_guard<std::mutex> lock(resolverMutex);
+        isShuttingDown = true;
+    }
+    jobsCondVar.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Looks a hostname up in the cache only.
+ * 
+ * @param hostname The hostname to look up.
+ * @param resolution Receives the cached resolution, which may be a cached failure.
+ * @return True if a live cache entry was found, otherwise false.
+ */
+bool Resolver::lookupCached(const std::string& hostname, Resolution& resolution) {
+    if (hasOverride) {
+        resolution = overrideResolution;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(resolverMutex);
+    auto it = cacheIndex.find(hostname);
+    if (it == cacheIndex.end()) {
+        return false;
+    }
+    if (it->second->expiresAt <= Clock::now()) {
+        cache.erase(it->second);
+        cacheIndex.erase(it);
+        return false;
+    }
+    cache.splice(cache.begin(), cache, it->second);
+    resolution = it->second->resolution;
+    return true;
+}
+
+/**
+ * @brief Resolves a hostname without blocking the caller.
+ * 
+ * The callback is invoked inline if the hostname is cached, otherwise on a resolver thread once the
+ * lookup completes. Callers on an event loop should post the result back to their loop.
+ * 
+ * @param hostname The hostname to resolve.
+ * @param callback Callback receiving the resolution.
+ */
+void Resolver::resolveAsync(const std::string& hostname, Callback callback) {
+    Resolution cached;
+    if (lookupCached(hostname, cached)) {
+        callback(cached);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(resolverMutex);
+        auto& waiting = inFlight[hostname];
+        waiting.push_back(std::move(callback));
+        if (waiting.size() > 1) {
+            return; // a lookup for this hostname is already queued
+        }
+        jobs.push_back(hostname);
+    }
+    jobsCondVar.notify_one();
+}
+
+/**
+ * @brief Resolves a hostname, blocking the caller until the (possibly cached) result is available.
+ * 
+ * @param hostname The hostname to resolve.
+ * @return The resolution of the hostname.
+ */
+Resolver::Resolution Resolver::resolve(const std::string& hostname) {
+    std::promise<Resolution> result;
+    std::future<Resolution> future = result.get_future();
+    resolveAsync(hostname, [&result](const Resolution& resolution) { result.set_value(resolution); });
+    return future.get();
+}
+
+/**
+ * @brief Resolves every hostname to the same address instead of looking it up, e.g. to crawl a local test
+ *        server serving many virtual hosts. Must be called before the first lookup.
+ * 
+ * @param address The address every hostname resolves to.
+ */
+void Resolver::setOverride(const Address& address) {
+    overrideResolution.addresses.assign(1, address);
+    hasOverride = true;
+}
+
+/**
+ * @brief Resolves a hostname with getaddrinfo on the calling thread, bypassing the cache.
+ * 
+ * @param hostname The hostname to resolve.
+ * @return The resolution of the hostname, with IPv4 and IPv6 addresses in the order returned by the system.
+ */
+Resolver::Resolution Resolver::resolveUncached(const std::string& hostname) {
+    Resolution resolution;
+    struct addrinfo hints;
+    struct addrinfo* results = nullptr;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    resolution.status = getaddrinfo(hostname.c_str(), nullptr, &hints, &results);
+    if (resolution.status != 0) {
+        resolution.error = gai_strerror(resolution.status);
+        return resolution;
+    }
+
+    for (struct addrinfo* info = results; info != nullptr; info = info->ai_next) {
+        if (info->ai_family != AF_INET && info->ai_family != AF_INET6) {
+            continue;
+        }
+        Address address;
+        memset(&address.storage, 0, sizeof(address.storage));
+        memcpy(&address.storage, info->ai_addr, info->ai_addrlen);
+        address.length = info->ai_addrlen;
+        resolution.addresses.push_back(address);
+    }
+    freeaddrinfo(results);
+
+    if (resolution.addresses.empty()) {
+        resolution.status = EAI_NONAME;
+        resolution.error = gai_strerror(EAI_NONAME);
+    }
+    return resolution;
+}
+
+/**
+ * @brief Parses a numeric address and port, such as "127.0.0.1:8080" or "[::1]:8080".
+ * 
+ * @param text The address and port.
+ * @param address Receives the address, with the port set.
+ * @param port Receives the port.
+ * @return True if the address is valid, otherwise false.
+ */
+bool Resolver::parseAddress(const std::string& text, Address& address, int& port) {
+    size_t separator = text.rfind(':');
+    if (separator == std::string::npos || separator == 0 || separator + 1 == text.size()) {
+        return false;
+    }
+    std::string host = text.substr(0, separator);
+    std::string service = text.substr(separator + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    struct addrinfo hints;
+    struct addrinfo* results = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &results) != 0) {
+        return false;
+    }
+
+    memset(&address.storage, 0, sizeof(address.storage));
+    memcpy(&address.storage, results->ai_addr, results->ai_addrlen);
+    address.length = results->ai_addrlen;
+    freeaddrinfo(results);
+
+    port = std::stoi(service);
+    return true;
+}
+
+/**
+ * @brief Sets the port of a resolved address.
+ * 
+ * @param address The address to update.
+ * @param port The port number, in host byte order.
+ */
+void Resolver::setPort(Address& address, int port) {
+    if (address.storage.ss_family == AF_INET6) {
+        reinterpret_cast<struct sockaddr_in6*>(&address.storage)->sin6_port = htons(port);
+    } else {
+        reinterpret_cast<struct sockaddr_in*>(&address.storage)->sin_port = htons(port);
+    }
+}
+
+/**
+ * @brief Main loop of a resolver thread: runs queued lookups, caches them and notifies the waiters.
+ */
+void Resolver::runWorker() {
+    while (true) {
+        std::string hostname;
+        {
+            std::unique_lock<std::mutex> lock(resolverMutex);
+            jobsCondVar.wait(lock, [this] { return isShuttingDown || !jobs.empty(); });
+            if (isShuttingDown) {
+                return;
+            }
+            hostname = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        Resolution resolution = resolveUncached(hostname);
+
+        std::vector<Callback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(resolverMutex);
+            // transient failures (EAI_AGAIN, system errors) are not cached
+            if (resolution.status == 0 || resolution.status == EAI_NONAME || resolution.status == EAI_NODATA) {
+                auto ttl = resolution.status == 0 ? cacheTtl : negativeTtl;
+                insertCached(hostname, resolution, Clock::now() + ttl);
+            }
+            auto it = inFlight.find(hostname);
+            if (it != inFlight.end()) {
+                callbacks.swap(it->second);
+                inFlight.erase(it);
+            }
+        }
+
+        for (auto& callback : callbacks) {
+            callback(resolution);
+        }
+    }
+}
+
+/**
+ * @brief Caches a resolution, evicting the least recently used hostname when the cache is full.
+ *        Must be called with the resolver mutex held.
+ *
+ * @param hostname The hostname.
+ * @param resolution The resolution of the hostname.
+ * @param expiresAt The time the entry expires.
+ */
+void Resolver::insertCached(const std::string& hostname, const Resolution& resolution, Clock::time_point expiresAt) {
+    if (cacheCapacity == 0) {
+        return;
+    }
+    auto it = cacheIndex.find(hostname);
+    if (it != cacheIndex.end()) {
+        it->second->resolution = resolution;
+        it->second->expiresAt = expiresAt;
+        cache.splice(cache.begin(), cache, it->second);
+        return;
+    }
+
+    cache.push_front(CacheEntry{hostname, resolution, expiresAt});
+    cacheIndex[hostname] = cache.begin();
+    if (cache.size() > cacheCapacity) {
+        cacheIndex.erase(cache.back().hostname);
+        cache.pop_back();
+    }
+}
@@ -0,0 +1,538 @@
+/**
+ * @file result_format.cpp
+ * @brief Implementation of the writer and reader of the binary results file.
+ *
+ * The results are written in blocks of up to `sitesPerBlock` sites. Inside a block, every statistic is
+ * stored as its own column, and hostnames and paths are replaced by ids into a string dictionary that
+ * grows with the file: each block carries the strings it uses for the first time. Blocks are only ever
+ * appended, and an index of the blocks is written as a footer when the file is closed. A reader maps the
+ * file and uses the index, or scans the blocks one by one when the crawl was interrupted before the
+ * footer was written.
+ */
+
+#include "result_format.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(ResultBlockHeader) == 32, "unexpected block header layout");
+static_assert(sizeof(ResultBlockIndexEntry) == 16, "unexpected block index layout");
+static_assert(sizeof(ResultFileTrailer) == 24, "unexpected trailer layout");
+
+const size_t RESULT_FILE_HEADER_SIZE = 16;
+const size_t RESULT_FILE_BUFFER_SIZE = 1 << 20;
+
+// past this many distinct strings, new strings are still numbered but no longer deduplicated, which
+// bounds the memory used by the writer on very large crawls
+const size_t MAX_DICTIONARY_ENTRIES = 1 << 20;
+
+/**
+ * @brief Reads a value from a possibly unaligned position of a mapped file.
+ */
+template <typename T>
+static T loadAt(const char* data, size_t index = 0) {
+    T value;
+    std::memcpy(&value, data + index * sizeof(T), sizeof(T));
+    return value;
+}
+
+static size_t alignTo4(size_t size) {
+    return (size + 3) & ~static_cast<size_t>(3);
+}
+
+static float toResponseTime(double responseTime) {
+    return responseTime < 0 ? std::numeric_limits<float>::quiet_NaN() : static_cast<float>(responseTime);
+}
+
+/**
+ * @brief Constructs a writer, which does nothing until open() is called.
+ *
+ * @param sitesPerBlock The number of sites after which a block is written.
+ */
+ResultFileWriter::ResultFileWriter(size_t sitesPerBlock)
+    : sitesPerBlock(std::max<size_t>(1, sitesPerBlock)), fileOffset(0), stringCount(0), blockFirstStringId(0) {}
+
+ResultFileWriter::~ResultFileWriter() {
+    close();
+}
+
+/**
+ * @brief Creates (or truncates) a results file and writes its header.
+ *
+ * When appending to an existing results file, its footer is dropped and new blocks are written after its
+ * last complete block. Strings written before are not reused by the new blocks.
+ *
+ * @param path The path of the file.
+ * @param append Whether the sites of an existing file are kept.
+ * @return True if the file was created, otherwise false.
+ */
+bool ResultFileWriter::open(const std::string& path, bool append) {
+    fileOffset = 0;
+    blockIndex.clear();
+    stringIds.clear();
+    stringCount = 0;
+
+    struct stat fileStat;
+    if (append && stat(path.c_str(), &fileStat) == 0 && fileStat.st_size > 0) {
+        ResultFileReader reader;
+        if (!reader.open(path)) {
+            return false;
+        }
+        blockIndex = reader.getBlockIndex();
+        stringCount = static_cast<uint32_t>(reader.stringCount());
+        fileOffset = reader.getDataEnd();
+        reader.close();
+        if (truncate(path.c_str(), static_cast<off_t>(fileOffset)) != 0) {
+            return false;
+        }
+    }
+    clearBlock();
+
+    fileBuffer.reset(new char[RESULT_FILE_BUFFER_SIZE]);
+    file.rdbuf()->pubsetbuf(fileBuffer.get(), RESULT_FILE_BUFFER_SIZE);
+    if (fileOffset > 0) {
+        file.open(path, std::ios::binary | std::ios::app);
+        return file.is_open();
+    }
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    uint32_t header[2] = {RESULT_FORMAT_VERSION, 0};
+    write(RESULT_FILE_MAGIC, sizeof(RESULT_FILE_MAGIC));
+    write(header, sizeof(header));
+    return file.good();
+}
+
+bool ResultFileWriter::isOpen() const {
+    return file.is_open();
+}
+
+/**
+ * @brief Adds a crawled site to the current block, and writes the block once it is full.
+ *
+ * @param stats The statistics of the site.
+ * @param depth The depth of the site.
+ */
+void ResultFileWriter::append(const Socket::SiteStats& stats, int depth) {
+    hostIds.push_back(getStringId(stats.hostname));
+    depths.push_back(depth);
+    failedQueries.push_back(static_cast<uint32_t>(std::max(0, stats.failedQueries)));
+    minResponseTimes.push_back(toResponseTime(stats.minResponseTime));
+    maxResponseTimes.push_back(toResponseTime(stats.maxResponseTime));
+    averageResponseTimes.push_back(toResponseTime(stats.averageResponseTime));
+
+    for (const auto& page : stats.discoveredPages) {
+        // pages are stored relative to the hostname, so that common paths share a dictionary entry
+        std::string_view path = page.first;
+        if (path.compare(0, stats.hostname.size(), stats.hostname) == 0) {
+            path.remove_prefix(stats.hostname.size());
+        }
+        pathIds.push_back(getStringId(path));
+        pageResponseTimes.push_back(toResponseTime(page.second));
+    }
+    pageEnds.push_back(static_cast<uint32_t>(pathIds.size()));
+
+    for (const auto& site : stats.linkedSites) {
+        linkedHostIds.push_back(getStringId(site));
+    }
+    linkEnds.push_back(static_cast<uint32_t>(linkedHostIds.size()));
+
+    if (hostIds.size() >= sitesPerBlock) {
+        flush();
+    }
+}
+
+/**
+ * @brief Writes the sites added since the last block as a new block, and flushes the file.
+ *
+ * @return True if the file is in a good state, otherwise false.
+ */
+bool ResultFileWriter::flush() {
+    if (!file.is_open()) {
+        return false;
+    }
+    if (hostIds.empty()) {
+        return file.good();
+    }
+
+    ResultBlockHeader header;
+    header.magic = RESULT_BLOCK_MAGIC;
+    header.siteCount = static_cast<uint32_t>(hostIds.size());
+    header.pageCount = static_cast<uint32_t>(pathIds.size());
+    header.linkCount = static_cast<uint32_t>(linkedHostIds.size());
+    header.stringCount = static_cast<uint32_t>(newStringLengths.size());
+    header.stringBytes = static_cast<uint32_t>(newStringBytes.size());
+    header.firstStringId = blockFirstStringId;
+    header.blockSize = static_cast<uint32_t>(sizeof(ResultBlockHeader) + header.stringCount * 4 + alignTo4(header.stringBytes)
+        + header.siteCount * 4 * 8 + header.pageCount * 4 * 2 + header.linkCount * 4);
+
+    ResultBlockIndexEntry entry;
+    entry.offset = fileOffset;
+    entry.siteCount = header.siteCount;
+    entry.pageCount = header.pageCount;
+    blockIndex.push_back(entry);
+
+    const char padding[4] = {0, 0, 0, 0};
+    write(&header, sizeof(header));
+    write(newStringLengths.data(), newStringLengths.size() * 4);
+    write(newStringBytes.data(), newStringBytes.size());
+    write(padding, alignTo4(newStringBytes.size()) - newStringBytes.size());
+    write(hostIds.data(), hostIds.size() * 4);
+    write(depths.data(), depths.size() * 4);
+    write(failedQueries.data(), failedQueries.size() * 4);
+    write(minResponseTimes.data(), minResponseTimes.size() * 4);
+    write(maxResponseTimes.data(), maxResponseTimes.size() * 4);
+    write(averageResponseTimes.data(), averageResponseTimes.size() * 4);
+    write(pageEnds.data(), pageEnds.size() * 4);
+    write(linkEnds.data(), linkEnds.size() * 4);
+    write(pathIds.data(), pathIds.size() * 4);
+    write(pageResponseTimes.data(), pageResponseTimes.size() * 4);
+    write(linkedHostIds.data(), linkedHostIds.size() * 4);
+
+    clearBlock();
+    file.flush();
+    return file.good();
+}
+
+/**
+ * @brief Writes the last block and the block index, then closes the file.
+ *
+ * @return True if everything was written, otherwise false.
+ */
+bool ResultFileWriter::close() {
+    if (!file.is_open()) {
+        return true;
+    }
+    flush();
+
+    ResultFileTrailer trailer;
+    trailer.indexOffset = fileOffset;
+    trailer.blockCount = static_cast<uint32_t>(blockIndex.size());
+    trailer.stringCount = stringCount;
+    std::memcpy(trailer.magic, RESULT_INDEX_MAGIC, sizeof(trailer.magic));
+
+    write(blockIndex.data(), blockIndex.size() * sizeof(ResultBlockIndexEntry));
+    write(&trailer, sizeof(trailer));
+    file.close();
+    return !file.fail();
+}
+
+/**
+ * @brief Returns the dictionary id of a string, adding it to the current block if it is new.
+ *
+ * @param text The string.
+ * @return The id of the string.
+ */
+uint32_t ResultFileWriter::getStringId(std::string_view text) {
+    std::string key(text);
+    auto it = stringIds.find(key);
+    if (it != stringIds.end()) {
+        return it->second;
+    }
+
+    uint32_t id = stringCount++;
+    newStringLengths.push_back(static_cast<uint32_t>(text.size()));
+    newStringBytes.append(text.data(), text.size());
+    if (stringIds.size() < MAX_DICTIONARY_ENTRIES) {
+        stringIds.emplace(std::move(key), id);
+    }
+    return id;
+}
+
+void ResultFileWriter::clearBlock() {
+    blockFirstStringId = stringCount;
+    newStringLengths.clear();
+    newStringBytes.clear();
+    hostIds.clear();
+    depths.clear();
+    failedQueries.clear();
+    minResponseTimes.clear();
+    maxResponseTimes.clear();
+    averageResponseTimes.clear();
+    pageEnds.clear();
+    linkEnds.clear();
+    pathIds.clear();
+    pageResponseTimes.clear();
+    linkedHostIds.clear();
+}
+
+void ResultFileWriter::write(const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    file.write(static_cast<const char*>(data), size);
+    fileOffset += size;
+}
+
+
+ResultFileReader::ResultFileReader() : data(nullptr), size(0), indexed(false), sites(0) {}
+
+ResultFileReader::~ResultFileReader() {
+    close();
+}
+
+/**
+ * @brief Maps a results file and reads its block index.
+ *
+ * A file without a valid index (the crawl was interrupted) is read up to its last complete block.
+ *
+ * @param path The path of the file.
+ * @return True if the file is a results file, otherwise false.
+ */
+bool ResultFileReader::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << " [!] Error: Unable to open " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(RESULT_FILE_HEADER_SIZE)) {
+        std::cerr << " [!] Error: " << path << " is not a results file" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    size = static_cast<size_t>(fileStat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << " [!] Error: Unable to map " << path << ": " << std::strerror(errno) << std::endl;
+        size = 0;
+        return false;
+    }
+    data = static_cast<const char*>(mapping);
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    if (std::memcmp(data, RESULT_FILE_MAGIC, sizeof(RESULT_FILE_MAGIC)) != 0
+        || loadAt<uint32_t>(data + sizeof(RESULT_FILE_MAGIC)) != RESULT_FORMAT_VERSION) {
+        std::cerr << " [!] Error: " << path << " is not a results file, or was written by another version" << std::endl;
+        close();
+        return false;
+    }
+
+    indexed = readIndex();
+    if (!indexed) {
+        scanBlocks();
+    }
+    return true;
+}
+
+void ResultFileReader::close() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+    indexed = false;
+    sites = 0;
+    blocks.clear();
+    strings.clear();
+}
+
+/**
+ * @brief Checks whether the file was closed properly, i.e. its footer index is present.
+ */
+bool ResultFileReader::hasIndex() const {
+    return indexed;
+}
+
+size_t ResultFileReader::siteCount() const {
+    return sites;
+}
+
+/**
+ * @brief Returns the offset right after the last complete block, where new blocks can be appended.
+ */
+uint64_t ResultFileReader::getDataEnd() const {
+    return blocks.empty() ? RESULT_FILE_HEADER_SIZE : blocks.back().offset + blocks.back().header.blockSize;
+}
+
+/**
+ * @brief Returns the index entries of the complete blocks of the file.
+ */
+std::vector<ResultBlockIndexEntry> ResultFileReader::getBlockIndex() const {
+    std::vector<ResultBlockIndexEntry> index;
+    for (const Block& block : blocks) {
+        ResultBlockIndexEntry entry;
+        entry.offset = block.offset;
+        entry.siteCount = block.header.siteCount;
+        entry.pageCount = block.header.pageCount;
+        index.push_back(entry);
+    }
+    return index;
+}
+
+/**
+ * @brief Decodes every site of the file, in the order they were written.
+ *
+ * The string views of a record point into the mapped file and stay valid until the reader is closed.
+ *
+ * @param visit Called with every site.
+ */
+void ResultFileReader::forEachSite(const std::function<void(const ResultRecord&)>& visit) const {
+    ResultRecord record;
+    for (const Block& block : blocks) {
+        const ResultBlockHeader& header = block.header;
+        size_t siteCount = header.siteCount;
+        const char* hostIds = block.columns;
+        const char* depths = hostIds + siteCount * 4;
+        const char* failedQueries = depths + siteCount * 4;
+        const char* minResponseTimes = failedQueries + siteCount * 4;
+        const char* maxResponseTimes = minResponseTimes + siteCount * 4;
+        const char* averageResponseTimes = maxResponseTimes + siteCount * 4;
+        const char* pageEnds = averageResponseTimes + siteCount * 4;
+        const char* linkEnds = pageEnds + siteCount * 4;
+        const char* pathIds = linkEnds + siteCount * 4;
+        const char* pageResponseTimes = pathIds + header.pageCount * 4;
+        const char* linkedHostIds = pageResponseTimes + header.pageCount * 4;
+
+        uint32_t pageStart = 0;
+        uint32_t linkStart = 0;
+        for (size_t i = 0; i < siteCount; i++) {
+            record.hostname = strings[loadAt<uint32_t>(hostIds, i)];
+            record.depth = loadAt<int32_t>(depths, i);
+            record.failedQueries = loadAt<uint32_t>(failedQueries, i);
+            record.minResponseTime = loadAt<float>(minResponseTimes, i);
+            record.maxResponseTime = loadAt<float>(maxResponseTimes, i);
+            record.averageResponseTime = loadAt<float>(averageResponseTimes, i);
+
+            uint32_t pageEnd = loadAt<uint32_t>(pageEnds, i);
+            record.pages.clear();
+            for (uint32_t page = pageStart; page < pageEnd; page++) {
+                record.pages.emplace_back(strings[loadAt<uint32_t>(pathIds, page)], loadAt<float>(pageResponseTimes, page));
+            }
+            pageStart = pageEnd;
+
+            uint32_t linkEnd = loadAt<uint32_t>(linkEnds, i);
+            record.linkedSites.clear();
+            for (uint32_t link = linkStart; link < linkEnd; link++) {
+                record.linkedSites.push_back(strings[loadAt<uint32_t>(linkedHostIds, link)]);
+            }
+            linkStart = linkEnd;
+
+            visit(record);
+        }
+    }
+}
+
+/**
+ * @brief Validates a block and adds its strings to the dictionary.
+ *
+ * @param offset The offset of the block in the file.
+ * @param end The offset the block must end before.
+ * @return True if the block is valid, otherwise false.
+ */
+bool ResultFileReader::readBlock(uint64_t offset, uint64_t end) {
+    if (offset < RESULT_FILE_HEADER_SIZE || end > size || offset + sizeof(ResultBlockHeader) > end) {
+        return false;
+    }
+    ResultBlockHeader header = loadAt<ResultBlockHeader>(data + offset);
+    uint64_t expectedSize = sizeof(ResultBlockHeader) + uint64_t(header.stringCount) * 4 + alignTo4(header.stringBytes)
+        + uint64_t(header.siteCount) * 4 * 8 + uint64_t(header.pageCount) * 4 * 2 + uint64_t(header.linkCount) * 4;
+    if (header.magic != RESULT_BLOCK_MAGIC || header.blockSize != expectedSize || offset + expectedSize > end
+        || header.firstStringId != strings.size()) {
+        return false;
+    }
+
+    const char* lengths = data + offset + sizeof(ResultBlockHeader);
+    const char* text = lengths + header.stringCount * 4;
+    size_t textOffset = 0;
+    size_t firstString = strings.size();
+    for (uint32_t i = 0; i < header.stringCount; i++) {
+        uint32_t length = loadAt<uint32_t>(lengths, i);
+        if (length > header.stringBytes - textOffset) {
+            strings.resize(firstString);
+            return false;
+        }
+        strings.emplace_back(text + textOffset, length);
+        textOffset += length;
+    }
+
+    // check every id and range up front, so that forEachSite() can trust the block
+    Block block;
+    block.offset = offset;
+    block.header = header;
+    block.columns = text + alignTo4(header.stringBytes);
+    const char* hostIds = block.columns;
+    const char* pageEnds = hostIds + header.siteCount * 4 * 6;
+    const char* linkEnds = pageEnds + header.siteCount * 4;
+    const char* pathIds = linkEnds + header.siteCount * 4;
+    const char* linkedHostIds = pathIds + header.pageCount * 4 * 2;
+    bool valid = textOffset == header.stringBytes;
+    uint32_t previousPageEnd = 0;
+    uint32_t previousLinkEnd = 0;
+    for (uint32_t i = 0; valid && i < header.siteCount; i++) {
+        uint32_t pageEnd = loadAt<uint32_t>(pageEnds, i);
+        uint32_t linkEnd = loadAt<uint32_t>(linkEnds, i);
+        valid = loadAt<uint32_t>(hostIds, i) < strings.size() && pageEnd >= previousPageEnd && pageEnd <= header.pageCount
+            && linkEnd >= previousLinkEnd && linkEnd <= header.linkCount;
+        previousPageEnd = pageEnd;
+        previousLinkEnd = linkEnd;
+    }
+    for (uint32_t i = 0; valid && i < header.pageCount; i++) {
+        valid = loadAt<uint32_t>(pathIds, i) < strings.size();
+    }
+    for (uint32_t i = 0; valid && i < header.linkCount; i++) {
+        valid = loadAt<uint32_t>(linkedHostIds, i) < strings.size();
+    }
+    if (!valid) {
+        strings.resize(firstString);
+        return false;
+    }
+
+    blocks.push_back(block);
+    sites += header.siteCount;
+    return true;
+}
+
+/**
+ * @brief Reads the blocks listed in the footer index.
+ *
+ * @return True if the index is present and every block it lists is valid, otherwise false.
+ */
+bool ResultFileReader::readIndex() {
+    if (size < RESULT_FILE_HEADER_SIZE + sizeof(ResultFileTrailer)) {
+        return false;
+    }
+    ResultFileTrailer trailer = loadAt<ResultFileTrailer>(data + size - sizeof(ResultFileTrailer));
+    if (std::memcmp(trailer.magic, RESULT_INDEX_MAGIC, sizeof(trailer.magic)) != 0
+        || trailer.indexOffset + uint64_t(trailer.blockCount) * sizeof(ResultBlockIndexEntry) + sizeof(ResultFileTrailer) != size) {
+        return false;
+    }
+
+    const char* entries = data + trailer.indexOffset;
+    for (uint32_t i = 0; i < trailer.blockCount; i++) {
+        ResultBlockIndexEntry entry = loadAt<ResultBlockIndexEntry>(entries, i);
+        if (!readBlock(entry.offset, trailer.indexOffset) || blocks.back().header.siteCount != entry.siteCount) {
+            blocks.clear();
+            strings.clear();
+            sites = 0;
+            return false;
+        }
+    }
+    return strings.size() == trailer.stringCount;
+}
+
+/**
+ * @brief Reads the blocks one after the other, up to the first incomplete one.
+ */
+void ResultFileReader::scanBlocks() {
+    blocks.clear();
+    strings.clear();
+    sites = 0;
+
+    uint64_t offset = RESULT_FILE_HEADER_SIZE;
+    while (readBlock(offset, size)) {
+        offset += blocks.back().header.blockSize;
+    }
+}
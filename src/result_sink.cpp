@@ -0,0 +1,235 @@
+/**
+ * @file result_sink.cpp
+ * @brief Implementation of the asynchronous sink that writes the crawl results.
+ *
+ * Workers hand the statistics of each crawled site to the sink through a lock-free queue and go back to
+ * crawling right away. A dedicated writer thread formats the results and writes them in batches: to the
+ * console, and to the CSV file, which is opened once with a large buffer and flushed periodically.
+ * The results can also be written to a binary results file (see result_format.h). Stopping the sink
+ * drains every queued result before the files are closed.
+ */
+
+#include "result_sink.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+const size_t CSV_BUFFER_SIZE = 1 << 20;
+const int WRITER_IDLE_WAIT_MS = 100;
+
+/**
+ * @brief Constructs a ResultSink object with the specified params.
+ *
+ * @param consoleOutput Whether the results are written to the console.
+ * @param flushIntervalMs The maximum time in milliseconds results stay in the CSV file buffer.
+ */
+ResultSink::ResultSink(bool consoleOutput, int flushIntervalMs)
+    : consoleOutput(consoleOutput), flushIntervalMs(flushIntervalMs), writerWaiting(false), stopRequested(false) {}
+
+ResultSink::~ResultSink() {
+    stop();
+}
+
+/**
+ * @brief Creates (or truncates) the CSV results file and writes its header. Must be called before start().
+ *
+ * @param path The path of the CSV file.
+ * @param append Whether the rows of an existing file are kept.
+ * @return True if the file was opened, otherwise false.
+ */
+bool ResultSink::openCsv(const std::string& path, bool append) {
+    csvBuffer.reset(new char[CSV_BUFFER_SIZE]);
+    csvFile.rdbuf()->pubsetbuf(csvBuffer.get(), CSV_BUFFER_SIZE);
+    csvFile.open(path, append ? std::ios::app : std::ios::trunc);
+    if (!csvFile.is_open()) {
+        return false;
+    }
+    if (csvFile.tellp() > 0) {
+        return true;
+    }
+    csvFile << "WEBSITE,DEPTH,PAGES DISCOVERED,FAILED QUERIES,LINKED SITES,MIN RESPONSE TIME (ms),MAX RESPONSE TIME (ms),AVG RESPONSE TIME (ms),DISCOVERED PAGES\n";
+    return true;
+}
+
+/**
+ * @brief Creates (or truncates) the binary results file. Must be called before start().
+ *
+ * @param path The path of the binary file.
+ * @param append Whether the sites of an existing file are kept.
+ * @return True if the file was opened, otherwise false.
+ */
+bool ResultSink::openBinary(const std::string& path, bool append) {
+    return binaryFile.open(path, append);
+}
+
+/**
+ * @brief Sets a callback invoked on the writer thread with the hostname of every site whose results were
+ * written and flushed to the results files. Must be called before start().
+ *
+ * @param listener The callback.
+ */
+void ResultSink::setWrittenListener(std::function<void(const std::string&)> listener) {
+    writtenListener = std::move(listener);
+}
+
+/**
+ * @brief Starts the writer thread.
+ */
+void ResultSink::start() {
+    stopRequested = false;
+    writer = std::thread(&ResultSink::runWriter, this);
+}
+
+/**
+ * @brief Queues the results of a crawled site. Never blocks on I/O, safe to call from any thread.
+ *
+ * @param stats The statistics of the crawled site.
+ * @param depth The depth of the site.
+ */
+void ResultSink::submit(Socket::SiteStats stats, int depth) {
+    SiteResult result;
+    result.stats = std::move(stats);
+    result.depth = depth;
+    queue.push(std::move(result));
+
+    // the writer also wakes up on its own, so a wakeup lost to a race only delays the output
+    if (writerWaiting.load()) {
+        wakeCondVar.notify_one();
+    }
+}
+
+/**
+ * @brief Writes every queued result, flushes the outputs and stops the writer thread.
+ *
+ * Must only be called once no worker submits results anymore.
+ */
+void ResultSink::stop() {
+    if (!writer.joinable()) {
+        return;
+    }
+    stopRequested = true;
+    wakeCondVar.notify_one();
+    writer.join();
+}
+
+void ResultSink::runWriter() {
+    auto lastFlush = std::chrono::steady_clock::now();
+
+    while (true) {
+        bool stopping = stopRequested.load(); // read before draining, so results submitted before stop() are written
+
+        SiteResult result;
+        while (queue.pop(result)) {
+            if (consoleOutput) formatConsole(result);
+            if (csvFile.is_open()) formatCsv(result);
+            if (binaryFile.isOpen()) binaryFile.append(result.stats, result.depth);
+            if (writtenListener) writtenSites.push_back(std::move(result.stats.hostname));
+        }
+
+        if (!consoleText.empty()) {
+            std::cout.write(consoleText.data(), consoleText.size());
+            std::cout.flush();
+            consoleText.clear();
+        }
+        if (!csvText.empty()) {
+            csvFile.write(csvText.data(), csvText.size());
+            csvText.clear();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (stopping || now - lastFlush >= std::chrono::milliseconds(flushIntervalMs)) {
+            if (csvFile.is_open()) csvFile.flush();
+            if (binaryFile.isOpen()) binaryFile.flush();
+            lastFlush = now;
+
+            for (auto& site : writtenSites) writtenListener(site);
+            writtenSites.clear();
+        }
+
+        if (stopping) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        writerWaiting = true;
+        wakeCondVar.wait_for(lock, std::chrono::milliseconds(WRITER_IDLE_WAIT_MS));
+        writerWaiting = false;
+    }
+
+    if (csvFile.is_open()) {
+        csvFile.close();
+        if (csvFile.fail()) {
+            std::cerr << " [!] Error: Failed to write the CSV file." << std::endl;
+        }
+    }
+    if (binaryFile.isOpen() && !binaryFile.close()) {
+        std::cerr << " [!] Error: Failed to write the binary results file." << std::endl;
+    }
+}
+
+/**
+ * @brief Formats the console report of a crawled site.
+ *
+ * @param result The site and its statistics.
+ */
+void ResultSink::formatConsole(const SiteResult& result) {
+    const Socket::SiteStats& stats = result.stats;
+    std::ostringstream out;
+
+    out << "----------------------------------------------------------------------------\n";
+    out << " - Website: " << stats.hostname << "\n";
+    out << " - Depth (distance from the starting pages): " << result.depth << "\n";
+    out << " - Pages Discovered: " << stats.discoveredPages.size() << "\n";
+    out << " - Failed Queries: " << stats.failedQueries << "\n";
+    out << " - Linked Sites: " << stats.linkedSites.size() << "\n";
+
+    if (stats.minResponseTime < 0) out << " - Min. Response Time: -\n";
+    else out << " - Min. Response Time: " << stats.minResponseTime << "ms\n";
+
+    if (stats.maxResponseTime < 0) out << " - Max. Response Time: -\n";
+    else out << " - Max. Response Time: " << stats.maxResponseTime << "ms\n";
+
+    if (stats.averageResponseTime < 0) out << " - Avg Response Time: -\n";
+    else out << " - Avg Response Time: " << stats.averageResponseTime << "ms\n";
+
+    if (!stats.discoveredPages.empty()) {
+        out << "\n [*] List of visited pages:\n";
+        out << "    " << std::setw(15) << "Response Time" << "    " << "URL\n";
+        for (auto& page : stats.discoveredPages) {
+            out << "    " << std::setw(13) << page.second << "ms" << "    " << page.first << "\n";
+        }
+    }
+
+    consoleText += out.str();
+}
+
+/**
+ * @brief Formats the CSV record of a crawled site.
+ *
+ * @param result The site and its statistics.
+ */
+void ResultSink::formatCsv(const SiteResult& result) {
+    const Socket::SiteStats& stats = result.stats;
+
+    csvText += stats.hostname + ",";
+    csvText += std::to_string(result.depth) + ",";
+    csvText += std::to_string(stats.discoveredPages.size()) + ",";
+    csvText += std::to_string(stats.failedQueries) + ",";
+    csvText += std::to_string(stats.linkedSites.size()) + ",";
+    csvText += (stats.minResponseTime < 0 ? "-" : std::to_string(stats.minResponseTime)) + ",";
+    csvText += (stats.maxResponseTime < 0 ? "-" : std::to_string(stats.maxResponseTime)) + ",";
+    csvText += (stats.averageResponseTime < 0 ? "-" : std::to_string(stats.averageResponseTime)) + ",";
+
+    if (stats.discoveredPages.empty()) {
+        csvText += "None";
+    } else {
+        for (size_t i = 0; i < stats.discoveredPages.size(); ++i) {
+            csvText += stats.discoveredPages[i].first;
+            if (i != stats.discoveredPages.size() - 1) {
+                csvText += "; "; // semicolon as delimiter n the cell
+            }
+        }
+    }
+    csvText += "\n";
+}
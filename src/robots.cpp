@@ -0,0 +1,296 @@
+/**
+ * @file robots.cpp
+ * @brief Implementation of the robots.txt parser, its compiled rule matcher and the per-host rule cache.
+ *
+ * robots.txt is parsed following RFC 9309: the groups naming the crawler's product token are used, or
+ * the `*` groups if none does, and among the rules matching a path the longest one wins, Allow winning
+ * ties. The plain prefix rules, the vast majority, are stored in a byte trie, so a path is checked in
+ * a single walk whatever the number of rules; the few rules with wildcards are matched one by one, and
+ * only while they are longer than the best prefix match. Compiled rules are immutable and shared, the
+ * sites without robots.txt all use the same allow-all instance.
+ */
+
+#include "robots.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+// Crawl-delay values above this are clamped, so a single host cannot hold a crawl slot for hours
+const int MAX_CRAWL_DELAY_MS = 60000;
+
+static std::string_view trim(std::string_view text) {
+    size_t start = text.find_first_not_of(" \t\r");
+    if (start == std::string_view::npos) {
+        return std::string_view();
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(start, end - start + 1);
+}
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return tolower(static_cast<unsigned char>(x)) == tolower(static_cast<unsigned char>(y));
+    });
+}
+
+/**
+ * @brief Constructs an empty set of rules, which allows every path.
+ */
+RobotsRules::RobotsRules() : crawlDelayMs(-1) {
+    trie.push_back(TrieNode{-1, -1, 0, -1});
+}
+
+/**
+ * @brief Parses a robots.txt file and compiles the rules that apply to the crawler.
+ *
+ * @param text The content of robots.txt.
+ * @param productToken The product token of the crawler, e.g. "threadr", compared case-insensitively.
+ * @return The compiled rules.
+ */
+RobotsRules RobotsRules::parse(std::string_view text, std::string_view productToken) {
+    std::vector<std::pair<std::string_view, bool>> specificRules;
+    std::vector<std::pair<std::string_view, bool>> defaultRules;
+    int specificDelayMs = -1;
+    int defaultDelayMs = -1;
+    bool hasSpecificGroup = false;
+
+    bool readingAgents = false;
+    bool groupIsSpecific = false;
+    bool groupIsDefault = false;
+    size_t position = 0;
+    while (position < text.size()) {
+        size_t lineEnd = text.find('\n', position);
+        if (lineEnd == std::string_view::npos) lineEnd = text.size();
+        std::string_view line = text.substr(position, lineEnd - position);
+        position = lineEnd + 1;
+
+        line = line.substr(0, line.find('#'));
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view key = trim(line.substr(0, colon));
+        std::string_view value = trim(line.substr(colon + 1));
+
+        if (equalsIgnoreCase(key, "user-agent")) {
+            if (!readingAgents) { // the first user-agent line after rules starts a new group
+                readingAgents = true;
+                groupIsSpecific = false;
+                groupIsDefault = false;
+            }
+            std::string_view agent = value.substr(0, value.find_first_of("/ \t"));
+            if (agent == "*") {
+                groupIsDefault = true;
+            } else if (equalsIgnoreCase(agent, productToken)) {
+                groupIsSpecific = true;
+                hasSpecificGroup = true;
+            }
+            continue;
+        }
+
+        bool isAllow = equalsIgnoreCase(key, "allow");
+        bool isDisallow = equalsIgnoreCase(key, "disallow");
+        bool isCrawlDelay = equalsIgnoreCase(key, "crawl-delay");
+        if (!isAllow && !isDisallow && !isCrawlDelay) {
+            continue; // e.g. Sitemap, which does not end the group
+        }
+        readingAgents = false;
+
+        if (isCrawlDelay) {
+            std::string delayText(value);
+            char* end = nullptr;
+            double seconds = std::strtod(delayText.c_str(), &end);
+            if (end == delayText.c_str() || seconds < 0) {
+                continue;
+            }
+            int delayMs = static_cast<int>(std::min<double>(seconds * 1000, MAX_CRAWL_DELAY_MS));
+            if (groupIsSpecific) specificDelayMs = delayMs;
+            if (groupIsDefault) defaultDelayMs = delayMs;
+        } else if (!value.empty()) { // an empty Disallow allows everything, which is the default anyway
+            if (groupIsSpecific) specificRules.emplace_back(value, isAllow);
+            if (groupIsDefault) defaultRules.emplace_back(value, isAllow);
+        }
+    }
+
+    RobotsRules rules;
+    for (const auto& rule : hasSpecificGroup ? specificRules : defaultRules) {
+        rules.addRule(rule.first, rule.second);
+    }
+    std::stable_sort(rules.patternRules.begin(), rules.patternRules.end(), [](const PatternRule& a, const PatternRule& b) {
+        return a.pattern.size() > b.pattern.size();
+    });
+    rules.crawlDelayMs = hasSpecificGroup ? specificDelayMs : defaultDelayMs;
+    return rules;
+}
+
+/**
+ * @brief Gets the shared rules of a site without usable robots.txt (e.g. 404), which allow every path.
+ */
+std::shared_ptr<const RobotsRules> RobotsRules::getAllowAll() {
+    static const std::shared_ptr<const RobotsRules> allowAll = std::make_shared<const RobotsRules>();
+    return allowAll;
+}
+
+/**
+ * @brief Gets the shared rules of a site whose robots.txt is unavailable (5xx), which disallow every path.
+ */
+std::shared_ptr<const RobotsRules> RobotsRules::getDisallowAll() {
+    static const std::shared_ptr<const RobotsRules> disallowAll = std::make_shared<const RobotsRules>(parse("User-agent: *\nDisallow: /\n", "*"));
+    return disallowAll;
+}
+
+/**
+ * @brief Checks whether the crawler may fetch a path.
+ *
+ * @param path The path of the page, starting with '/'.
+ * @return True if the path is allowed, otherwise false.
+ */
+bool RobotsRules::isAllowed(std::string_view path) const {
+    if (path == "/robots.txt") {
+        return true;
+    }
+
+    int bestLength = -1;
+    bool allowed = true;
+
+    int32_t node = 0;
+    for (size_t depth = 0; depth < path.size(); depth++) {
+        int32_t child = trie[node].firstChild;
+        while (child != -1 && trie[child].byte != path[depth]) {
+            child = trie[child].nextSibling;
+        }
+        if (child == -1) {
+            break;
+        }
+        node = child;
+        if (trie[node].rule >= 0) {
+            bestLength = static_cast<int>(depth + 1);
+            allowed = trie[node].rule == 1;
+        }
+    }
+
+    for (const auto& rule : patternRules) {
+        int length = static_cast<int>(rule.pattern.size());
+        if (length < bestLength) {
+            break; // the remaining rules are shorter still
+        }
+        if ((length > bestLength || (rule.allow && !allowed)) && matchesPattern(rule.pattern, path)) {
+            bestLength = length;
+            allowed = rule.allow;
+        }
+    }
+    return allowed;
+}
+
+void RobotsRules::addRule(std::string_view pattern, bool allow) {
+    std::string normalized = pattern.front() == '/' || pattern.front() == '*' ? std::string() : "/";
+    for (char c : pattern) {
+        if (c != '*' || normalized.empty() || normalized.back() != '*') normalized.push_back(c);
+    }
+    while (normalized.size() > 1 && normalized.back() == '*') {
+        normalized.pop_back(); // rules are prefixes already
+    }
+
+    if (normalized.find('*') != std::string::npos || normalized.back() == '$') {
+        patternRules.push_back(PatternRule{normalized, allow});
+        return;
+    }
+
+    int32_t node = 0;
+    for (char c : normalized) {
+        int32_t child = trie[node].firstChild;
+        while (child != -1 && trie[child].byte != c) {
+            child = trie[child].nextSibling;
+        }
+        if (child == -1) {
+            child = static_cast<int32_t>(trie.size());
+            trie.push_back(TrieNode{-1, trie[node].firstChild, c, -1});
+            trie[node].firstChild = child;
+        }
+        node = child;
+    }
+    trie[node].rule = std::max<int8_t>(trie[node].rule, allow ? 1 : 0); // Allow wins over an identical Disallow
+}
+
+/**
+ * @brief Matches a path against a rule with `*` wildcards, anchored at the end if it ends with `$`.
+ */
+bool RobotsRules::matchesPattern(std::string_view pattern, std::string_view path) {
+    bool anchored = pattern.back() == '$';
+    if (anchored) pattern.remove_suffix(1);
+
+    size_t p = 0;
+    size_t s = 0;
+    size_t star = std::string_view::npos;
+    size_t starMatch = 0;
+    while (s < path.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            starMatch = s;
+        } else if (p < pattern.size() && pattern[p] == path[s]) {
+            p++;
+            s++;
+        } else if (p == pattern.size() && !anchored) {
+            return true; // the rest of the path follows the matched prefix
+        } else if (star != std::string_view::npos) {
+            p = star + 1; // let the last `*` absorb one more byte
+            s = ++starMatch;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
+
+
+/**
+ * @brief Constructs an empty RobotsCache object.
+ *
+ * @param capacity The maximum number of hosts whose rules are kept, 0 to disable the cache.
+ */
+RobotsCache::RobotsCache(size_t capacity) : capacity(capacity) {}
+
+/**
+ * @brief Looks the rules of a host up.
+ *
+ * @param hostname The hostname.
+ * @return The compiled rules, or nullptr if the host is not cached.
+ */
+std::shared_ptr<const RobotsRules> RobotsCache::lookup(const std::string& hostname) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = index.find(hostname);
+    if (it == index.end()) {
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+/**
+ * @brief Caches the rules of a host, evicting the least recently used host when the cache is full.
+ *
+ * @param hostname The hostname.
+ * @param rules The compiled rules.
+ */
+void RobotsCache::insert(const std::string& hostname, std::shared_ptr<const RobotsRules> rules) {
+    if (capacity == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = index.find(hostname);
+    if (it != index.end()) {
+        it->second->second = std::move(rules);
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+
+    entries.emplace_front(hostname, std::move(rules));
+    index[hostname] = entries.begin();
+    if (entries.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
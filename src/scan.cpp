@@ -0,0 +1,198 @@
+/**
+ * @file scan.cpp
+ * @brief Implementation of the byte scanning kernels used by the HTML parser.
+ *
+ * The parser spends most of its time looking for a handful of byte values (the first bytes of the link
+ * patterns, the characters that end a URL) and lowercasing ASCII text. These kernels do that 16 (SSE2)
+ * or 32 (AVX2) bytes at a time, with a scalar fallback. The implementation is selected once at runtime
+ * from the CPU features, so the binary does not need to be built for a specific instruction set.
+ */
+
+#include "scan.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define THREADR_SCAN_X86 1
+#endif
+
+// the vector kernels compare against each member of the set, so they are only used for small sets
+const size_t MAX_VECTOR_SET_SIZE = 16;
+
+/**
+ * @brief Creates a set of byte values.
+ *
+ * @param bytes The bytes in the set. Duplicates are ignored.
+ */
+ByteSet::ByteSet(const std::string& bytes) : table{} {
+    for (char ch : bytes) {
+        unsigned char byte = static_cast<unsigned char>(ch);
+        if (!table[byte]) {
+            table[byte] = true;
+            this->bytes.push_back(ch);
+        }
+    }
+}
+
+static size_t findFirstOfScalar(const char* data, size_t length, const ByteSet& set) {
+    for (size_t i = 0; i < length; i++) {
+        if (set.contains(static_cast<unsigned char>(data[i]))) {
+            return i;
+        }
+    }
+    return length;
+}
+
+static void toLowerAsciiScalar(char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] >= 'A' && data[i] <= 'Z') {
+            data[i] = static_cast<char>(data[i] + ('a' - 'A'));
+        }
+    }
+}
+
+#ifdef THREADR_SCAN_X86
+
+__attribute__((target("sse2")))
+static size_t findFirstOfSse2(const char* data, size_t length, const ByteSet& set) {
+    const std::string& bytes = set.getBytes();
+    __m128i needles[MAX_VECTOR_SET_SIZE];
+    for (size_t j = 0; j < bytes.size(); j++) {
+        needles[j] = _mm_set1_epi8(bytes[j]);
+    }
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_setzero_si128();
+        for (size_t j = 0; j < bytes.size(); j++) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[j]));
+        }
+        int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + findFirstOfScalar(data + i, length - i, set);
+}
+
+__attribute__((target("sse2")))
+static void toLowerAsciiSse2(char* data, size_t length) {
+    // bytes in ['A', 'Z'] are moved into [-128, -103] by the offset, where a signed compare can find them
+    const __m128i offset = _mm_set1_epi8(static_cast<char>(128 - 'A'));
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(-128 + 26));
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i isUpper = _mm_cmplt_epi8(_mm_add_epi8(block, offset), limit);
+        block = _mm_or_si128(block, _mm_and_si128(isUpper, caseBit));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), block);
+    }
+    toLowerAsciiScalar(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t findFirstOfAvx2(const char* data, size_t length, const ByteSet& set) {
+    const std::string& bytes = set.getBytes();
+    __m256i needles[MAX_VECTOR_SET_SIZE];
+    for (size_t j = 0; j < bytes.size(); j++) {
+        needles[j] = _mm256_set1_epi8(bytes[j]);
+    }
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hits = _mm256_setzero_si256();
+        for (size_t j = 0; j < bytes.size(); j++) {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[j]));
+        }
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + findFirstOfSse2(data + i, length - i, set);
+}
+
+__attribute__((target("avx2")))
+static void toLowerAsciiAvx2(char* data, size_t length) {
+    const __m256i offset = _mm256_set1_epi8(static_cast<char>(128 - 'A'));
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(-128 + 26));
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i isUpper = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(block, offset));
+        block = _mm256_or_si256(block, _mm256_and_si256(isUpper, caseBit));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), block);
+    }
+    toLowerAsciiSse2(data + i, length - i);
+}
+
+#endif // THREADR_SCAN_X86
+
+struct ScanKernels {
+    const char* name;
+    size_t (*findFirstOf)(const char*, size_t, const ByteSet&);
+    void (*toLowerAscii)(char*, size_t);
+};
+
+/**
+ * @brief Picks the fastest kernels supported by the CPU the crawler runs on.
+ *
+ * @return The selected kernels.
+ */
+static ScanKernels selectKernels() {
+#ifdef THREADR_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"avx2", findFirstOfAvx2, toLowerAsciiAvx2};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return {"sse2", findFirstOfSse2, toLowerAsciiSse2};
+    }
+#endif
+    return {"scalar", findFirstOfScalar, toLowerAsciiScalar};
+}
+
+static const ScanKernels& kernels() {
+    static const ScanKernels selected = selectKernels();
+    return selected;
+}
+
+/**
+ * @brief Finds the first byte of a buffer that belongs to a set.
+ *
+ * @param data The buffer to scan.
+ * @param length The length of the buffer.
+ * @param set The bytes to look for.
+ * @return The offset of the first matching byte, or length if there is none.
+ */
+size_t findFirstOf(const char* data, size_t length, const ByteSet& set) {
+    if (set.getBytes().size() > MAX_VECTOR_SET_SIZE) {
+        return findFirstOfScalar(data, length, set);
+    }
+    return kernels().findFirstOf(data, length, set);
+}
+
+/**
+ * @brief Lowercases the ASCII letters of a buffer in place. Other bytes are left untouched.
+ *
+ * @param data The buffer to lowercase.
+ * @param length The length of the buffer.
+ */
+void toLowerAscii(char* data, size_t length) {
+    kernels().toLowerAscii(data, length);
+}
+
+/**
+ * @brief Returns the name of the kernels selected for this CPU ("avx2", "sse2" or "scalar").
+ *
+ * @return The kernel name.
+ */
+const char* getScanKernelName() {
+    return kernels().name;
+}
@@ -0,0 +1,932 @@
+/**
+ * @file shard.cpp
+ * @brief Implementation of the sharded crawl: the shard side connection and the coordinator process.
+ *
+ * Every hostname is owned by one shard, picked by its hash, and only its owner crawls it. A shard keeps
+ * its own frontier; the linked sites it finds for other shards are marked as seen locally, so each is
+ * forwarded once, and sent to the coordinator in batches along with the results of the crawled sites.
+ * The coordinator routes every site to its owner and hands the results to a single result sink.
+ *
+ * Termination: a shard reports a Status message, carrying the number of sites it has received, whenever
+ * it has no site pending or in progress and has flushed what it had to send. As every connection is
+ * ordered, the coordinator has routed all the sites found by a shard before it reads its Status. Once
+ * every shard is idle and has received every site routed to it, no site is in flight anywhere, and the
+ * coordinator sends Stop. The shards then finish, flush their results and close their connection.
+ *
+ * When the crawl exports metrics, every shard also sends the merged values of its threads at the metrics
+ * interval and once more when it finishes. The coordinator keeps the latest values of each shard and
+ * writes their sum to the metrics file, so a sharded crawl exports one file like a single process.
+ *
+ * Payloads (little-endian, strings as uint32 size then bytes):
+ *   Hello:  uint32 shard index, uint32 shard count
+ *   Sites:  uint32 count, then per site uint32 depth, string hostname
+ *   Result: string hostname, int32 depth, uint32 failed queries, float64 min/max/average response time,
+ *           uint32 page count, per page string URL, float64 response time, uint32 link count, strings
+ *   Status: uint64 received sites
+ *   Stop:   empty
+ *   Metrics: float64 elapsed seconds, per counter uint64 value, per stage uint64 count, sum and max
+ *            (microseconds), uint32 non-empty bucket count, per bucket uint32 index, uint64 value
+ */
+
+#include "shard.h"
+#include "result_sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+const size_t MAX_MESSAGE_SIZE = 64 << 20;
+const size_t RECEIVE_BUFFER_SIZE = 65536;
+// a batch is sent once it is this large, or after the flush interval
+const uint32_t MAX_BATCH_SITES = 256;
+const size_t MAX_BATCH_BYTES = 256 * 1024;
+const int FLUSH_INTERVAL_MS = 20;
+const int CHILD_CHECK_INTERVAL_MS = 200;
+
+/**
+ * @brief Gets the shard owning a hostname.
+ *
+ * The fingerprint is mixed again first: its high bits select the seen-set stripe of the frontier and its
+ * low bits the slot, so deriving the shard from either would leave every shard with a fraction of them.
+ *
+ * @param hostname The hostname.
+ * @param shardCount The number of shards.
+ * @return The index of the owning shard.
+ */
+int getShardOwner(std::string_view hostname, int shardCount) {
+    uint64_t hash = getUrlFingerprint(hostname);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return static_cast<int>(hash % static_cast<uint64_t>(shardCount));
+}
+
+static void appendU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+static void appendU64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+static void appendDouble(std::string& out, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    appendU64(out, bits);
+}
+
+static void appendString(std::string& out, std::string_view text) {
+    appendU32(out, static_cast<uint32_t>(text.size()));
+    out.append(text.data(), text.size());
+}
+
+static void appendMessage(std::string& out, ShardMessage type, std::string_view payload) {
+    appendU32(out, static_cast<uint32_t>(payload.size()));
+    out.push_back(static_cast<char>(type));
+    out.append(payload.data(), payload.size());
+}
+
+// Reads the fields of a payload, any read past its end fails the whole payload.
+class PayloadReader {
+public:
+    explicit PayloadReader(std::string_view data) : data(data), position(0), valid(true) {}
+
+    bool hasFailed() const { return !valid; }
+    bool isComplete() const { return valid && position == data.size(); }
+
+    uint64_t readU64() { return readInteger(8); }
+    uint32_t readU32() { return static_cast<uint32_t>(readInteger(4)); }
+
+    double readDouble() {
+        uint64_t bits = readU64();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string readString() {
+        uint32_t size = readU32();
+        if (!valid || size > data.size() - position) {
+            valid = false;
+            return std::string();
+        }
+        position += size;
+        return std::string(data.substr(position - size, size));
+    }
+
+private:
+    std::string_view data;
+    size_t position;
+    bool valid;
+
+    uint64_t readInteger(int size) {
+        if (!valid || data.size() - position < static_cast<size_t>(size)) {
+            valid = false;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < size; i++) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(data[position + i])) << (8 * i);
+        }
+        position += size;
+        return value;
+    }
+};
+
+/**
+ * @brief Handles the complete messages at the start of a buffer and removes them from it.
+ *
+ * @param buffer The received bytes.
+ * @param handle Called for every message, returns false to stop reading.
+ * @return False if a message is malformed or a handler stopped reading, otherwise true.
+ */
+static bool readMessages(std::string& buffer, const std::function<bool(ShardMessage, std::string_view)>& handle) {
+    size_t position = 0;
+    bool ok = true;
+    while (buffer.size() - position >= 5) {
+        PayloadReader header(std::string_view(buffer).substr(position, 4));
+        uint32_t size = header.readU32();
+        if (size > MAX_MESSAGE_SIZE) {
+            ok = false;
+            break;
+        }
+        if (buffer.size() - position < 5 + static_cast<size_t>(size)) {
+            break;
+        }
+        ShardMessage type = static_cast<ShardMessage>(buffer[position + 4]);
+        std::string_view payload = std::string_view(buffer).substr(position + 5, size);
+        position += 5 + static_cast<size_t>(size);
+        if (!handle(type, payload)) {
+            ok = false;
+            break;
+        }
+    }
+    buffer.erase(0, position);
+    return ok;
+}
+
+static std::string encodeResult(const Socket::SiteStats& stats, int depth) {
+    std::string payload;
+    appendString(payload, stats.hostname);
+    appendU32(payload, static_cast<uint32_t>(depth));
+    appendU32(payload, static_cast<uint32_t>(stats.failedQueries));
+    appendDouble(payload, stats.minResponseTime);
+    appendDouble(payload, stats.maxResponseTime);
+    appendDouble(payload, stats.averageResponseTime);
+    appendU32(payload, static_cast<uint32_t>(stats.discoveredPages.size()));
+    for (const auto& page : stats.discoveredPages) {
+        appendString(payload, page.first);
+        appendDouble(payload, page.second);
+    }
+    appendU32(payload, static_cast<uint32_t>(stats.linkedSites.size()));
+    for (const auto& site : stats.linkedSites) {
+        appendString(payload, site);
+    }
+    return payload;
+}
+
+static bool decodeResult(std::string_view payload, Socket::SiteStats& stats, int& depth) {
+    PayloadReader reader(payload);
+    stats.hostname = reader.readString();
+    depth = static_cast<int32_t>(reader.readU32());
+    stats.failedQueries = static_cast<int>(reader.readU32());
+    stats.minResponseTime = reader.readDouble();
+    stats.maxResponseTime = reader.readDouble();
+    stats.averageResponseTime = reader.readDouble();
+    uint32_t pageCount = reader.readU32();
+    for (uint32_t i = 0; i < pageCount && !reader.hasFailed(); i++) {
+        std::string url = reader.readString();
+        double responseTime = reader.readDouble();
+        stats.discoveredPages.emplace_back(std::move(url), responseTime);
+    }
+    uint32_t linkCount = reader.readU32();
+    for (uint32_t i = 0; i < linkCount && !reader.hasFailed(); i++) {
+        stats.linkedSites.push_back(reader.readString());
+    }
+    return reader.isComplete();
+}
+
+static std::string encodeMetrics(const Metrics::Snapshot& snapshot) {
+    std::string payload;
+    appendDouble(payload, snapshot.elapsedSeconds);
+    for (uint64_t counter : snapshot.counters) {
+        appendU64(payload, counter);
+    }
+    for (const auto& stage : snapshot.stages) {
+        appendU64(payload, stage.count);
+        appendU64(payload, stage.sum);
+        appendU64(payload, stage.max);
+        uint32_t bucketCount = static_cast<uint32_t>(std::count_if(stage.buckets.begin(), stage.buckets.end(), [](uint64_t bucket) { return bucket != 0; }));
+        appendU32(payload, bucketCount);
+        for (size_t i = 0; i < stage.buckets.size(); i++) {
+            if (stage.buckets[i] == 0) continue;
+            appendU32(payload, static_cast<uint32_t>(i));
+            appendU64(payload, stage.buckets[i]);
+        }
+    }
+    return payload;
+}
+
+static bool decodeMetrics(std::string_view payload, Metrics::Snapshot& snapshot) {
+    PayloadReader reader(payload);
+    snapshot = Metrics::Snapshot();
+    snapshot.elapsedSeconds = reader.readDouble();
+    for (uint64_t& counter : snapshot.counters) {
+        counter = reader.readU64();
+    }
+    for (auto& stage : snapshot.stages) {
+        stage.count = reader.readU64();
+        stage.sum = reader.readU64();
+        stage.max = reader.readU64();
+        uint32_t bucketCount = reader.readU32();
+        for (uint32_t i = 0; i < bucketCount && !reader.hasFailed(); i++) {
+            uint32_t index = reader.readU32();
+            uint64_t value = reader.readU64();
+            if (index >= stage.buckets.size()) return false;
+            stage.buckets[index] = value;
+        }
+    }
+    return reader.isComplete();
+}
+
+static bool decodeSites(std::string_view payload, std::vector<std::pair<std::string, int>>& sites) {
+    PayloadReader reader(payload);
+    uint32_t count = reader.readU32();
+    for (uint32_t i = 0; i < count && !reader.hasFailed(); i++) {
+        int depth = static_cast<int>(reader.readU32());
+        sites.emplace_back(reader.readString(), depth);
+    }
+    return reader.isComplete();
+}
+
+
+/**
+ * @brief Constructs a ShardClient object.
+ *
+ * @param shardIndex The index of this shard.
+ * @param shardCount The number of shards of the crawl.
+ */
+ShardClient::ShardClient(int shardIndex, int shardCount)
+    : shardIndex(shardIndex), shardCount(shardCount), fd(-1), metrics(nullptr), metricsIntervalMs(0), pendingSiteCount(0), finishRequested(false),
+      receivedSites(0), stopped(false) {}
+
+ShardClient::~ShardClient() {
+    if (sender.joinable()) {
+        finish();
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/**
+ * @brief Connects to the coordinator.
+ *
+ * @param path The path of the coordinator's Unix domain socket.
+ * @return True if connected, otherwise false.
+ */
+bool ShardClient::connectTo(const std::string& path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << " [!] Error: Shard socket path too long: " << path << std::endl;
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << " [!] Error: Cannot connect to the coordinator at " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Sends the metrics of the shard to the coordinator at a fixed interval and when it finishes.
+ *
+ * Must be called before start().
+ *
+ * @param metrics The metrics of the shard's crawler.
+ * @param intervalMs The interval between two reports in milliseconds.
+ */
+void ShardClient::reportMetrics(Metrics* metrics, int intervalMs) {
+    this->metrics = metrics;
+    metricsIntervalMs = std::max(1, intervalMs);
+}
+
+/**
+ * @brief Announces the shard to the coordinator and starts exchanging messages.
+ *
+ * @param onSites Called with the sites routed to this shard. Runs on the reader thread.
+ * @param onStop Called once the crawl is over, or when the coordinator is lost. Runs on the reader thread.
+ * @param isIdle Tells whether the shard has no site pending or in progress.
+ */
+void ShardClient::start(std::function<void(std::vector<Site>&)> onSites, std::function<void()> onStop, std::function<bool()> isIdle) {
+    this->onSites = std::move(onSites);
+    this->onStop = std::move(onStop);
+    this->isIdle = std::move(isIdle);
+
+    std::string payload;
+    appendU32(payload, static_cast<uint32_t>(shardIndex));
+    appendU32(payload, static_cast<uint32_t>(shardCount));
+    appendMessage(pendingOutput, ShardMessage::Hello, payload);
+
+    reader = std::thread(&ShardClient::runReader, this);
+    sender = std::thread(&ShardClient::runSender, this);
+}
+
+/**
+ * @brief Queues a linked site owned by another shard. Safe to call from any thread.
+ *
+ * @param hostname The hostname of the site.
+ * @param depth The depth of the site.
+ */
+void ShardClient::forwardSite(const std::string& hostname, int depth) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    appendU32(pendingSites, static_cast<uint32_t>(depth));
+    appendString(pendingSites, hostname);
+    if (++pendingSiteCount >= MAX_BATCH_SITES) {
+        outputCondVar.notify_one();
+    }
+}
+
+/**
+ * @brief Queues the results of a crawled site for the coordinator. Safe to call from any thread.
+ *
+ * @param stats The statistics of the site.
+ * @param depth The depth of the site.
+ */
+void ShardClient::submitResult(const Socket::SiteStats& stats, int depth) {
+    std::string payload = encodeResult(stats, depth);
+    std::lock_guard<std::mutex> lock(outputMutex);
+    appendMessage(pendingOutput, ShardMessage::Result, payload);
+    if (pendingOutput.size() >= MAX_BATCH_BYTES) {
+        outputCondVar.notify_one();
+    }
+}
+
+/**
+ * @brief Sends what is still queued and closes the shard's side of the connection, once the crawl of the
+ *        shard has ended.
+ */
+void ShardClient::finish() {
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        finishRequested = true;
+    }
+    outputCondVar.notify_one();
+    if (sender.joinable()) sender.join();
+
+    stopped = true;
+    shutdown(fd, SHUT_WR); // the coordinator closes in turn, which ends the reader if no Stop was received
+    if (reader.joinable()) reader.join();
+}
+
+void ShardClient::runReader() {
+    std::vector<char> receivedDataBuffer(RECEIVE_BUFFER_SIZE);
+    std::string buffer;
+    bool stopReceived = false;
+
+    while (!stopReceived) {
+        ssize_t bytesRead = recv(fd, receivedDataBuffer.data(), receivedDataBuffer.size(), 0);
+        if (bytesRead <= 0) {
+            if (bytesRead < 0 && errno == EINTR) continue;
+            break;
+        }
+        buffer.append(receivedDataBuffer.data(), bytesRead);
+
+        bool valid = readMessages(buffer, [this, &stopReceived](ShardMessage type, std::string_view payload) {
+            if (type == ShardMessage::Sites) {
+                std::vector<Site> sites;
+                if (!decodeSites(payload, sites)) return false;
+                onSites(sites);
+                receivedSites += sites.size(); // counted once queued, see runSender()
+            } else if (type == ShardMessage::Stop) {
+                stopReceived = true;
+                return false;
+            }
+            return true;
+        });
+        if (!valid && !stopReceived) {
+            std::cerr << " [!] Error: Invalid message from the coordinator" << std::endl;
+            break;
+        }
+    }
+
+    if (!stopped.exchange(true)) {
+        if (!stopReceived) std::cerr << " [!] Error: Lost the connection to the coordinator" << std::endl;
+        onStop();
+    }
+}
+
+void ShardClient::runSender() {
+    bool reportedIdle = false;
+    uint64_t reportedSites = 0;
+    bool broken = false;
+    auto nextMetricsTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(outputMutex);
+    while (true) {
+        outputCondVar.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] {
+            return finishRequested || pendingSiteCount >= MAX_BATCH_SITES || pendingOutput.size() >= MAX_BATCH_BYTES;
+        });
+        bool finishing = finishRequested;
+
+        // the received count is read before the idle state: a site counted in it has already been queued
+        lock.unlock();
+        uint64_t received = receivedSites.load();
+        bool idle = !finishing && isIdle();
+        std::string metricsPayload;
+        if (metrics != nullptr && (finishing || std::chrono::steady_clock::now() >= nextMetricsTime)) {
+            metricsPayload = encodeMetrics(metrics->collect()); // the workers have exited when finishing, so these are final
+            nextMetricsTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(metricsIntervalMs);
+        }
+        lock.lock();
+
+        // the sites and results of the completed sites are taken after the idle state, so they are sent first
+        std::string output;
+        output.swap(pendingOutput);
+        if (pendingSiteCount > 0) {
+            std::string payload;
+            appendU32(payload, pendingSiteCount);
+            payload += pendingSites;
+            appendMessage(output, ShardMessage::Sites, payload);
+            pendingSites.clear();
+            pendingSiteCount = 0;
+        }
+        lock.unlock();
+
+        if (idle && (!reportedIdle || received != reportedSites)) {
+            std::string payload;
+            appendU64(payload, received);
+            appendMessage(output, ShardMessage::Status, payload);
+            reportedSites = received;
+        }
+        reportedIdle = idle;
+        if (!metricsPayload.empty()) {
+            appendMessage(output, ShardMessage::Metrics, metricsPayload);
+        }
+
+        if (!output.empty() && !broken && !writeAll(output)) {
+            std::cerr << " [!] Error: Cannot send to the coordinator: " << strerror(errno) << std::endl;
+            broken = true;
+        }
+
+        lock.lock();
+        if (finishing && pendingOutput.empty() && pendingSiteCount == 0) {
+            return;
+        }
+    }
+}
+
+bool ShardClient::writeAll(const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t bytesSent = send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (bytesSent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        offset += static_cast<size_t>(bytesSent);
+    }
+    return true;
+}
+
+
+class ShardCoordinator::Connection : public EventHandler {
+public:
+    Connection(ShardCoordinator& coordinator, int fd) : coordinator(coordinator), fd(fd), outputOffset(0), writing(false) {}
+    ~Connection() override { close(); }
+
+    void handleEvent(uint32_t events) override;
+    void send(const std::string& data);
+    void close();
+    bool isClosed() const { return fd < 0; }
+
+    int shardIndex = -1;
+
+private:
+    ShardCoordinator& coordinator;
+    int fd;
+    std::string input;
+    std::string output;
+    size_t outputOffset;
+    bool writing;
+
+    void flush();
+};
+
+void ShardCoordinator::Connection::handleEvent(uint32_t events) {
+    if (events & EPOLLOUT) {
+        flush();
+    }
+    if (isClosed() || !(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        return;
+    }
+
+    char receivedDataBuffer[RECEIVE_BUFFER_SIZE];
+    while (!isClosed()) {
+        ssize_t bytesRead = recv(fd, receivedDataBuffer, sizeof(receivedDataBuffer), 0);
+        if (bytesRead > 0) {
+            input.append(receivedDataBuffer, bytesRead);
+            bool valid = readMessages(input, [this](ShardMessage type, std::string_view payload) {
+                coordinator.handleMessage(*this, type, payload);
+                return !isClosed();
+            });
+            if (!valid && !isClosed()) {
+                std::cerr << " [!] Error: Invalid message from shard " << shardIndex << std::endl;
+                coordinator.handleClose(*this);
+            }
+        } else if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        } else if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            coordinator.handleClose(*this);
+        }
+    }
+}
+
+/**
+ * @brief Queues messages for the shard, writing as much as the socket takes right away.
+ */
+void ShardCoordinator::Connection::send(const std::string& data) {
+    if (isClosed()) {
+        return;
+    }
+    output += data;
+    if (!writing) {
+        flush();
+    }
+}
+
+void ShardCoordinator::Connection::flush() {
+    while (outputOffset < output.size()) {
+        ssize_t bytesSent = ::send(fd, output.data() + outputOffset, output.size() - outputOffset, MSG_NOSIGNAL);
+        if (bytesSent < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && !writing) {
+                writing = true;
+                coordinator.loop.modifyFd(fd, EPOLLIN | EPOLLRDHUP | EPOLLOUT, this);
+            }
+            return; // on an error, the closed connection is reported by the read side
+        }
+        outputOffset += static_cast<size_t>(bytesSent);
+    }
+    output.clear();
+    outputOffset = 0;
+    if (writing) {
+        writing = false;
+        coordinator.loop.modifyFd(fd, EPOLLIN | EPOLLRDHUP, this);
+    }
+}
+
+void ShardCoordinator::Connection::close() {
+    if (fd >= 0) {
+        coordinator.loop.removeFd(fd);
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void ShardCoordinator::Listener::handleEvent(uint32_t) {
+    coordinator.accept();
+}
+
+
+/**
+ * @brief Constructs a ShardCoordinator object.
+ *
+ * @param shardCount The number of shard processes.
+ */
+ShardCoordinator::ShardCoordinator(int shardCount)
+    : shardCount(shardCount), listenFd(-1), listener(*this), shards(shardCount), sink(nullptr), stopping(false),
+      failed(false), routedSites(0), resultCount(0), metricsIntervalMs(0) {}
+
+/**
+ * @brief Closes the connections and the socket, and kills the shards still running.
+ */
+ShardCoordinator::~ShardCoordinator() {
+    connections.clear();
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(path.c_str());
+    }
+    for (auto& shard : shards) {
+        if (shard.pid > 0) {
+            kill(shard.pid, SIGTERM);
+            waitpid(shard.pid, nullptr, 0);
+        }
+    }
+}
+
+/**
+ * @brief Creates the Unix domain socket the shards connect to. Must be called before spawn().
+ *
+ * @param path The path of the socket, replaced if it exists.
+ * @return True if the socket is listening, otherwise false.
+ */
+bool ShardCoordinator::listen(const std::string& path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << " [!] Error: Shard socket path too long: " << path << std::endl;
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    unlink(path.c_str());
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0
+        || ::listen(listenFd, shardCount + 16) < 0) {
+        std::cerr << " [!] Error: Cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        if (listenFd >= 0) close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    this->path = path;
+    return true;
+}
+
+/**
+ * @brief Writes the metrics of all the shards to one Prometheus text file while the crawl runs.
+ *
+ * @param path The path of the file.
+ * @param intervalMs The interval between two exports in milliseconds.
+ * @return True if the first export succeeded, otherwise false.
+ */
+bool ShardCoordinator::exportMetrics(const std::string& path, int intervalMs) {
+    metricsPath = path;
+    metricsIntervalMs = std::max(1, intervalMs);
+    return writeMetrics();
+}
+
+/**
+ * @brief Forks the shard processes.
+ *
+ * Must be called before any thread is started in this process, as the children go on running the crawl.
+ *
+ * @param runShard Runs shard N in the child and returns its exit code.
+ * @return True if every shard was started, otherwise false.
+ */
+bool ShardCoordinator::spawn(const std::function<int(int)>& runShard) {
+    std::cout.flush();
+    for (int i = 0; i < shardCount; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << " [!] Error: Cannot start shard " << i << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        if (pid == 0) {
+            close(listenFd);
+            int exitCode = runShard(i);
+            std::cout.flush();
+            std::cerr.flush();
+            _exit(exitCode); // the coordinator's state belongs to the parent
+        }
+        shards[i].pid = pid;
+    }
+    return true;
+}
+
+/**
+ * @brief Routes a start site to its shard.
+ *
+ * @param hostname The hostname of the site.
+ * @param depth The depth of the site.
+ */
+void ShardCoordinator::addSite(const std::string& hostname, int depth) {
+    std::string payload;
+    appendU32(payload, 1);
+    appendU32(payload, static_cast<uint32_t>(depth));
+    appendString(payload, hostname);
+    std::string message;
+    appendMessage(message, ShardMessage::Sites, payload);
+
+    int owner = getShardOwner(hostname, shardCount);
+    shards[owner].forwardedSites++;
+    send(owner, message);
+}
+
+/**
+ * @brief Routes the sites and collects the results until every shard has finished.
+ *
+ * @param sink The result sink receiving the results of every shard, started by the caller.
+ * @return True if every shard completed its part of the crawl, false if one failed.
+ */
+bool ShardCoordinator::run(ResultSink& sink) {
+    this->sink = &sink;
+    loop.addFd(listenFd, EPOLLIN, &listener);
+    loop.runAfter(CHILD_CHECK_INTERVAL_MS, [this] { checkChildren(); });
+    if (!metricsPath.empty()) loop.runAfter(metricsIntervalMs, [this] { updateMetrics(); });
+    loop.run();
+
+    for (auto& shard : shards) {
+        int status = 0;
+        if (shard.pid > 0 && waitpid(shard.pid, &status, 0) == shard.pid) {
+            shard.pid = -1;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = true;
+        }
+    }
+    if (!metricsPath.empty() && !writeMetrics()) {
+        std::cerr << " [!] Error: Unable to write metrics file: " << metricsPath << std::endl;
+    }
+    return !failed;
+}
+
+void ShardCoordinator::accept() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        connections.emplace_back(new Connection(*this, fd));
+        loop.addFd(fd, EPOLLIN | EPOLLRDHUP, connections.back().get());
+    }
+}
+
+void ShardCoordinator::handleMessage(Connection& connection, ShardMessage type, std::string_view payload) {
+    PayloadReader reader(payload);
+    if (type == ShardMessage::Hello) {
+        int index = static_cast<int>(reader.readU32());
+        int count = static_cast<int>(reader.readU32());
+        if (!reader.isComplete() || count != shardCount || index < 0 || index >= shardCount
+            || connection.shardIndex >= 0 || shards[index].connection != nullptr) {
+            std::cerr << " [!] Error: Unexpected shard connection" << std::endl;
+            handleClose(connection);
+            return;
+        }
+        connection.shardIndex = index;
+        shards[index].connection = &connection;
+        connection.send(shards[index].output);
+        shards[index].output.clear();
+        return;
+    }
+    if (connection.shardIndex < 0) {
+        std::cerr << " [!] Error: Message from an unknown shard" << std::endl;
+        handleClose(connection);
+        return;
+    }
+
+    Shard& shard = shards[connection.shardIndex];
+    if (type == ShardMessage::Sites) {
+        std::vector<std::pair<std::string, int>> sites;
+        if (!decodeSites(payload, sites)) {
+            std::cerr << " [!] Error: Invalid message from shard " << connection.shardIndex << std::endl;
+            handleClose(connection);
+            return;
+        }
+        std::vector<std::string> payloads(shardCount);
+        std::vector<uint32_t> counts(shardCount, 0);
+        for (const auto& site : sites) {
+            int owner = getShardOwner(site.first, shardCount);
+            appendU32(payloads[owner], static_cast<uint32_t>(site.second));
+            appendString(payloads[owner], site.first);
+            counts[owner]++;
+        }
+        for (int owner = 0; owner < shardCount; owner++) {
+            if (counts[owner] == 0) continue;
+            std::string batch;
+            appendU32(batch, counts[owner]);
+            batch += payloads[owner];
+            std::string message;
+            appendMessage(message, ShardMessage::Sites, batch);
+            shards[owner].forwardedSites += counts[owner];
+            routedSites += counts[owner];
+            send(owner, message);
+        }
+    } else if (type == ShardMessage::Result) {
+        Socket::SiteStats stats;
+        int depth = 0;
+        if (!decodeResult(payload, stats, depth)) {
+            std::cerr << " [!] Error: Invalid message from shard " << connection.shardIndex << std::endl;
+            handleClose(connection);
+            return;
+        }
+        sink->submit(std::move(stats), depth);
+        resultCount++;
+    } else if (type == ShardMessage::Status) {
+        uint64_t receivedSites = reader.readU64();
+        if (!reader.isComplete()) {
+            std::cerr << " [!] Error: Invalid message from shard " << connection.shardIndex << std::endl;
+            handleClose(connection);
+            return;
+        }
+        shard.receivedSites = receivedSites;
+        shard.idle = true;
+        checkTermination();
+    } else if (type == ShardMessage::Metrics) {
+        if (!decodeMetrics(payload, shard.metrics)) {
+            std::cerr << " [!] Error: Invalid message from shard " << connection.shardIndex << std::endl;
+            handleClose(connection);
+        }
+    }
+}
+
+void ShardCoordinator::handleClose(Connection& connection) {
+    connection.close();
+    if (connection.shardIndex < 0) {
+        return;
+    }
+    Shard& shard = shards[connection.shardIndex];
+    shard.connection = nullptr;
+    shard.closed = true;
+    if (!stopping) {
+        std::cerr << " [!] Error: Shard " << connection.shardIndex << " disconnected before the end of the crawl" << std::endl;
+        failed = true;
+        stopShards();
+    }
+    checkTermination();
+}
+
+void ShardCoordinator::send(int shard, const std::string& message) {
+    if (shards[shard].connection != nullptr) {
+        shards[shard].connection->send(message);
+    } else if (!shards[shard].closed) {
+        shards[shard].output += message;
+    }
+}
+
+/**
+ * @brief Stops the shards once all of them are idle with nothing in flight, and ends the loop once all of
+ *        them have closed their connection.
+ */
+void ShardCoordinator::checkTermination() {
+    bool allClosed = true;
+    bool allIdle = true;
+    for (const auto& shard : shards) {
+        allClosed = allClosed && shard.closed;
+        allIdle = allIdle && (shard.closed || (shard.connection != nullptr && shard.idle && shard.receivedSites == shard.forwardedSites));
+    }
+    if (allClosed) {
+        loop.stop();
+    } else if (allIdle && !stopping) {
+        stopShards();
+    }
+}
+
+/**
+ * @brief Reaps the shards that exited, failing the crawl if one exited before the end.
+ */
+void ShardCoordinator::checkChildren() {
+    for (int i = 0; i < shardCount; i++) {
+        Shard& shard = shards[i];
+        int status = 0;
+        if (shard.pid <= 0 || waitpid(shard.pid, &status, WNOHANG) != shard.pid) {
+            continue;
+        }
+        shard.pid = -1;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << " [!] Error: Shard " << i << " exited abnormally" << std::endl;
+            failed = true;
+        }
+        if (!shard.closed) {
+            if (shard.connection != nullptr) shard.connection->close();
+            shard.connection = nullptr;
+            shard.closed = true;
+            if (!stopping) {
+                failed = true;
+                stopShards();
+            }
+        }
+    }
+    checkTermination();
+    loop.runAfter(CHILD_CHECK_INTERVAL_MS, [this] { checkChildren(); });
+}
+
+void ShardCoordinator::stopShards() {
+    stopping = true;
+    std::string message;
+    appendMessage(message, ShardMessage::Stop, std::string_view());
+    for (int i = 0; i < shardCount; i++) {
+        send(i, message);
+    }
+}
+
+/**
+ * @brief Writes the sum of the latest metrics of every shard to the metrics file.
+ *
+ * @return True if the file was written, otherwise false.
+ */
+bool ShardCoordinator::writeMetrics() {
+    Metrics::Snapshot merged;
+    for (const auto& shard : shards) {
+        merged.merge(shard.metrics);
+    }
+    return Metrics::writePrometheus(metricsPath, merged);
+}
+
+void ShardCoordinator::updateMetrics() {
+    writeMetrics();
+    loop.runAfter(metricsIntervalMs, [this] { updateMetrics(); });
+}
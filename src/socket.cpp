@@ -9,12 +9,24 @@
 #include "parser.h"
 #include <netdb.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <iostream>
 #include <chrono>
 #include <cstring>
 #include <algorithm>
 #include <cerrno>
 
+const int IO_TIMEOUT_MS = 15000;
+const size_t RECEIVE_BUFFER_SIZE = 16384;
+
+// the product token matched against the user-agent lines of robots.txt, and the limit of its size (RFC 9309)
+const char* ROBOTS_PRODUCT_TOKEN = "threadr";
+const size_t MAX_ROBOTS_SIZE = 512 * 1024;
+// the largest decoded page scanned for links, whatever the maximum body size
+const size_t MAX_DECODED_BODY_SIZE = 64 << 20;
+
 /**
  * @brief Constructs a Socket object with the specified params.
  * 
@@ -22,50 +34,93 @@
  * @param port The port number to connect to.
  * @param pageLimit The maximum number of pages to discover.
  * @param crawlDelay The delay between consecutive requests in milliseconds.
+ * @param maxBodySize The maximum number of body bytes downloaded per page, or -1 for no limit.
+ * @param services The shared connection pool, resolver, metrics and robots.txt cache, any of which may be
+ *        nullptr. Without a robots.txt cache, robots.txt is neither fetched nor obeyed. With rate limits,
+ *        the crawl delay is only the initial one and then adapts to the response times of the host.
  */
-Socket::Socket(std::string hostname, int port, int pageLimit, int crawlDelay)
-    : hostname(hostname), port(port), pageLimit(pageLimit), crawlDelay(crawlDelay) {
+Socket::Socket(std::string hostname, int port, int pageLimit, int crawlDelay, long long maxBodySize, const Services& services)
+    : hostname(hostname), port(port), pageLimit(pageLimit), crawlDelay(crawlDelay), maxBodySize(maxBodySize),
+      connectionPool(services.connectionPool), resolver(services.resolver), metrics(services.metrics), robotsCache(services.robotsCache) {
+    siteStats.hostname = hostname;
     pendingPages.push("/");
-    discoveredPages["/"] = true;
-    discoveredLinkedSites.clear();
+    discoveredPages.insert(getUrlFingerprint("/"));
+    responseParser.setBodyHandler([this](const char* data, size_t length) { processBody(data, length); });
+
+    if (services.rateLimits != nullptr) {
+        rateController.reset(new RateController(crawlDelay, *services.rateLimits));
+    }
+    if (robotsCache != nullptr) {
+        std::shared_ptr<const RobotsRules> cachedRules = robotsCache->lookup(hostname);
+        if (cachedRules) applyRobots(std::move(cachedRules));
+    }
 }
 
 /**
- * @brief Establishes a connection with the web server.
+ * @brief Resolves the hostname through the shared resolver cache.
  * 
- * @return A string containing an error message if an error occurs during the connection process, or an empty string if successful.
+ * @param resolution Receives the IPv4 and IPv6 addresses of the hostname.
+ * @return A string containing an error message if the hostname cannot be resolved, or an empty string if successful.
  */
-std::string Socket::startConnection() {
-    struct hostent *host;
-    struct sockaddr_in serverAddr;
+std::string Socket::resolveHostname(Resolver::Resolution& resolution) {
+    auto startTime = std::chrono::steady_clock::now();
+    resolution = resolver != nullptr ? resolver->resolve(hostname) : Resolver::resolveUncached(hostname);
+    recordStage(Metrics::Stage::Dns, startTime);
+    if (resolution.status != 0) {
+        return " [!] Error getting DNS info for hostname: " + hostname + " (" + resolution.error + ")";
+    }
+    return "";
+}
 
-    host = gethostbyname(hostname.c_str());
-    if (host == nullptr || host->h_addr == nullptr) {
-        return " [!] Error getting DNS info for hostname: " + hostname + " (" + hstrerror(h_errno) + ")";
+/**
+ * @brief Establishes a connection with the web server, reusing an idle keep-alive connection when possible.
+ * 
+ * Every resolved address is tried in order until one accepts the connection.
+ * 
+ * @param allowReuse Whether a pooled connection may be used instead of opening a new one.
+ * @return A string containing an error message if an error occurs during the connection process, or an empty string if successful.
+ */
+std::string Socket::startConnection(bool allowReuse) {
+    reusedConnection = false;
+    if (allowReuse && connectionPool != nullptr) {
+        sock = connectionPool->acquire(hostname, port);
+        if (sock != -1) {
+            reusedConnection = true;
+            return "";
+        }
     }
 
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-        return " [!] Error: Cannot create socket: " + std::string(strerror(errno));
+    Resolver::Resolution resolution;
+    std::string resolveError = resolveHostname(resolution);
+    if (!resolveError.empty()) {
+        return resolveError;
     }
 
-    bzero(&serverAddr, sizeof(serverAddr));
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(port);
-    serverAddr.sin_addr = *((struct in_addr *)host->h_addr);
-    bzero(&(serverAddr.sin_zero), 8);
+    auto connectStartTime = std::chrono::steady_clock::now();
+    std::string connectionError;
+    for (auto& address : resolution.addresses) {
+        Resolver::setPort(address, port);
+
+        if ((sock = socket(address.storage.ss_family, SOCK_STREAM, 0)) == -1) {
+            connectionError = " [!] Error: Cannot create socket: " + std::string(strerror(errno));
+            continue;
+        }
 
-    struct timeval timeout;
-    timeout.tv_sec = 15;  // 15 seconds timeout
-    timeout.tv_usec = 0;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        struct timeval timeout;
+        timeout.tv_sec = IO_TIMEOUT_MS / 1000;
+        timeout.tv_usec = 0;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
 
-    if (connect(sock, (struct sockaddr *)&serverAddr, sizeof(struct sockaddr)) == -1) {
+        if (connect(sock, (struct sockaddr *)&address.storage, address.length) == 0) {
+            recordStage(Metrics::Stage::Connect, connectStartTime);
+            return "";
+        }
+        connectionError = " [!] Error: Cannot connect to server: " + std::string(strerror(errno));
         close(sock);
-        return " [!] Error: Cannot connect to server: " + std::string(strerror(errno));
     }
 
-    return "";
+    return connectionError;
 }
 
 /**
@@ -81,6 +136,17 @@ std::string Socket::closeConnection() {
     return "";
 }
 
+/**
+ * @brief Hands the connection back to the pool if the last response allows keep-alive, closes it otherwise.
+ */
+void Socket::releaseConnection() {
+    if (connectionPool != nullptr && responseParser.isKeepAlive()) {
+        connectionPool->release(hostname, port, sock);
+    } else {
+        closeConnection();
+    }
+}
+
 /**
  * @brief Creates an HTTP request message.
  * 
@@ -92,31 +158,55 @@ std::string Socket::createHttpRequest(std::string host, std::string path) {
     std::string request = "";
     request += "GET " + path + " HTTP/1.1\r\n";
     request += "Host: " + host + "\r\n";
-    request += "Connection: close\r\n\r\n";
+    request += std::string("User-Agent: ") + ROBOTS_PRODUCT_TOKEN + "\r\n"; // the name robots.txt rules are matched against
+    request += "Accept-Encoding: gzip, deflate\r\n";
+    request += connectionPool != nullptr ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
     
     return request;
 }
 
 /**
- * @brief Initiates the discovery process by sending HTTP requests and extracting URLs from the responses.
- * 
- * It iteratively discovers pages until the page limit is reached or there are no more pending pages.
+ * @brief Checks if the site has pages left to crawl within the page limit.
  * 
- * @return SiteStats structure containing statistics about the discovered pages and linked sites.
+ * @return True if another page can be crawled, otherwise false.
  */
-Socket::SiteStats Socket::initiateDiscovery() {
-    Socket::SiteStats stats;
-    stats.hostname = hostname;
+bool Socket::hasPendingPages() const {
+    return needsRobots() || (!pendingPages.empty() && (pageLimit == -1 || requestedPages < pageLimit));
+}
 
-    while (!pendingPages.empty() && (pageLimit == -1 || static_cast<int>(stats.discoveredPages.size()) < pageLimit)) {
-        std::string path = pendingPages.front();
-        pendingPages.pop();
-        
-        handlePageCrawl(path, stats);
+/**
+ * @brief Crawls the next pending page, blocking until it has been fetched and processed.
+ * 
+ * The crawl delay between two pages is not applied here: the caller decides when the next page of the
+ * site may be fetched, so the calling thread can serve other hosts in the meantime. The first call
+ * fetches robots.txt instead of a page, unless the rules of the host are cached.
+ */
+void Socket::crawlNextPage() {
+    if (needsRobots()) {
+        fetchingRobots = true;
+        if (metrics != nullptr) metrics->add(Metrics::Counter::Requests);
+        handlePageCrawl("/robots.txt", siteStats);
+        if (fetchingRobots) finishRobots(0); // not received
+        return;
     }
 
-    computeStats(stats);
-    return stats;
+    std::string path = pendingPages.front();
+    pendingPages.pop();
+    requestedPages++;
+    if (metrics != nullptr) metrics->add(Metrics::Counter::Requests);
+
+    handlePageCrawl(path, siteStats);
+}
+
+/**
+ * @brief Completes the discovery process once no page is left to crawl.
+ * 
+ * @return SiteStats structure containing statistics about the discovered pages and linked sites.
+ */
+Socket::SiteStats Socket::finishDiscovery() {
+    if (connectionPool != nullptr) connectionPool->discard(hostname, port); // the host is not visited again
+    computeStats(siteStats);
+    return siteStats;
 }
 
 /**
@@ -126,33 +216,38 @@ Socket::SiteStats Socket::initiateDiscovery() {
  * @param stats The SiteStats object to update with the crawl results.
  */
 void Socket::handlePageCrawl(const std::string& path, Socket::SiteStats& stats) {
-    std::cout << "Crawling " << hostname << " with path " << path << std::endl;
-
-    if (path != "/") {
-        usleep(crawlDelay * 1000);
-    }
-
     auto startTime = std::chrono::high_resolution_clock::now();
 
-    std::string connectionError = startConnection();
-    if (!connectionError.empty()) {
-        std::cerr << connectionError << std::endl;
-        stats.failedQueries++;
-        return;
-    }
-
     std::string sendData = createHttpRequest(hostname, path);
-    if (!sendRequest(sendData, stats)) {
-        return;
-    }
+    size_t responseBytes = 0;
+    double responseTime = -1;
 
-    std::string httpResponse;
-    double responseTime = receiveResponse(httpResponse, startTime);
-    closeConnection();
+    // a pooled connection may have been closed by the server while idle, so retry once on a fresh one
+    for (int attempt = 0; attempt < 2; attempt++) {
+        std::string connectionError = startConnection(attempt == 0);
+        if (!connectionError.empty()) {
+            std::cerr << connectionError << std::endl;
+            countFailedQuery(stats);
+            if (rateController) rateController->onOverload();
+            return;
+        }
 
-    stats.discoveredPages.push_back(std::make_pair(hostname + path, responseTime));
+        bool canRetry = reusedConnection;
+        if (!sendRequest(sendData, stats, !canRetry)) {
+            if (canRetry) continue;
+            return;
+        }
+
+        responseTime = receiveResponse(responseBytes, startTime);
+        if (responseBytes == 0 && canRetry) {
+            closeConnection();
+            continue;
+        }
+        break;
+    }
+    releaseConnection();
 
-    processResponse(httpResponse, stats);
+    finishResponse(path, responseTime, stats);
 }
 
 /**
@@ -160,33 +255,40 @@ void Socket::handlePageCrawl(const std::string& path, Socket::SiteStats& stats)
  * 
  * @param request The HTTP request message to send.
  * @param stats The SiteStats object to update in case of failure.
+ * @param countFailure Whether a failure should be reported and counted, false when the request will be retried.
  * @return True if the request was sent successfully, false otherwise.
  */
-bool Socket::sendRequest(const std::string& request, Socket::SiteStats& stats) {
-    if (send(sock, request.c_str(), request.size(), 0) < 0) {
-        std::cerr << "Send failed: " << strerror(errno) << std::endl;
-        stats.failedQueries++;
+bool Socket::sendRequest(const std::string& request, Socket::SiteStats& stats, bool countFailure) {
+    if (send(sock, request.c_str(), request.size(), MSG_NOSIGNAL) < 0) {
+        if (countFailure) {
+            std::cerr << "Send failed: " << strerror(errno) << std::endl;
+            countFailedQuery(stats);
+        }
         closeConnection();
         return false;
     }
+    requestSentTime = std::chrono::steady_clock::now();
     return true;
 }
 
 /**
- * @brief Receives an HTTP response in chuncks.
+ * @brief Receives an HTTP response in chuncks, until the message is complete, the transfer is aborted or
+ *        the peer closes the connection.
+ * 
+ * The body is scanned for links as soon as it is received, so the response is never buffered.
  * 
- * @param response The string to store the received response.
+ * @param receivedBytes Receives the number of bytes of the response.
  * @param startTime The start time of the request to compute response time.
  * @return The response time in milliseconds.
  */
-double Socket::receiveResponse(std::string& response, const std::chrono::high_resolution_clock::time_point& startTime) {
-    char receivedDataBuffer[4080];
+double Socket::receiveResponse(size_t& receivedBytes, const std::chrono::high_resolution_clock::time_point& startTime) {
+    char receivedDataBuffer[RECEIVE_BUFFER_SIZE];
     double responseTime = -1;
-    int totalBytesRead = 0;
 
-    while (true) {
-        bzero(receivedDataBuffer, sizeof(receivedDataBuffer));
-        int bytesRead = recv(sock, receivedDataBuffer, sizeof(receivedDataBuffer), 0);
+    receivedBytes = 0;
+    startResponse();
+    while (!responseParser.isComplete() && !responseParser.hasError() && !responseAborted) {
+        ssize_t bytesRead = recv(sock, receivedDataBuffer, sizeof(receivedDataBuffer), 0);
 
         if (responseTime < -0.5) {
             auto endTime = std::chrono::high_resolution_clock::now();
@@ -194,9 +296,10 @@ double Socket::receiveResponse(std::string& response, const std::chrono::high_re
         }
 
         if (bytesRead > 0) {
-            response.append(receivedDataBuffer, bytesRead);
-            totalBytesRead += bytesRead;
+            receivedBytes += bytesRead;
+            feedResponse(receivedDataBuffer, bytesRead);
         } else if (bytesRead == 0) {
+            responseParser.finish();
             break;  // connection closed by peer
         } else {
             std::cerr << "Receive failed: " << strerror(errno) << std::endl;
@@ -208,26 +311,198 @@ double Socket::receiveResponse(std::string& response, const std::chrono::high_re
 }
 
 /**
- * @brief Processes the HTTP response to extract URLs and update stats.
+ * @brief Prepares the response parser and the link extractor for a new response.
+ */
+void Socket::startResponse() {
+    responseParser.reset();
+    linkExtractor.reset(hostname);
+    bodyBytes = 0;
+    responseAborted = false;
+    Inflater::release(std::move(inflater));
+    parseTime = std::chrono::steady_clock::duration::zero();
+    receivedFirstByte = false;
+}
+
+/**
+ * @brief Feeds received bytes to the response parser, recording the time to first byte and the time spent
+ *        parsing the response and extracting its links.
+ * 
+ * @param data The received bytes.
+ * @param length The number of received bytes.
+ */
+void Socket::feedResponse(const char* data, size_t length) {
+    auto startTime = std::chrono::steady_clock::now();
+    if (!receivedFirstByte) {
+        receivedFirstByte = true;
+        firstByteTime = startTime;
+        if (metrics != nullptr) metrics->record(Metrics::Stage::FirstByte, firstByteTime - requestSentTime);
+    }
+    if (metrics != nullptr) metrics->add(Metrics::Counter::ReceivedBytes, length);
+
+    responseParser.feed(data, length);
+    parseTime += std::chrono::steady_clock::now() - startTime;
+}
+
+/**
+ * @brief Handles the next chunk of the response body (without chunk framing), invoked by the response parser.
+ * 
+ * The body of a successful response is decoded if it is gzip or deflate compressed, then handed on. The
+ * transfer is aborted as soon as the body turns out not to be HTML, is in an unsupported encoding or
+ * exceeds the maximum body size (counted in received, compressed bytes), while the bodies of redirects
+ * and errors are only drained so the connection can be reused.
+ * 
+ * @param data The body bytes.
+ * @param length The number of body bytes.
+ */
+void Socket::processBody(const char* data, size_t length) {
+    if (responseAborted) {
+        return;
+    }
+
+    int statusCode = responseParser.getStatusCode();
+    bool isPage = statusCode >= 200 && statusCode < 300;
+    if (fetchingRobots && !isPage) {
+        return;
+    }
+    if (isPage && !fetchingRobots && !responseParser.isHtml()) {
+        responseAborted = true;
+        return;
+    }
+
+    bool reachedLimit = maxBodySize >= 0 && !fetchingRobots && bodyBytes + static_cast<long long>(length) > maxBodySize;
+    if (reachedLimit) {
+        length = static_cast<size_t>(maxBodySize - bodyBytes);
+    }
+    bool isFirstChunk = bodyBytes == 0;
+    bodyBytes += length;
+    if (!isPage) {
+        responseAborted = reachedLimit;
+        return;
+    }
+
+    if (isFirstChunk) {
+        Inflater::Encoding encoding = Inflater::parseEncoding(responseParser.getContentEncoding());
+        if (encoding != Inflater::Encoding::Identity) {
+            inflater = encoding == Inflater::Encoding::Unsupported ? nullptr : Inflater::acquire(encoding);
+            if (!inflater) {
+                responseAborted = true;
+                return;
+            }
+        }
+    }
+
+    if (!inflater) {
+        consumeBody(data, length);
+    } else if (!inflater->feed(data, length, [this](const char* decoded, size_t decodedLength) { consumeBody(decoded, decodedLength); })) {
+        responseAborted = true; // corrupt, the links found so far are kept
+    }
+    responseAborted = responseAborted || reachedLimit;
+}
+
+/**
+ * @brief Handles the next chunk of the decoded body of a successful response: the links of a page are
+ *        extracted and queued right away, robots.txt is kept for parsing.
+ * 
+ * @param data The decoded bytes.
+ * @param length The number of decoded bytes.
+ */
+void Socket::consumeBody(const char* data, size_t length) {
+    if (responseAborted) {
+        return;
+    }
+
+    if (fetchingRobots) {
+        robotsBody.append(data, std::min(length, MAX_ROBOTS_SIZE - robotsBody.size()));
+        responseAborted = robotsBody.size() == MAX_ROBOTS_SIZE; // the rules past the limit are ignored
+        return;
+    }
+
+    if (inflater && inflater->getOutputBytes() > MAX_DECODED_BODY_SIZE) {
+        responseAborted = true; // a compression bomb is not scanned to the end
+        return;
+    }
+    linkExtractor.feed(data, length, extractedLinks);
+    enqueueLinks(siteStats);
+}
+
+/**
+ * @brief Records the outcome of a page once its response has been received.
+ * 
+ * Only successful HTML pages count as discovered pages. A redirect queues its target (a page of this
+ * site or a linked site), other statuses and transfer errors count as failed queries and non-HTML
+ * bodies are skipped.
+ * 
+ * @param path The path of the page.
+ * @param responseTime The response time in milliseconds.
+ * @param stats The SiteStats object to update.
+ */
+void Socket::finishResponse(const std::string& path, double responseTime, Socket::SiteStats& stats) {
+    Inflater::release(std::move(inflater));
+    int statusCode = responseParser.hasHeaders() ? responseParser.getStatusCode() : 0;
+    if (metrics != nullptr && receivedFirstByte) {
+        recordStage(Metrics::Stage::Download, firstByteTime);
+        metrics->record(Metrics::Stage::Parse, parseTime);
+    }
+
+    if (rateController) {
+        if (statusCode == 0 || statusCode == 429 || statusCode == 503) {
+            rateController->onOverload(responseParser.getRetryAfter());
+        } else if (receivedFirstByte) {
+            // the time to the first byte reflects the server load, the download time the body size
+            rateController->onResponse(std::chrono::duration<double, std::milli>(firstByteTime - requestSentTime).count());
+        }
+    }
+
+    if (fetchingRobots) {
+        finishRobots(statusCode);
+        return;
+    }
+
+    if (statusCode >= 200 && statusCode < 300) {
+        if (!responseParser.isHtml()) {
+            return;
+        }
+        stats.discoveredPages.push_back(std::make_pair(hostname + path, responseTime));
+        if (metrics != nullptr) metrics->add(Metrics::Counter::Pages);
+        if (!responseAborted) {
+            linkExtractor.finish(extractedLinks); // a truncated body would end with a truncated link
+            enqueueLinks(stats);
+        }
+    } else if (statusCode >= 300 && statusCode < 400 && !responseParser.getLocation().empty()) {
+        LinkExtractor::Link target;
+        if (linkExtractor.resolve(responseParser.getLocation(), target)) {
+            if (target.host == hostname && target.path != path && getUrlFingerprint(target.path) == getUrlFingerprint(path)) {
+                queuePage(std::string(target.path)); // e.g. "/docs" to "/docs/", which share a fingerprint
+            } else {
+                extractedLinks.push_back(target);
+                enqueueLinks(stats);
+            }
+        }
+    } else if (statusCode != 304) {
+        std::cerr << " [!] Error: " << hostname << path << " failed with "
+                  << (statusCode == 0 ? std::string("an invalid response") : "status " + std::to_string(statusCode)) << std::endl;
+        countFailedQuery(stats);
+    }
+}
+
+/**
+ * @brief Queues the new pages of this site and records the new linked sites among the extracted URLs.
  * 
- * @param response The HTTP response received from the server.
  * @param stats The SiteStats object to update with the extracted URLs.
  */
-void Socket::processResponse(const std::string& response, Socket::SiteStats& stats) {
-    std::vector<std::pair<std::string, std::string>> extractedUrls = extractUrls(response, hostname);
-    for (const auto& url : extractedUrls) {
-        if (url.first.empty() || url.first == hostname) {
-            if (!discoveredPages[url.second]) {
-                pendingPages.push(url.second);
-                discoveredPages[url.second] = true;
+void Socket::enqueueLinks(Socket::SiteStats& stats) {
+    for (const auto& url : extractedLinks) {
+        if (url.host.empty() || url.host == hostname) {
+            if (discoveredPages.insert(getUrlFingerprint(url.path))) {
+                queuePage(std::string(url.path));
             }
         } else {
-            if (!discoveredLinkedSites[url.first]) {
-                discoveredLinkedSites[url.first] = true;
-                stats.linkedSites.push_back(url.first);
+            if (discoveredLinkedSites.insert(getUrlFingerprint(url.host))) {
+                stats.linkedSites.push_back(std::string(url.host));
             }
         }
     }
+    extractedLinks.clear();
 }
 
 /**
@@ -258,3 +533,451 @@ void Socket::computeStats(Socket::SiteStats& stats) {
         ? totalResponseTime / static_cast<double>(stats.discoveredPages.size()) 
         : -1;
 }
+
+/**
+ * @brief Records the duration of a stage of the current request, if metrics are collected.
+ * 
+ * @param stage The stage.
+ * @param startTime The start time of the stage.
+ */
+void Socket::recordStage(Metrics::Stage stage, std::chrono::steady_clock::time_point startTime) {
+    if (metrics != nullptr) {
+        metrics->record(stage, std::chrono::steady_clock::now() - startTime);
+    }
+}
+
+/**
+ * @brief Counts a failed query in the site statistics and the metrics.
+ * 
+ * A failed robots.txt fetch is not a failed query of the site: its pages are tried anyway.
+ * 
+ * @param stats The SiteStats object to update.
+ */
+void Socket::countFailedQuery(Socket::SiteStats& stats) {
+    if (fetchingRobots) {
+        return;
+    }
+    stats.failedQueries++;
+    if (metrics != nullptr) metrics->add(Metrics::Counter::FailedQueries);
+}
+
+/**
+ * @brief Compiles the rules of the robots.txt response, caches them and applies them.
+ * 
+ * A missing robots.txt (4xx) allows everything, an unavailable one (5xx) disallows everything. When the
+ * fetch failed or the response is invalid, the pages are tried anyway and the rules are not cached.
+ * 
+ * @param statusCode The status code of the response, 0 if no valid response was received.
+ */
+void Socket::finishRobots(int statusCode) {
+    fetchingRobots = false;
+    std::shared_ptr<const RobotsRules> rules;
+    if (statusCode >= 200 && statusCode < 300) {
+        rules = std::make_shared<const RobotsRules>(RobotsRules::parse(robotsBody, ROBOTS_PRODUCT_TOKEN));
+    } else if (statusCode >= 500) {
+        rules = RobotsRules::getDisallowAll();
+    } else {
+        rules = RobotsRules::getAllowAll(); // redirects are not followed
+    }
+    robotsBody = std::string();
+
+    if (statusCode != 0) {
+        robotsCache->insert(hostname, rules);
+    }
+    applyRobots(std::move(rules));
+}
+
+/**
+ * @brief Uses the robots.txt rules of the host: drops the pending pages they disallow and takes the
+ *        host's Crawl-delay, if any, instead of the global one.
+ * 
+ * @param rules The compiled rules.
+ */
+void Socket::applyRobots(std::shared_ptr<const RobotsRules> rules) {
+    robotsRules = std::move(rules);
+    if (robotsRules->getCrawlDelayMs() >= 0) {
+        crawlDelay = robotsRules->getCrawlDelayMs();
+        if (rateController) rateController->setMinDelay(crawlDelay); // adapted, but never below it
+    }
+
+    std::queue<std::string> pages;
+    pages.swap(pendingPages);
+    while (!pages.empty()) {
+        queuePage(std::move(pages.front()));
+        pages.pop();
+    }
+}
+
+/**
+ * @brief Queues a page of this site, unless robots.txt disallows it.
+ * 
+ * @param path The path of the page.
+ */
+void Socket::queuePage(std::string path) {
+    if (robotsRules && !robotsRules->isAllowed(path)) {
+        if (metrics != nullptr) metrics->add(Metrics::Counter::DisallowedPages);
+        return;
+    }
+    pendingPages.push(std::move(path));
+}
+
+
+/**
+ * @brief Starts the non-blocking discovery process on an event loop.
+ * 
+ * Pages are crawled one after the other like with crawlNextPage(), but every connect, send and
+ * receive is driven by readiness events, so a single loop thread can serve many sites concurrently.
+ * The Socket must stay alive until onComplete has been invoked. All methods run on the loop thread.
+ * 
+ * @param loop The event loop that drives this socket.
+ * @param onComplete Callback invoked on the loop thread with the final statistics of the site.
+ */
+void Socket::initiateDiscoveryAsync(EventLoop* loop, std::function<void(SiteStats&)> onComplete) {
+    this->loop = loop;
+    this->onComplete = std::move(onComplete);
+
+    crawlNextPageAsync();
+}
+
+/**
+ * @brief Picks the next pending page, honoring the page limit and the crawl delay.
+ */
+void Socket::crawlNextPageAsync() {
+    if (fetchingRobots) {
+        finishRobots(0); // the fetch failed before a response was received
+    }
+    if (!hasPendingPages()) {
+        if (connectionPool != nullptr) connectionPool->discard(hostname, port); // the host is not visited again
+        computeStats(siteStats);
+        onComplete(siteStats);
+        return;
+    }
+
+    if (needsRobots()) {
+        fetchingRobots = true;
+        currentPath = "/robots.txt";
+    } else {
+        currentPath = pendingPages.front();
+        pendingPages.pop();
+        requestedPages++;
+    }
+    if (metrics != nullptr) metrics->add(Metrics::Counter::Requests);
+
+    if (sentRequests++ > 0) {
+        loop->runAfter(getCrawlDelay(), [this] { startPageAsync(); });
+    } else {
+        startPageAsync();
+    }
+}
+
+/**
+ * @brief Opens the connection for the current page and prepares the request.
+ */
+void Socket::startPageAsync() {
+    pageStartTime = std::chrono::high_resolution_clock::now();
+    pendingRequest = createHttpRequest(hostname, currentPath);
+
+    connectPageAsync(true);
+}
+
+/**
+ * @brief Takes a pooled connection for the current page, or resolves the hostname to open a new one.
+ * 
+ * @param allowReuse Whether a pooled connection may be used instead of opening a new one.
+ */
+void Socket::connectPageAsync(bool allowReuse) {
+    startResponse();
+    requestOffset = 0;
+    pendingResponseBytes = 0;
+    pendingResponseTime = -1;
+
+    reusedConnection = false;
+    if (allowReuse && connectionPool != nullptr) {
+        sock = connectionPool->acquire(hostname, port);
+        if (sock != -1) {
+            if (loop->addFd(sock, EPOLLOUT, this)) {
+                reusedConnection = true;
+                asyncState = AsyncState::Connecting; // a pooled connection reports EPOLLOUT right away
+                lastActivityTime = std::chrono::steady_clock::now();
+                armTimeoutAsync(IO_TIMEOUT_MS);
+                return;
+            }
+            close(sock);
+        }
+    }
+
+    asyncState = AsyncState::Resolving;
+    stageStartTime = std::chrono::steady_clock::now();
+    Resolver::Resolution cached;
+    if (resolver == nullptr) {
+        handleResolvedAsync(Resolver::resolveUncached(hostname));
+    } else if (resolver->lookupCached(hostname, cached)) {
+        handleResolvedAsync(cached);
+    } else {
+        EventLoop* socketLoop = loop;
+        resolver->resolveAsync(hostname, [this, socketLoop](const Resolver::Resolution& resolution) {
+            socketLoop->post([this, resolution] { handleResolvedAsync(resolution); });
+        });
+    }
+}
+
+/**
+ * @brief Continues the current page once the hostname has been resolved.
+ * 
+ * @param resolution The resolution of the hostname.
+ */
+void Socket::handleResolvedAsync(const Resolver::Resolution& resolution) {
+    recordStage(Metrics::Stage::Dns, stageStartTime);
+    if (resolution.status != 0) {
+        std::cerr << " [!] Error getting DNS info for hostname: " << hostname << " (" << resolution.error << ")" << std::endl;
+        countFailedQuery(siteStats);
+        asyncState = AsyncState::Idle;
+        crawlNextPageAsync();
+        return;
+    }
+
+    resolvedAddresses = resolution.addresses;
+    nextAddress = 0;
+    stageStartTime = std::chrono::steady_clock::now();
+    connectNextAddressAsync();
+}
+
+/**
+ * @brief Starts connecting to the next resolved address that accepts a connection attempt.
+ */
+void Socket::connectNextAddressAsync() {
+    std::string connectionError = " [!] Error: Cannot connect to server: no address available";
+    while (nextAddress < resolvedAddresses.size()) {
+        connectionError = startConnectionAsync(resolvedAddresses[nextAddress++]);
+        if (connectionError.empty()) {
+            asyncState = AsyncState::Connecting;
+            lastActivityTime = std::chrono::steady_clock::now();
+            armTimeoutAsync(IO_TIMEOUT_MS);
+            return;
+        }
+    }
+
+    std::cerr << connectionError << std::endl;
+    countFailedQuery(siteStats);
+    asyncState = AsyncState::Idle;
+    crawlNextPageAsync();
+}
+
+/**
+ * @brief Creates a non-blocking socket, starts connecting and registers it with the loop.
+ * 
+ * @param address The resolved address to connect to.
+ * @return A string containing an error message if the connection cannot be started, or an empty string if successful.
+ */
+std::string Socket::startConnectionAsync(Resolver::Address address) {
+    Resolver::setPort(address, port);
+
+    if ((sock = socket(address.storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+        return " [!] Error: Cannot create socket: " + std::string(strerror(errno));
+    }
+
+    if (connect(sock, (struct sockaddr *)&address.storage, address.length) == -1 && errno != EINPROGRESS) {
+        std::string error = " [!] Error: Cannot connect to server: " + std::string(strerror(errno));
+        close(sock);
+        return error;
+    }
+
+    if (!loop->addFd(sock, EPOLLOUT, this)) {
+        std::string error = " [!] Error: Cannot register socket with the event loop: " + std::string(strerror(errno));
+        close(sock);
+        return error;
+    }
+
+    return "";
+}
+
+/**
+ * @brief Arms the inactivity timer of the current page.
+ * 
+ * The timer is not re-armed on every read; when it fires it checks the time of the last activity
+ * and only gives up once the connection has really been idle for IO_TIMEOUT_MS.
+ * 
+ * @param delayMs The delay until the next inactivity check.
+ */
+void Socket::armTimeoutAsync(int delayMs) {
+    timeoutTimer = loop->runAfter(delayMs, [this] {
+        timeoutTimer = 0;
+        auto idleTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lastActivityTime);
+        if (idleTime.count() < IO_TIMEOUT_MS) {
+            armTimeoutAsync(IO_TIMEOUT_MS - static_cast<int>(idleTime.count()));
+            return;
+        }
+
+        if (asyncState == AsyncState::Receiving) {
+            std::cerr << "Receive failed: " << strerror(ETIMEDOUT) << std::endl;
+            finishPageAsync();
+        } else {
+            failPageAsync(" [!] Error: Cannot connect to server: " + std::string(strerror(ETIMEDOUT)));
+        }
+    });
+}
+
+/**
+ * @brief Dispatches readiness events according to the state of the current page.
+ * 
+ * @param events The epoll events reported for the socket.
+ */
+void Socket::handleEvent(uint32_t events) {
+    lastActivityTime = std::chrono::steady_clock::now();
+
+    switch (asyncState) {
+        case AsyncState::Connecting:
+            handleConnectAsync(events);
+            break;
+        case AsyncState::Sending:
+            handleSendAsync();
+            break;
+        case AsyncState::Receiving:
+            handleReceiveAsync();
+            break;
+        case AsyncState::Idle:
+        case AsyncState::Resolving:
+            break;
+    }
+}
+
+/**
+ * @brief Completes the non-blocking connect and starts sending the request.
+ * 
+ * @param events The epoll events reported for the socket.
+ */
+void Socket::handleConnectAsync(uint32_t events) {
+    int socketError = 0;
+    socklen_t errorLength = sizeof(socketError);
+    if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &socketError, &errorLength) == -1) {
+        socketError = errno;
+    }
+
+    if (socketError != 0 || (events & EPOLLERR)) {
+        if (!reusedConnection && nextAddress < resolvedAddresses.size()) {
+            releaseConnectionAsync();
+            connectNextAddressAsync(); // try the next IPv4/IPv6 address of the host
+            return;
+        }
+        failPageAsync(" [!] Error: Cannot connect to server: " + std::string(strerror(socketError != 0 ? socketError : ECONNREFUSED)));
+        return;
+    }
+
+    if (!reusedConnection) {
+        recordStage(Metrics::Stage::Connect, stageStartTime);
+    }
+    asyncState = AsyncState::Sending;
+    handleSendAsync();
+}
+
+/**
+ * @brief Writes as much of the request as the socket accepts, then waits for the response.
+ */
+void Socket::handleSendAsync() {
+    while (requestOffset < pendingRequest.size()) {
+        ssize_t bytesSent = send(sock, pendingRequest.data() + requestOffset, pendingRequest.size() - requestOffset, MSG_NOSIGNAL);
+        if (bytesSent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return; // wait for the next EPOLLOUT
+            }
+            if (reusedConnection) {
+                retryPageAsync();
+                return;
+            }
+            std::cerr << "Send failed: " << strerror(errno) << std::endl;
+            countFailedQuery(siteStats);
+            releaseConnectionAsync();
+            crawlNextPageAsync();
+            return;
+        }
+        requestOffset += bytesSent;
+    }
+
+    asyncState = AsyncState::Receiving;
+    requestSentTime = std::chrono::steady_clock::now();
+    loop->modifyFd(sock, EPOLLIN | EPOLLRDHUP, this);
+}
+
+/**
+ * @brief Drains the socket, scanning the body for links, until the message is complete, the transfer is
+ *        aborted or the peer closes the connection.
+ */
+void Socket::handleReceiveAsync() {
+    char receivedDataBuffer[RECEIVE_BUFFER_SIZE];
+
+    while (true) {
+        ssize_t bytesRead = recv(sock, receivedDataBuffer, sizeof(receivedDataBuffer), 0);
+
+        if (pendingResponseTime < -0.5 && (bytesRead >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))) {
+            auto endTime = std::chrono::high_resolution_clock::now();
+            pendingResponseTime = std::chrono::duration<double, std::milli>(endTime - pageStartTime).count();
+        }
+
+        if (bytesRead > 0) {
+            pendingResponseBytes += bytesRead;
+            feedResponse(receivedDataBuffer, bytesRead);
+            if (responseParser.isComplete() || responseParser.hasError() || responseAborted) {
+                break;
+            }
+        } else if (bytesRead == 0) {
+            if (pendingResponseBytes == 0 && reusedConnection) {
+                retryPageAsync(); // the server closed the idle connection
+                return;
+            }
+            responseParser.finish();
+            break;  // connection closed by peer
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return; // wait for more data
+        } else {
+            std::cerr << "Receive failed: " << strerror(errno) << std::endl;
+            break;
+        }
+    }
+
+    finishPageAsync();
+}
+
+/**
+ * @brief Abandons the current page after a connection error and moves on to the next one.
+ * 
+ * @param error The error message to report.
+ */
+void Socket::failPageAsync(const std::string& error) {
+    std::cerr << error << std::endl;
+    countFailedQuery(siteStats);
+    if (rateController) rateController->onOverload();
+    releaseConnectionAsync();
+    crawlNextPageAsync();
+}
+
+/**
+ * @brief Retries the current page on a fresh connection after a pooled one turned out to be closed.
+ */
+void Socket::retryPageAsync() {
+    releaseConnectionAsync();
+    connectPageAsync(false);
+}
+
+/**
+ * @brief Records the current page, extracts its links and moves on to the next one.
+ */
+void Socket::finishPageAsync() {
+    releaseConnectionAsync();
+
+    finishResponse(currentPath, pendingResponseTime, siteStats);
+
+    crawlNextPageAsync();
+}
+
+/**
+ * @brief Unregisters the connection of the current page, cancels its timer and pools or closes it.
+ */
+void Socket::releaseConnectionAsync() {
+    if (timeoutTimer != 0) {
+        loop->cancelTimer(timeoutTimer);
+        timeoutTimer = 0;
+    }
+    loop->removeFd(sock);
+    releaseConnection();
+    asyncState = AsyncState::Idle;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file spill_queue.cpp
+ * @brief Implementation of the on-disk overflow of the site frontier.
+ *
+ * Sites that do not fit in the frontier's memory budget are encoded into a tail buffer, which is written
+ * as one sequential segment file once it reaches `segmentBytes`. Sites are read back a whole segment at a
+ * time, oldest first, and the tail buffer is handed out directly once no segment is left. The segment
+ * files live in a private directory that is removed with the queue.
+ */
+
+#include "spill_queue.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Encodes a site as its depth, the length of its hostname and the hostname.
+ */
+static void encodeSite(std::string& buffer, const SpillQueue::Site& site) {
+    int32_t depth = site.second;
+    uint16_t length = static_cast<uint16_t>(std::min<size_t>(site.first.size(), UINT16_MAX));
+    buffer.append(reinterpret_cast<const char*>(&depth), sizeof(depth));
+    buffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    buffer.append(site.first.data(), length);
+}
+
+static void decodeSites(const std::string& buffer, std::vector<SpillQueue::Site>& sites) {
+    size_t offset = 0;
+    while (buffer.size() - offset >= 6) {
+        int32_t depth;
+        uint16_t length;
+        std::memcpy(&depth, buffer.data() + offset, sizeof(depth));
+        std::memcpy(&length, buffer.data() + offset + 4, sizeof(length));
+        if (buffer.size() - offset - 6 < length) {
+            break;
+        }
+        sites.emplace_back(buffer.substr(offset + 6, length), depth);
+        offset += 6 + length;
+    }
+}
+
+/**
+ * @brief Constructs a SpillQueue object, which cannot be used before open() is called.
+ *
+ * @param segmentBytes The size of the segment files.
+ */
+SpillQueue::SpillQueue(size_t segmentBytes) : segmentBytes(segmentBytes), tailCount(0), nextSegment(0), count(0) {}
+
+SpillQueue::~SpillQueue() {
+    if (!directory.empty()) {
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+}
+
+/**
+ * @brief Creates the private directory holding the segment files.
+ *
+ * @param parentDirectory The directory to create it in, the system temporary directory if empty.
+ * @return True if the directory was created, otherwise false.
+ */
+bool SpillQueue::open(const std::string& parentDirectory) {
+    std::error_code error;
+    std::string parent = parentDirectory.empty() ? std::filesystem::temp_directory_path(error).string() : parentDirectory;
+    std::string pattern = parent + "/threadr-frontier-XXXXXX";
+    if (mkdtemp(&pattern[0]) == nullptr) {
+        std::cerr << " [!] Error: Unable to create the frontier spill directory in " << parent << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    directory = pattern;
+    return true;
+}
+
+/**
+ * @brief Appends a site, writing the tail buffer as a new segment once it is full.
+ *
+ * @param site The hostname of the site and its depth.
+ * @return True if the site was queued, false if the segment could not be written (the site is dropped
+ *         from the queue and must be kept by the caller).
+ */
+bool SpillQueue::push(const Site& site) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t tailSize = tail.size();
+    encodeSite(tail, site);
+    tailCount++;
+    if (tail.size() >= segmentBytes && !writeTail()) {
+        tail.resize(tailSize);
+        tailCount--;
+        return false;
+    }
+    count++;
+    return true;
+}
+
+/**
+ * @brief Takes the oldest batch of sites: the oldest segment, or the tail buffer if no segment is left.
+ *
+ * @param sites Receives the sites.
+ * @param lostSites Receives the number of sites of the batch that could not be read back.
+ * @return The number of sites taken.
+ */
+size_t SpillQueue::popBatch(std::vector<Site>& sites, size_t& lostSites) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t firstSite = sites.size();
+    size_t batchCount;
+
+    if (!segments.empty()) {
+        std::string path = std::move(segments.front().first);
+        batchCount = segments.front().second;
+        segments.pop_front();
+
+        std::string buffer;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            char chunk[65536];
+            ssize_t length;
+            while ((length = ::read(fd, chunk, sizeof(chunk))) > 0 || (length < 0 && errno == EINTR)) {
+                if (length > 0) buffer.append(chunk, static_cast<size_t>(length));
+            }
+            ::close(fd);
+        }
+        unlink(path.c_str());
+        decodeSites(buffer, sites);
+    } else {
+        batchCount = tailCount;
+        decodeSites(tail, sites);
+        tail.clear();
+        tailCount = 0;
+    }
+
+    size_t taken = sites.size() - firstSite;
+    lostSites = batchCount - std::min(taken, batchCount);
+    if (lostSites > 0) {
+        std::cerr << " [!] Error: Lost " << lostSites << " sites of the frontier spilled to disk" << std::endl;
+    }
+    count -= batchCount;
+    return taken;
+}
+
+bool SpillQueue::writeTail() {
+    std::string path = directory + "/segment-" + std::to_string(nextSegment++);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        std::cerr << " [!] Error: Unable to create the frontier segment " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    const char* data = tail.data();
+    size_t remaining = tail.size();
+    while (remaining > 0) {
+        ssize_t written = ::write(fd, data, remaining);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            std::cerr << " [!] Error: Unable to write the frontier segment " << path << ": " << std::strerror(errno) << std::endl;
+            ::close(fd);
+            unlink(path.c_str());
+            return false;
+        }
+        data += written;
+        remaining -= static_cast<size_t>(written);
+    }
+    ::close(fd);
+
+    segments.emplace_back(std::move(path), tailCount);
+    tail.clear();
+    tailCount = 0;
+    return true;
+}
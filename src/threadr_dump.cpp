@@ -0,0 +1,187 @@
+/**
+ * @file threadr_dump.cpp
+ * @brief Converts a binary results file to CSV or JSON.
+ *
+ * The file written with `--enableBinaryOutput` is mapped into memory and every site is printed, either in
+ * the format of `crawl_results.csv` or as a JSON array with one object per site, which also lists the
+ * linked sites and the response time of every page.
+ */
+
+#include "result_format.h"
+#include <argparse/argparse.hpp>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+const size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+/**
+ * @brief Formats a response time like the CSV output of the crawler.
+ *
+ * @param responseTime The response time in milliseconds, NaN if unknown.
+ * @param unknown The text written for an unknown response time.
+ * @return The formatted response time.
+ */
+std::string formatResponseTime(float responseTime, const char* unknown) {
+    return std::isnan(responseTime) ? unknown : std::to_string(responseTime);
+}
+
+/**
+ * @brief Writes a string as a quoted and escaped JSON string.
+ *
+ * @param out The output stream.
+ * @param text The string.
+ */
+void writeJsonString(std::ostream& out, std::string_view text) {
+    out << '"';
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (byte < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", byte);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+/**
+ * @brief Writes the sites of a results file in the format of `crawl_results.csv`.
+ *
+ * @param reader The opened results file.
+ * @param out The output stream.
+ */
+void writeCsv(const ResultFileReader& reader, std::ostream& out) {
+    out << "WEBSITE,DEPTH,PAGES DISCOVERED,FAILED QUERIES,LINKED SITES,MIN RESPONSE TIME (ms),MAX RESPONSE TIME (ms),AVG RESPONSE TIME (ms),DISCOVERED PAGES\n";
+    reader.forEachSite([&out](const ResultRecord& record) {
+        out << record.hostname << ",";
+        out << record.depth << ",";
+        out << record.pages.size() << ",";
+        out << record.failedQueries << ",";
+        out << record.linkedSites.size() << ",";
+        out << formatResponseTime(record.minResponseTime, "-") << ",";
+        out << formatResponseTime(record.maxResponseTime, "-") << ",";
+        out << formatResponseTime(record.averageResponseTime, "-") << ",";
+
+        if (record.pages.empty()) {
+            out << "None";
+        } else {
+            for (size_t i = 0; i < record.pages.size(); ++i) {
+                out << record.hostname << record.pages[i].first;
+                if (i != record.pages.size() - 1) {
+                    out << "; ";
+                }
+            }
+        }
+        out << "\n";
+    });
+}
+
+/**
+ * @brief Writes the sites of a results file as a JSON array.
+ *
+ * @param reader The opened results file.
+ * @param out The output stream.
+ */
+void writeJson(const ResultFileReader& reader, std::ostream& out) {
+    bool first = true;
+    out << "[";
+    reader.forEachSite([&out, &first](const ResultRecord& record) {
+        out << (first ? "\n" : ",\n") << "{\"website\":";
+        first = false;
+        writeJsonString(out, record.hostname);
+        out << ",\"depth\":" << record.depth;
+        out << ",\"failedQueries\":" << record.failedQueries;
+        out << ",\"minResponseTime\":" << formatResponseTime(record.minResponseTime, "null");
+        out << ",\"maxResponseTime\":" << formatResponseTime(record.maxResponseTime, "null");
+        out << ",\"avgResponseTime\":" << formatResponseTime(record.averageResponseTime, "null");
+
+        out << ",\"linkedSites\":[";
+        for (size_t i = 0; i < record.linkedSites.size(); i++) {
+            if (i > 0) out << ",";
+            writeJsonString(out, record.linkedSites[i]);
+        }
+
+        out << "],\"pages\":[";
+        for (size_t i = 0; i < record.pages.size(); i++) {
+            if (i > 0) out << ",";
+            out << "{\"url\":";
+            writeJsonString(out, std::string(record.hostname) + std::string(record.pages[i].first));
+            out << ",\"responseTime\":" << formatResponseTime(record.pages[i].second, "null") << "}";
+        }
+        out << "]}";
+    });
+    out << "\n]\n";
+}
+
+int main(int argc, char *argv[]) {
+    argparse::ArgumentParser program("threadr-dump");
+
+    program.add_argument("file")
+        .help("Binary results file written by threadr --enableBinaryOutput");
+
+    program.add_argument("--format", "-f")
+        .help("Output format: `csv` or `json`")
+        .default_value(std::string("csv"));
+
+    program.add_argument("--output", "-o")
+        .help("Write to this file instead of the standard output");
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::runtime_error& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
+        return 1;
+    }
+
+    std::string format = program.get<std::string>("--format");
+    if (format != "csv" && format != "json") {
+        std::cerr << " [!] Error: Unknown output format: " << format << " (expected `csv` or `json`)" << std::endl;
+        return 1;
+    }
+
+    ResultFileReader reader;
+    if (!reader.open(program.get<std::string>("file"))) {
+        return 1;
+    }
+    if (!reader.hasIndex()) {
+        std::cerr << " [!] Warning: The results file has no index (interrupted crawl?), "
+                  << reader.siteCount() << " sites were recovered" << std::endl;
+    }
+
+    std::unique_ptr<char[]> buffer(new char[OUTPUT_BUFFER_SIZE]);
+    std::ofstream outputFile;
+    std::ostream* out = &std::cout;
+    if (program.present("--output")) {
+        outputFile.rdbuf()->pubsetbuf(buffer.get(), OUTPUT_BUFFER_SIZE);
+        outputFile.open(program.get<std::string>("--output"));
+        if (!outputFile.is_open()) {
+            std::cerr << " [!] Error: Unable to open output file" << std::endl;
+            return 1;
+        }
+        out = &outputFile;
+    } else {
+        std::ios::sync_with_stdio(false);
+        std::cout.rdbuf()->pubsetbuf(buffer.get(), OUTPUT_BUFFER_SIZE);
+    }
+
+    if (format == "csv") {
+        writeCsv(reader, *out);
+    } else {
+        writeJson(reader, *out);
+    }
+
+    out->flush();
+    if (!*out) {
+        std::cerr << " [!] Error: Failed to write the output" << std::endl;
+        return 1;
+    }
+    return 0;
+}
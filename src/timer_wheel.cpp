@@ -0,0 +1,147 @@
+/**
+ * @file timer_wheel.cpp
+ * @brief Implementation of a hierarchical timer wheel with millisecond ticks.
+ * 
+ * Four levels of 256 slots cover delays of up to ~49 days. A timer is stored in the lowest level whose
+ * range covers its remaining delay, and is moved down one level (cascaded) whenever the level below wraps
+ * around, so scheduling, cancelling and expiring timers are all O(1) regardless of how many hosts are
+ * waiting for their next allowed fetch.
+ */
+
+#include "timer_wheel.h"
+#include <algorithm>
+
+TimerWheel::TimerWheel() : origin(Clock::now()), currentTick(0), nextTimerId(1) {}
+
+/**
+ * @brief Schedules a task to be returned by advance() once the delay has passed.
+ * 
+ * @param delayMs The delay in milliseconds.
+ * @param task The task to run.
+ * @return An identifier that can be passed to cancel.
+ */
+uint64_t TimerWheel::schedule(int delayMs, Task task) {
+    uint64_t timerId = nextTimerId++;
+    uint64_t expiryTick = toTick(Clock::now()) + std::max(delayMs, 0);
+
+    // the current tick has already been processed, so the earliest a timer can fire is the next one
+    place(Timer{timerId, std::max(expiryTick, currentTick + 1), std::move(task)});
+    pendingIds.insert(timerId);
+    return timerId;
+}
+
+/**
+ * @brief Cancels a timer that has not expired yet. The slot entry is dropped lazily when reached.
+ * 
+ * @param timerId The identifier returned by schedule.
+ */
+void TimerWheel::cancel(uint64_t timerId) {
+    pendingIds.erase(timerId);
+}
+
+/**
+ * @brief Advances the wheel up to the given time and collects every expired task.
+ * 
+ * @param now The current time.
+ * @param expired Receives the tasks of the expired timers, in expiry order.
+ */
+void TimerWheel::advance(Clock::time_point now, std::vector<Task>& expired) {
+    uint64_t targetTick = toTick(now);
+    if (pendingIds.empty()) {
+        currentTick = std::max(currentTick, targetTick);
+        return;
+    }
+
+    while (currentTick < targetTick) {
+        currentTick++;
+
+        // when a level wraps around, the next slot of the level above is redistributed below,
+        // starting from the highest wrapping level so its timers can keep falling through
+        int wrappedLevels = 0;
+        while (wrappedLevels < LEVELS - 1 && (currentTick & ((1ULL << (SLOT_BITS * (wrappedLevels + 1))) - 1)) == 0) {
+            wrappedLevels++;
+        }
+        for (int level = wrappedLevels; level >= 1; level--) {
+            cascade(level);
+        }
+
+        std::vector<Timer> due;
+        due.swap(slots[0][currentTick & (SLOTS - 1)]);
+        for (auto& timer : due) {
+            if (pendingIds.erase(timer.id) > 0) {
+                expired.push_back(std::move(timer.task));
+            }
+        }
+
+        if (pendingIds.empty()) {
+            currentTick = targetTick;
+        }
+    }
+}
+
+/**
+ * @brief Computes how long a caller may sleep before the next timer could expire.
+ * 
+ * @param now The current time.
+ * @return The timeout in milliseconds, or -1 if no timer is pending.
+ */
+int TimerWheel::nextTimeoutMs(Clock::time_point now) const {
+    if (pendingIds.empty()) {
+        return -1;
+    }
+
+    uint64_t nowTick = toTick(now);
+    uint64_t nextTick = (currentTick | (SLOTS - 1)) + 1; // the next cascade of level 1
+    for (uint64_t tick = currentTick + 1; tick < nextTick; tick++) {
+        if (!slots[0][tick & (SLOTS - 1)].empty()) {
+            nextTick = tick;
+            break;
+        }
+    }
+
+    return nextTick > nowTick ? static_cast<int>(nextTick - nowTick) : 0;
+}
+
+uint64_t TimerWheel::toTick(Clock::time_point time) const {
+    if (time <= origin) {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time - origin).count();
+}
+
+/**
+ * @brief Stores a timer in the slot of the lowest level whose range covers its remaining delay.
+ * 
+ * @param timer The timer to store.
+ */
+void TimerWheel::place(Timer timer) {
+    uint64_t delta = timer.expiryTick - currentTick;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+
+    if (level == LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * LEVELS))) {
+        timer.expiryTick = currentTick + (1ULL << (SLOT_BITS * LEVELS)) - 1; // clamp to the wheel's range
+    }
+
+    size_t slot = (timer.expiryTick >> (SLOT_BITS * level)) & (SLOTS - 1);
+    slots[level][slot].push_back(std::move(timer));
+}
+
+/**
+ * @brief Moves the timers of the current slot of a level down to the lower levels.
+ * 
+ * @param level The level to cascade.
+ */
+void TimerWheel::cascade(int level) {
+    size_t slot = (currentTick >> (SLOT_BITS * level)) & (SLOTS - 1);
+    std::vector<Timer> timers;
+    timers.swap(slots[level][slot]);
+
+    for (auto& timer : timers) {
+        if (pendingIds.count(timer.id) > 0) {
+            place(std::move(timer));
+        }
+    }
+}
@@ -1,5 +1,85 @@
+/**
+ * @file test.cpp
+ * @brief Runner of the unit tests of the parsers, data structures and file formats of the crawler.
+ *
+ * Every test file registers its tests with TEST(suite, name). The runner executes the suites given as
+ * arguments (every suite if there is none), reports each failed check and exits with 1 if any failed,
+ * so CTest can run one suite per test.
+ */
+
+#include "test.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <iostream>
+#include <vector>
+#include <unistd.h>
+
+struct RegisteredTest {
+    const char* suite;
+    const char* name;
+    void (*run)();
+};
+
+static std::vector<RegisteredTest>& getTests() {
+    static std::vector<RegisteredTest> tests;
+    return tests;
+}
+
+static int failureCount = 0;
+
+int registerTest(const char* suite, const char* name, void (*run)()) {
+    getTests().push_back(RegisteredTest{suite, name, run});
+    return 0;
+}
+
+void reportFailure(const char* file, int line, const std::string& message) {
+    std::cerr << " [!] Error: " << file << ":" << line << ": check failed: " << message << std::endl;
+    failureCount++;
+}
+
+/**
+ * @brief Returns a path for a temporary file of a test, unique to this process.
+ *
+ * @param name The name of the file.
+ * @return The path, in the temporary directory.
+ */
+std::string makeTempPath(const char* name) {
+    const char* directory = getenv("TMPDIR");
+    return std::string(directory != nullptr && *directory != '\0' ? directory : "/tmp") + "/threadr-test-" + std::to_string(getpid()) + "-" + name;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), static_cast<std::streamsize>(content.size()));
+}
+
+int main(int argc, char* argv[]) {
+    int testCount = 0;
+    for (const auto& test : getTests()) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; i++) {
+            selected = strcmp(argv[i], test.suite) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+
+        int previousFailures = failureCount;
+        test.run();
+        testCount++;
+        std::cout << (failureCount == previousFailures ? " [*] " : " [!] ") << test.suite << "." << test.name << std::endl;
+    }
 
-int main() {
-    std::cout << "Hello from Threadr test!.\n";
+    if (testCount == 0) {
+        std::cerr << " [!] Error: No test selected" << std::endl;
+        return 1;
+    }
+    std::cout << " [*] " << testCount << " tests, " << failureCount << " failed checks" << std::endl;
+    return failureCount == 0 ? 0 : 1;
 }
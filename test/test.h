@@ -0,0 +1,37 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <sstream>
+#include <string>
+
+// Minimal test harness: TEST(suite, name) registers a test, CHECK and CHECK_EQ record failures without
+// stopping the test. The runner executes the suites named on its command line, or all of them.
+
+int registerTest(const char* suite, const char* name, void (*run)());
+void reportFailure(const char* file, int line, const std::string& message);
+std::string makeTempPath(const char* name);
+std::string readFile(const std::string& path);
+void writeFile(const std::string& path, const std::string& content);
+
+#define TEST(suite, name)                                                                      \
+    static void suite##_##name();                                                              \
+    static const int suite##_##name##_registered = registerTest(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(condition)                                          \
+    do {                                                          \
+        if (!(condition)) reportFailure(__FILE__, __LINE__, #condition); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                    \
+    do {                                                                                              \
+        auto&& actualValue = (actual);                                                                \
+        auto&& expectedValue = (expected);                                                            \
+        if (!(actualValue == expectedValue)) {                                                        \
+            std::ostringstream message;                                                               \
+            message << #actual << " == " << #expected << " (" << actualValue << " vs " << expectedValue << ")"; \
+            reportFailure(__FILE__, __LINE__, message.str());                                         \
+        }                                                                                             \
+    } while (0)
+
+#endif // TEST_H
@@ -0,0 +1,57 @@
+#include "test.h"
+#include "checkpoint.h"
+#include "fingerprint.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+TEST(checkpoint, replay) {
+    std::string path = makeTempPath("checkpoint.log");
+    Checkpoint::State state;
+    state.pendingSites.emplace_back("resumed.example.com", 3);
+    {
+        Checkpoint checkpoint(1);
+        CHECK(checkpoint.open(path, state));
+        checkpoint.recordDiscovered("a.example.com", 1);
+        checkpoint.recordDiscovered("b.example.com", 0);
+        checkpoint.recordDiscovered("c.example.com", 2);
+        checkpoint.recordCompleted("a.example.com");
+        checkpoint.recordCompleted("resumed.example.com");
+        checkpoint.stop();
+    }
+
+    Checkpoint::State loaded;
+    CHECK(Checkpoint::load(path, loaded));
+    std::vector<Checkpoint::Site> expected = {{"b.example.com", 0}, {"c.example.com", 2}};
+    CHECK(loaded.pendingSites == expected);
+    CHECK_EQ(loaded.completedSites.size(), 2u);
+    CHECK(std::find(loaded.completedSites.begin(), loaded.completedSites.end(), getUrlFingerprint("a.example.com"))
+          != loaded.completedSites.end());
+
+    // a torn tail: a discovered record cut in its hostname, then a completed record cut in its fingerprint
+    std::string log = readFile(path);
+    std::string torn = log;
+    uint64_t fingerprint = getUrlFingerprint("d.example.com");
+    int32_t depth = 1;
+    uint16_t length = 13;
+    torn.push_back('D');
+    torn.append(reinterpret_cast<const char*>(&fingerprint), sizeof(fingerprint));
+    torn.append(reinterpret_cast<const char*>(&depth), sizeof(depth));
+    torn.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    torn.append("d.exam");
+    writeFile(path, torn);
+    CHECK(Checkpoint::load(path, loaded));
+    CHECK(loaded.pendingSites == expected);
+
+    torn = log + "C" + std::string(reinterpret_cast<const char*>(&fingerprint), 4);
+    writeFile(path, torn);
+    CHECK(Checkpoint::load(path, loaded));
+    CHECK(loaded.pendingSites == expected);
+    CHECK_EQ(loaded.completedSites.size(), 2u);
+
+    writeFile(path, "not a checkpoint");
+    CHECK(!Checkpoint::load(path, loaded));
+    std::remove(path.c_str());
+    CHECK(!Checkpoint::load(path, loaded));
+}
@@ -0,0 +1,113 @@
+#include "test.h"
+#include "connection_pool.h"
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+// a connected socket for the pool; the peer end stays open so the pooled end reads as alive
+static int openConnection(std::vector<int>& peers) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) return -1;
+    peers.push_back(fds[1]);
+    return fds[0];
+}
+
+static bool isOpen(int fd) {
+    return fcntl(fd, F_GETFD) != -1;
+}
+
+static void closeAll(const std::vector<int>& fds) {
+    for (int fd : fds) close(fd);
+}
+
+TEST(connectionPool, reusesPerHost) {
+    std::vector<int> peers;
+    {
+        ConnectionPool pool(2, 30000, 16);
+        int first = openConnection(peers);
+        int second = openConnection(peers);
+        int third = openConnection(peers);
+        pool.release("a.example.com", 80, first);
+        pool.release("a.example.com", 80, second);
+        pool.release("a.example.com", 80, third); // over the per-host limit
+        CHECK(!isOpen(third));
+
+        CHECK_EQ(pool.acquire("a.example.com", 443), -1);
+        CHECK_EQ(pool.acquire("b.example.com", 80), -1);
+        CHECK_EQ(pool.acquire("a.example.com", 80), second); // most recent first
+        CHECK_EQ(pool.acquire("a.example.com", 80), first);
+        CHECK_EQ(pool.acquire("a.example.com", 80), -1);
+        close(first);
+        close(second);
+    }
+    closeAll(peers);
+}
+
+TEST(connectionPool, evictsLeastRecentlyUsed) {
+    std::vector<int> peers;
+    {
+        ConnectionPool pool(4, 30000, 3);
+        int a = openConnection(peers);
+        int b = openConnection(peers);
+        int c = openConnection(peers);
+        pool.release("a.example.com", 80, a);
+        pool.release("b.example.com", 80, b);
+        pool.release("c.example.com", 80, c);
+        int d = openConnection(peers);
+        pool.release("d.example.com", 80, d); // over the global limit, the connection to a goes
+        CHECK(!isOpen(a));
+        CHECK_EQ(pool.acquire("a.example.com", 80), -1);
+        CHECK_EQ(pool.acquire("b.example.com", 80), b);
+        CHECK_EQ(pool.acquire("d.example.com", 80), d);
+        close(b);
+        close(d);
+    }
+    closeAll(peers);
+}
+
+TEST(connectionPool, sweepsExpired) {
+    std::vector<int> peers;
+    {
+        ConnectionPool pool(4, 20, 16);
+        int a = openConnection(peers);
+        pool.release("a.example.com", 80, a);
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        int b = openConnection(peers);
+        pool.release("b.example.com", 80, b); // releasing any host closes the expired connections
+        CHECK(!isOpen(a));
+        CHECK_EQ(pool.acquire("b.example.com", 80), b);
+        close(b);
+    }
+    closeAll(peers);
+}
+
+TEST(connectionPool, discardsFinishedHost) {
+    std::vector<int> peers;
+    {
+        ConnectionPool pool(4, 30000, 16);
+        int a = openConnection(peers);
+        int b = openConnection(peers);
+        int c = openConnection(peers);
+        pool.release("a.example.com", 80, a);
+        pool.release("a.example.com", 80, b);
+        pool.release("b.example.com", 80, c);
+        pool.discard("a.example.com", 80);
+        CHECK(!isOpen(a));
+        CHECK(!isOpen(b));
+        CHECK_EQ(pool.acquire("a.example.com", 80), -1);
+        CHECK_EQ(pool.acquire("b.example.com", 80), c);
+        close(c);
+    }
+    closeAll(peers);
+}
+
+TEST(connectionPool, dropsClosedByServer) {
+    std::vector<int> peers;
+    ConnectionPool pool(4, 30000, 16);
+    int a = openConnection(peers);
+    pool.release("a.example.com", 80, a);
+    close(peers.back());
+    CHECK_EQ(pool.acquire("a.example.com", 80), -1);
+}
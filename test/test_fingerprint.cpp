@@ -0,0 +1,52 @@
+#include "test.h"
+#include "fingerprint.h"
+
+TEST(fingerprint, urls) {
+    CHECK_EQ(getUrlFingerprint("example.com/a/"), getUrlFingerprint("example.com/a"));
+    CHECK_EQ(getUrlFingerprint("/"), getFingerprint("/", 1)); // the root keeps its slash
+    CHECK(getUrlFingerprint("example.com/a") != getUrlFingerprint("example.com/b"));
+    CHECK(getFingerprint("", 0) != 0);
+}
+
+TEST(fingerprint, setGrowth) {
+    FingerprintSet set(1);
+    size_t initialMemory = set.memoryUsage();
+    const uint64_t count = 100000;
+    for (uint64_t i = 0; i < count; i++) {
+        CHECK(set.insert(getFingerprint(reinterpret_cast<const char*>(&i), sizeof(i))));
+    }
+    CHECK_EQ(set.size(), count);
+    CHECK(set.memoryUsage() > initialMemory);
+    CHECK(set.memoryUsage() >= count * sizeof(uint64_t) * 4 / 3);
+
+    size_t missing = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t fingerprint = getFingerprint(reinterpret_cast<const char*>(&i), sizeof(i));
+        if (!set.contains(fingerprint) || set.insert(fingerprint)) missing++;
+    }
+    CHECK_EQ(missing, 0u);
+    CHECK_EQ(set.size(), count);
+
+    size_t falsePositives = 0;
+    for (uint64_t i = count; i < 2 * count; i++) {
+        if (set.contains(getFingerprint(reinterpret_cast<const char*>(&i), sizeof(i)))) falsePositives++;
+    }
+    CHECK_EQ(falsePositives, 0u);
+}
+
+TEST(fingerprint, bloomFilter) {
+    BloomFilter filter(10000, 0.01);
+    for (uint64_t i = 0; i < 10000; i++) {
+        filter.insert(getFingerprint(reinterpret_cast<const char*>(&i), sizeof(i)));
+    }
+    size_t falsePositives = 0;
+    for (uint64_t i = 0; i < 20000; i++) {
+        bool found = filter.mayContain(getFingerprint(reinterpret_cast<const char*>(&i), sizeof(i)));
+        if (i < 10000) {
+            CHECK(found);
+        } else if (found) {
+            falsePositives++;
+        }
+    }
+    CHECK(falsePositives < 300); // 1% expected, of 10000
+}
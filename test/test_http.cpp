@@ -0,0 +1,130 @@
+#include "test.h"
+#include "http.h"
+#include <string>
+
+// Feeds a response to a parser in pieces of `step` bytes and collects its body.
+static size_t feedInSteps(HttpResponseParser& parser, const std::string& response, size_t step) {
+    size_t consumed = 0;
+    for (size_t pos = 0; pos < response.size() && !parser.isComplete() && !parser.hasError(); pos += step) {
+        size_t length = std::min(step, response.size() - pos);
+        consumed += parser.feed(response.data() + pos, length);
+    }
+    return consumed;
+}
+
+TEST(http, contentLength) {
+    std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: 5\r\n\r\nhello"
+                           "HTTP/1.1 404 Not Found\r\n";
+    for (size_t step : {1, 7, 4096}) {
+        HttpResponseParser parser;
+        std::string body;
+        parser.setBodyHandler([&body](const char* data, size_t length) { body.append(data, length); });
+
+        size_t consumed = feedInSteps(parser, response, step);
+        CHECK(parser.isComplete());
+        CHECK_EQ(body, "hello");
+        CHECK_EQ(parser.getStatusCode(), 200);
+        CHECK(parser.isHtml());
+        CHECK(parser.isKeepAlive());
+        if (step == 4096) {
+            CHECK_EQ(consumed, response.find("HTTP/1.1 404")); // the next response is left alone
+        }
+    }
+}
+
+TEST(http, chunked) {
+    std::string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip, chunked\r\nContent-Encoding: gzip\r\n\r\n"
+                            "7;name=value\r\nHello, \r\n"
+                            "00006\r\nWorld!\r\n"
+                            "0\r\nExpires: never\r\n\r\n";
+    for (size_t step : {1, 2, 3, 10, 4096}) {
+        HttpResponseParser parser;
+        std::string body;
+        parser.setBodyHandler([&body](const char* data, size_t length) { body.append(data, length); });
+
+        CHECK_EQ(feedInSteps(parser, response, step), response.size());
+        CHECK(parser.isComplete());
+        CHECK_EQ(body, "Hello, World!");
+        CHECK_EQ(parser.getContentEncoding(), "gzip");
+        CHECK(parser.isKeepAlive());
+    }
+}
+
+TEST(http, chunkedErrors) {
+    HttpResponseParser parser;
+    std::string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n";
+    parser.feed(response.data(), response.size());
+    CHECK(parser.hasError());
+    CHECK(!parser.isKeepAlive());
+
+    parser.reset();
+    response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n";
+    parser.feed(response.data(), response.size());
+    CHECK(parser.hasError());
+}
+
+TEST(http, untilClose) {
+    HttpResponseParser parser;
+    std::string body;
+    parser.setBodyHandler([&body](const char* data, size_t length) { body.append(data, length); });
+
+    std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n\r\n<html>";
+    parser.feed(response.data(), response.size());
+    CHECK(!parser.isComplete());
+    parser.feed("</html>", 7);
+    parser.finish();
+    CHECK(parser.isComplete());
+    CHECK_EQ(body, "<html></html>");
+    CHECK(!parser.isKeepAlive()); // the server closed the connection to end the body
+
+    parser.reset();
+    response = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort";
+    parser.feed(response.data(), response.size());
+    parser.finish();
+    CHECK(parser.hasError());
+}
+
+TEST(http, keepAlive) {
+    struct Case {
+        const char* response;
+        bool keepAlive;
+    };
+    const Case cases[] = {
+        {"HTTP/1.1 204 No Content\r\n\r\n", true},
+        {"HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 0\r\n\r\n", false},
+        {"HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n", false},
+        {"HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 0\r\n\r\n", true},
+        {"HTTP/1.1 304 Not Modified\r\nContent-Length: 100\r\n\r\n", true},
+    };
+    for (const auto& testCase : cases) {
+        HttpResponseParser parser;
+        std::string response = testCase.response;
+        parser.feed(response.data(), response.size());
+        CHECK(parser.isComplete());
+        CHECK_EQ(parser.isKeepAlive(), testCase.keepAlive);
+    }
+}
+
+TEST(http, headers) {
+    HttpResponseParser parser;
+    std::string response = "\r\nHTTP/1.1 100 Continue\r\n\r\n"
+                           "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 120\r\nLocation: /elsewhere\r\n"
+                           "content-type: application/pdf\r\nContent-Length: 0\r\n\r\n";
+    parser.feed(response.data(), response.size());
+    CHECK(parser.isComplete());
+    CHECK_EQ(parser.getStatusCode(), 503);
+    CHECK_EQ(parser.getRetryAfter(), 120);
+    CHECK_EQ(parser.getLocation(), "/elsewhere");
+    CHECK(!parser.isHtml());
+
+    parser.reset();
+    response = "HTTP/1.1 429 Too Many Requests\r\nRetry-After: Wed, 21 Oct 2015 07:28:00 GMT\r\nContent-Length: 0\r\n\r\n";
+    parser.feed(response.data(), response.size());
+    CHECK_EQ(parser.getRetryAfter(), -1);
+    CHECK(parser.isHtml());
+
+    parser.reset();
+    response = "SSH-2.0-OpenSSH_9.6\r\n";
+    parser.feed(response.data(), response.size());
+    CHECK(parser.hasError());
+}
@@ -0,0 +1,59 @@
+#include "test.h"
+#include "indexed_heap.h"
+#include <string>
+#include <vector>
+
+TEST(indexedHeap, update) {
+    IndexedHeap<std::string> heap;
+    const std::vector<double> scores = {5, 1, 9, 3, 7, 2, 8, 6, 4, 0};
+    for (size_t i = 0; i < scores.size(); i++) {
+        heap.push(i, scores[i], "site" + std::to_string(i));
+    }
+    CHECK_EQ(heap.size(), scores.size());
+    CHECK(heap.contains(3));
+    CHECK_EQ(*heap.find(3), "site3");
+    CHECK(heap.find(42) == nullptr);
+
+    heap.update(9, 100); // lowest to highest
+    heap.update(2, -1);  // highest to lowest
+    heap.update(4, 7.5);
+    heap.update(42, 1000); // not queued, ignored
+
+    const std::vector<std::string> expected = {"site9", "site6", "site4", "site7", "site0", "site8",
+                                               "site3", "site5", "site1", "site2"};
+    std::vector<std::string> popped;
+    while (!heap.empty()) {
+        popped.push_back(heap.pop());
+    }
+    CHECK(popped == expected);
+    CHECK(!heap.contains(9));
+}
+
+TEST(indexedHeap, randomUpdates) {
+    IndexedHeap<uint64_t> heap;
+    std::vector<double> scores(500);
+    uint64_t state = 12345;
+    auto next = [&state] {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<double>(state >> 40);
+    };
+    for (uint64_t key = 0; key < scores.size(); key++) {
+        scores[key] = next();
+        heap.push(key, scores[key], key);
+    }
+    for (int i = 0; i < 2000; i++) {
+        uint64_t key = static_cast<uint64_t>(next()) % scores.size();
+        scores[key] = next();
+        heap.update(key, scores[key]);
+    }
+
+    double previous = 1e300;
+    size_t count = 0;
+    while (!heap.empty()) {
+        uint64_t key = heap.pop();
+        CHECK(scores[key] <= previous);
+        previous = scores[key];
+        count++;
+    }
+    CHECK_EQ(count, scores.size());
+}
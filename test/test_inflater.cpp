@@ -0,0 +1,107 @@
+#include "test.h"
+#include "inflater.h"
+#include <algorithm>
+#include <string>
+#include <zlib.h>
+
+// windowBits of deflateInit2 for every container
+const int GZIP_BITS = 15 + 16;
+const int ZLIB_BITS = 15;
+const int RAW_BITS = -15;
+
+static std::string makeBody() {
+    std::string body;
+    uint32_t state = 1;
+    for (int i = 0; body.size() < 200000; i++) {
+        state = state * 1103515245 + 12345;
+        body += "<a href=\"/page" + std::to_string(state % 100000) + ".html\">link " + std::to_string(i) + "</a>\n";
+    }
+    return body;
+}
+
+static std::string compress(const std::string& body, int windowBits) {
+    z_stream stream = z_stream();
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY);
+    std::string compressed(deflateBound(&stream, static_cast<uLong>(body.size())) + 32, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+    stream.avail_in = static_cast<uInt>(body.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+// Decodes a body fed in pieces of `step` bytes, false if the decoder reported it corrupt.
+static bool decodeInSteps(Inflater::Encoding encoding, const std::string& compressed, size_t step, std::string& decoded) {
+    std::unique_ptr<Inflater> inflater = Inflater::acquire(encoding);
+    if (!inflater) {
+        return false;
+    }
+    decoded.clear();
+    bool valid = true;
+    for (size_t pos = 0; pos < compressed.size() && valid; pos += step) {
+        valid = inflater->feed(compressed.data() + pos, std::min(step, compressed.size() - pos),
+                               [&decoded](const char* data, size_t length) { decoded.append(data, length); });
+    }
+    valid = valid && inflater->isFinished() && inflater->getOutputBytes() == decoded.size();
+    Inflater::release(std::move(inflater));
+    return valid;
+}
+
+TEST(inflater, parseEncoding) {
+    CHECK(Inflater::parseEncoding("") == Inflater::Encoding::Identity);
+    CHECK(Inflater::parseEncoding(" identity ") == Inflater::Encoding::Identity);
+    CHECK(Inflater::parseEncoding("gzip") == Inflater::Encoding::Gzip);
+    CHECK(Inflater::parseEncoding("X-GZip") == Inflater::Encoding::Gzip);
+    CHECK(Inflater::parseEncoding("Deflate\t") == Inflater::Encoding::Deflate);
+    CHECK(Inflater::parseEncoding("br") == Inflater::Encoding::Unsupported);
+    CHECK(Inflater::parseEncoding("gzip, br") == Inflater::Encoding::Unsupported);
+}
+
+TEST(inflater, steps) {
+    const std::string body = makeBody();
+    struct Case {
+        const char* name;
+        Inflater::Encoding encoding;
+        int windowBits;
+    };
+    const Case cases[] = {
+        {"gzip", Inflater::Encoding::Gzip, GZIP_BITS},
+        {"zlib", Inflater::Encoding::Deflate, ZLIB_BITS},
+        {"raw deflate", Inflater::Encoding::Deflate, RAW_BITS},
+        {"gzip as deflate", Inflater::Encoding::Deflate, GZIP_BITS},
+    };
+    for (const auto& testCase : cases) {
+        std::string compressed = compress(body, testCase.windowBits);
+        for (size_t step : {size_t(1), size_t(2), size_t(3), size_t(1000), compressed.size()}) {
+            std::string decoded;
+            bool valid = decodeInSteps(testCase.encoding, compressed, step, decoded);
+            if (!valid || decoded != body) {
+                reportFailure(__FILE__, __LINE__, std::string(testCase.name) + " fed in steps of " + std::to_string(step));
+            }
+        }
+    }
+}
+
+TEST(inflater, corruptBodies) {
+    const std::string body = makeBody();
+    std::string decoded;
+
+    // raw deflate is only tried for "deflate"
+    CHECK(!decodeInSteps(Inflater::Encoding::Gzip, compress(body, RAW_BITS), 1, decoded));
+
+    std::string compressed = compress(body, GZIP_BITS);
+    compressed[compressed.size() / 2] ^= 0x55;
+    CHECK(!decodeInSteps(Inflater::Encoding::Gzip, compressed, 4096, decoded));
+    CHECK(decoded.size() < body.size());
+
+    compressed = compress(body, ZLIB_BITS);
+    CHECK(!decodeInSteps(Inflater::Encoding::Deflate, compressed.substr(0, compressed.size() / 2), 4096, decoded));
+    CHECK_EQ(body.compare(0, decoded.size(), decoded), 0); // the output before the cut is kept
+
+    compressed = compress(body, GZIP_BITS) + "trailing garbage";
+    CHECK(decodeInSteps(Inflater::Encoding::Gzip, compressed, 7, decoded));
+    CHECK(decoded == body);
+}
@@ -0,0 +1,85 @@
+#include "test.h"
+#include "parser.h"
+#include <string>
+#include <vector>
+
+// Extracts the links of a document fed in pieces of `step` bytes, as "host path".
+static std::vector<std::string> extractInSteps(const std::string& document, size_t step) {
+    LinkExtractor extractor("example.com");
+    std::vector<LinkExtractor::Link> links;
+    std::vector<std::string> found;
+    for (size_t pos = 0; pos < document.size(); pos += step) {
+        // every piece is copied, so a link spanning pieces cannot be read from the previous buffer
+        std::string piece = document.substr(pos, step);
+        extractor.feed(piece.data(), piece.size(), links);
+        for (const auto& link : links) {
+            found.push_back(std::string(link.host) + " " + std::string(link.path));
+        }
+        links.clear();
+    }
+    extractor.finish(links);
+    for (const auto& link : links) {
+        found.push_back(std::string(link.host) + " " + std::string(link.path));
+    }
+    return found;
+}
+
+TEST(parser, normalizeUrl) {
+    CHECK_EQ(normalizeUrl("HTTP://User@Example.COM:80/a/./b/../c?q=1#top"), "http://example.com/a/c?q=1");
+    CHECK_EQ(normalizeUrl("https://example.com:443"), "https://example.com/");
+    CHECK_EQ(normalizeUrl("https://example.com:8443?x"), "https://example.com:8443/?x");
+    CHECK_EQ(normalizeUrl("http://example.com./a/b/"), "http://example.com/a/b/");
+    CHECK_EQ(normalizeUrl("http://example.com/../../a"), "http://example.com/a");
+    CHECK_EQ(normalizeUrl("ftp://example.com/"), "");
+    CHECK_EQ(normalizeUrl("http:///path"), "");
+    CHECK_EQ(normalizeUrl("example.com/path"), "");
+}
+
+TEST(parser, urlParts) {
+    CHECK_EQ(getHostnameFromUrl("https://example.com/a/b"), "example.com");
+    CHECK_EQ(getHostnameFromUrl("http://example.com"), "example.com");
+    CHECK_EQ(getHostPathFromUrl("https://example.com/a/b"), "/a/b");
+    CHECK_EQ(getHostPathFromUrl("http://example.com"), "/");
+    CHECK(verifyUrl("http://www.example.co.uk/"));
+    CHECK(!verifyUrl("http://co.uk/"));
+}
+
+TEST(parser, resolveLinks) {
+    std::string document = "<a href=\"/about\">About</a> <A HREF='contact.html#form'>"
+                           "<img src=\"//cdn.example.org/logo\"> <a href=\"https://Other.Example.NET:443/x/../y\">"
+                           "<a href=\"mailto:me@example.com\"> <a href=\"javascript:void(0)\">"
+                           "<link href=\"/style.css\"> <div style=\"background: url( 'bg.html' )\">"
+                           "see http://plain.example.com/text for details";
+    std::vector<std::string> expected = {
+        "example.com /about",
+        "example.com /contact.html",
+        "cdn.example.org /logo",
+        "other.example.net /y",
+        "example.com /bg.html",
+        "plain.example.com /text",
+    };
+    CHECK(extractInSteps(document, document.size()) == expected);
+}
+
+TEST(parser, linksAcrossChunks) {
+    std::string document = "<html><body><a href=\"/first/page.html\">1</a>"
+                           "<a href=\"https://www.example.org/second?query=value\">2</a>"
+                           "text http://third.example.net/path";
+    std::vector<std::string> expected = {
+        "example.com /first/page.html",
+        "www.example.org /second", // the query is dropped
+        "third.example.net /path", // ends with the document
+    };
+    for (size_t step = 1; step <= 24; step++) {
+        std::vector<std::string> found = extractInSteps(document, step);
+        CHECK(found == expected);
+    }
+}
+
+TEST(parser, longLinks) {
+    std::string longPath(4096, 'a');
+    std::string document = "<a href=\"/" + longPath + "\"> <a href=\"/short\">";
+    std::vector<std::string> expected = {"example.com /short"};
+    CHECK(extractInSteps(document, document.size()) == expected);
+    CHECK(extractInSteps(document, 100) == expected);
+}
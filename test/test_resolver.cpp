@@ -0,0 +1,30 @@
+#include "test.h"
+#include "resolver.h"
+
+// numeric hosts, so the tests do not depend on DNS
+TEST(resolver, cacheEviction) {
+    Resolver resolver(1, 300, 60, 2);
+    Resolver::Resolution resolution;
+    CHECK(!resolver.lookupCached("127.0.0.1", resolution));
+
+    CHECK_EQ(resolver.resolve("127.0.0.1").status, 0);
+    CHECK_EQ(resolver.resolve("127.0.0.2").status, 0);
+    CHECK(resolver.lookupCached("127.0.0.1", resolution)); // 127.0.0.1 is now the most recently used
+    CHECK_EQ(resolution.addresses.size(), 1u);
+
+    CHECK_EQ(resolver.resolve("127.0.0.3").status, 0);
+    CHECK(!resolver.lookupCached("127.0.0.2", resolution));
+    CHECK(resolver.lookupCached("127.0.0.1", resolution));
+    CHECK(resolver.lookupCached("127.0.0.3", resolution));
+}
+
+TEST(resolver, expiry) {
+    Resolver expiring(1, 0, 0);
+    Resolver::Resolution resolution;
+    CHECK_EQ(expiring.resolve("127.0.0.1").status, 0);
+    CHECK(!expiring.lookupCached("127.0.0.1", resolution));
+
+    Resolver uncached(1, 300, 60, 0);
+    CHECK_EQ(uncached.resolve("127.0.0.1").status, 0);
+    CHECK(!uncached.lookupCached("127.0.0.1", resolution));
+}
@@ -0,0 +1,127 @@
+#include "test.h"
+#include "result_format.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static Socket::SiteStats makeSite(int index) {
+    Socket::SiteStats stats;
+    stats.hostname = "site" + std::to_string(index) + ".example.com";
+    for (int page = 0; page <= index % 3; page++) {
+        stats.discoveredPages.emplace_back(stats.hostname + "/page" + std::to_string(page) + ".html", 10.5 + page);
+    }
+    if (index % 2 == 0) {
+        stats.linkedSites.push_back("site" + std::to_string(index + 1) + ".example.com");
+        stats.linkedSites.push_back("shared.example.org");
+    }
+    stats.failedQueries = index;
+    stats.minResponseTime = 10.5;
+    stats.maxResponseTime = 10.5 + index % 3;
+    stats.averageResponseTime = 11.25;
+    return stats;
+}
+
+// Reads a results file and checks that it holds sites [0, count) written by makeSite, in order.
+static void checkSites(const std::string& path, int count, bool indexed) {
+    ResultFileReader reader;
+    CHECK(reader.open(path));
+    CHECK_EQ(reader.hasIndex(), indexed);
+    CHECK_EQ(reader.siteCount(), static_cast<size_t>(count));
+
+    int index = 0;
+    reader.forEachSite([&index](const ResultRecord& record) {
+        Socket::SiteStats expected = makeSite(index);
+        CHECK_EQ(record.hostname, expected.hostname);
+        CHECK_EQ(record.depth, index / 2);
+        CHECK_EQ(record.failedQueries, static_cast<uint32_t>(index));
+        CHECK_EQ(record.minResponseTime, 10.5f);
+        CHECK_EQ(record.maxResponseTime, static_cast<float>(expected.maxResponseTime));
+        CHECK_EQ(record.averageResponseTime, 11.25f);
+        CHECK_EQ(record.pages.size(), expected.discoveredPages.size());
+        for (size_t page = 0; page < std::min(record.pages.size(), expected.discoveredPages.size()); page++) {
+            CHECK_EQ(record.pages[page].first, "/page" + std::to_string(page) + ".html");
+            CHECK_EQ(record.pages[page].second, static_cast<float>(expected.discoveredPages[page].second));
+        }
+        CHECK_EQ(record.linkedSites.size(), expected.linkedSites.size());
+        for (size_t link = 0; link < std::min(record.linkedSites.size(), expected.linkedSites.size()); link++) {
+            CHECK_EQ(record.linkedSites[link], expected.linkedSites[link]);
+        }
+        index++;
+    });
+    CHECK_EQ(index, count);
+}
+
+TEST(results, roundTrip) {
+    std::string path = makeTempPath("results.trb");
+    {
+        ResultFileWriter writer(4);
+        CHECK(writer.open(path));
+        for (int i = 0; i < 10; i++) {
+            writer.append(makeSite(i), i / 2);
+        }
+        CHECK(writer.close());
+    }
+    checkSites(path, 10, true);
+
+    ResultFileReader reader;
+    CHECK(reader.open(path));
+    std::vector<ResultBlockIndexEntry> index = reader.getBlockIndex();
+    CHECK_EQ(index.size(), 3u); // 4 + 4 + 2 sites
+    Socket::SiteStats empty;
+    empty.hostname = "empty.example.com";
+    reader.close();
+
+    ResultFileWriter writer;
+    CHECK(writer.open(path));
+    writer.append(empty, 0);
+    CHECK(writer.close());
+    CHECK(reader.open(path));
+    reader.forEachSite([](const ResultRecord& record) {
+        CHECK_EQ(record.hostname, "empty.example.com");
+        CHECK(record.pages.empty());
+        CHECK(std::isnan(record.minResponseTime));
+    });
+    std::remove(path.c_str());
+}
+
+TEST(results, recovery) {
+    std::string path = makeTempPath("recovery.trb");
+    std::string crashedPath = makeTempPath("crashed.trb");
+    {
+        ResultFileWriter writer(3);
+        CHECK(writer.open(path));
+        for (int i = 0; i < 6; i++) {
+            writer.append(makeSite(i), i / 2);
+        }
+        CHECK(writer.flush());
+        std::string written = readFile(path);
+
+        // a crash in the middle of the next block: two complete blocks, a torn one and no footer
+        for (int i = 6; i < 8; i++) {
+            writer.append(makeSite(i), i / 2);
+        }
+        CHECK(writer.close());
+        std::string complete = readFile(path);
+        CHECK(complete.size() > written.size() + 40);
+        writeFile(crashedPath, complete.substr(0, written.size() + 40));
+    }
+    checkSites(crashedPath, 6, false);
+
+    {
+        ResultFileWriter writer(3);
+        CHECK(writer.open(crashedPath, true)); // resumed crawl
+        for (int i = 6; i < 9; i++) {
+            writer.append(makeSite(i), i / 2);
+        }
+        CHECK(writer.close());
+    }
+    checkSites(crashedPath, 9, true);
+
+    writeFile(crashedPath, "THREADR2 not a results file");
+    ResultFileReader reader;
+    CHECK(!reader.open(crashedPath));
+    std::remove(path.c_str());
+    std::remove(crashedPath.c_str());
+}
@@ -0,0 +1,77 @@
+#include "test.h"
+#include "robots.h"
+#include <memory>
+#include <string>
+
+TEST(robots, longestMatch) {
+    RobotsRules rules = RobotsRules::parse("User-agent: *\n"
+                                           "Disallow: /private\n"
+                                           "Allow: /private/public\n"
+                                           "Disallow: /private/public/secret\n"
+                                           "Disallow: /tie\n"
+                                           "Allow: /tie\n",
+                                           "threadr");
+    CHECK(rules.isAllowed("/"));
+    CHECK(rules.isAllowed("/index.html"));
+    CHECK(!rules.isAllowed("/private"));
+    CHECK(!rules.isAllowed("/private.html"));
+    CHECK(rules.isAllowed("/private/public/page.html"));
+    CHECK(!rules.isAllowed("/private/public/secret/1"));
+    CHECK(rules.isAllowed("/tie/x")); // Allow wins ties
+    CHECK(rules.isAllowed("/robots.txt"));
+    CHECK_EQ(rules.getCrawlDelayMs(), -1);
+}
+
+TEST(robots, wildcards) {
+    RobotsRules rules = RobotsRules::parse("User-agent: *\n"
+                                           "Disallow: /*.pdf$\n"
+                                           "Disallow: /search*q=\n"
+                                           "Disallow: /exact$\n"
+                                           "Disallow: /docs/\n"
+                                           "Allow: /docs/*/index.html\n",
+                                           "threadr");
+    CHECK(!rules.isAllowed("/files/report.pdf"));
+    CHECK(rules.isAllowed("/files/report.pdf.html"));
+    CHECK(!rules.isAllowed("/search?lang=en&q=threads"));
+    CHECK(rules.isAllowed("/search?lang=en"));
+    CHECK(!rules.isAllowed("/exact"));
+    CHECK(rules.isAllowed("/exact/more"));
+    CHECK(!rules.isAllowed("/docs/api/page.html"));
+    CHECK(rules.isAllowed("/docs/api/index.html")); // the longer pattern beats the prefix
+}
+
+TEST(robots, groups) {
+    std::string text = "User-agent: *\n"
+                       "Disallow: /\n"
+                       "\n"
+                       "User-agent: OtherBot\n"
+                       "User-agent: Threadr/2.0\n"
+                       "Sitemap: https://example.com/sitemap.xml\n"
+                       "Disallow: /tmp # comment\n"
+                       "Crawl-delay: 2.5\n"
+                       "\n"
+                       "User-agent: *\n"
+                       "Crawl-delay: 1\n";
+    RobotsRules rules = RobotsRules::parse(text, "threadr");
+    CHECK(rules.isAllowed("/"));
+    CHECK(!rules.isAllowed("/tmp/file"));
+    CHECK_EQ(rules.getCrawlDelayMs(), 2500);
+
+    RobotsRules defaultRules = RobotsRules::parse(text, "somebot");
+    CHECK(!defaultRules.isAllowed("/index.html"));
+    CHECK_EQ(defaultRules.getCrawlDelayMs(), 1000);
+
+    CHECK(RobotsRules::getAllowAll()->isAllowed("/anything"));
+    CHECK(!RobotsRules::getDisallowAll()->isAllowed("/anything"));
+}
+
+TEST(robots, cacheEviction) {
+    RobotsCache cache(2);
+    cache.insert("a.com", RobotsRules::getAllowAll());
+    cache.insert("b.com", RobotsRules::getDisallowAll());
+    CHECK(cache.lookup("a.com") == RobotsRules::getAllowAll()); // a.com is now the most recently used
+    cache.insert("c.com", RobotsRules::getAllowAll());
+    CHECK(cache.lookup("b.com") == nullptr);
+    CHECK(cache.lookup("a.com") != nullptr);
+    CHECK(cache.lookup("c.com") != nullptr);
+}
@@ -0,0 +1,64 @@
+#include "test.h"
+#include "timer_wheel.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+using std::chrono::milliseconds;
+
+// the wheel reads the clock when a timer is scheduled, so expiries are checked within this margin
+const int MARGIN_MS = 3;
+
+static void runExpired(std::vector<TimerWheel::Task>& expired) {
+    for (auto& task : expired) task();
+    expired.clear();
+}
+
+TEST(timerWheel, cascading) {
+    TimerWheel wheel;
+    TimerWheel::Clock::time_point start = TimerWheel::Clock::now();
+
+    // delays around the boundaries of every level: 256 ms, 65536 ms (~1 min) and 16777216 ms (~4.7 h)
+    const std::vector<int> delays = {1, 10, 250, 262, 300, 65530, 65542, 70000, 16777200, 16777230, 20000000};
+    std::vector<int> fired;
+    for (size_t i = delays.size(); i-- > 0;) {
+        int delay = delays[i];
+        wheel.schedule(delay, [&fired, delay] { fired.push_back(delay); });
+    }
+    uint64_t cancelled = wheel.schedule(70010, [&fired] { fired.push_back(-1); });
+    wheel.cancel(cancelled);
+
+    std::vector<TimerWheel::Task> expired;
+    for (size_t i = 0; i < delays.size(); i++) {
+        wheel.advance(start + milliseconds(std::max(0, delays[i] - MARGIN_MS)), expired);
+        runExpired(expired);
+        CHECK_EQ(fired.size(), i);
+
+        wheel.advance(start + milliseconds(delays[i] + MARGIN_MS), expired);
+        runExpired(expired);
+        CHECK_EQ(fired.size(), i + 1);
+        if (fired.size() == i + 1) {
+            CHECK_EQ(fired.back(), delays[i]);
+        }
+    }
+    CHECK(wheel.empty());
+    CHECK_EQ(wheel.nextTimeoutMs(start), -1);
+}
+
+TEST(timerWheel, sameSlot) {
+    TimerWheel wheel;
+    TimerWheel::Clock::time_point start = TimerWheel::Clock::now();
+    int count = 0;
+    for (int i = 0; i < 1000; i++) {
+        wheel.schedule(100000, [&count] { count++; });
+    }
+    CHECK(!wheel.empty());
+    CHECK(wheel.nextTimeoutMs(start) > 0);
+
+    std::vector<TimerWheel::Task> expired;
+    wheel.advance(start + milliseconds(100000 + MARGIN_MS), expired);
+    CHECK_EQ(expired.size(), 1000u);
+    runExpired(expired);
+    CHECK_EQ(count, 1000);
+    CHECK(wheel.empty());
+}
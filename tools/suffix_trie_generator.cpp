@@ -0,0 +1,183 @@
+/**
+ * @file suffix_trie_generator.cpp
+ * @brief Build time generator of the public suffix trie used by verifyDomain.
+ *
+ * Reads a file in the Public Suffix List format and writes a C++ header with the rules stored as a trie
+ * of reversed labels ("co.uk" is stored as uk -> co). The nodes are laid out breadth first, so the
+ * children of a node are contiguous and sorted, and a lookup needs one binary search per host label.
+ *
+ * Usage: suffix_trie_generator <public_suffix_list.dat> <output header>
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct TrieNode {
+    bool isRule = false;
+    bool isException = false;
+    std::map<std::string, std::unique_ptr<TrieNode>> children;
+};
+
+/**
+ * @brief Splits a rule into its labels, from the rightmost to the leftmost.
+ *
+ * @param rule The rule, e.g. "co.uk".
+ * @return The reversed labels, e.g. {"uk", "co"}.
+ */
+static std::vector<std::string> getReversedLabels(const std::string& rule) {
+    std::vector<std::string> labels;
+    std::stringstream stream(rule);
+    std::string label;
+    while (std::getline(stream, label, '.')) {
+        labels.insert(labels.begin(), label);
+    }
+    return labels;
+}
+
+/**
+ * @brief Reads the rules of a public suffix list file into a trie.
+ *
+ * @param input The list file.
+ * @param root The root of the trie.
+ * @return The number of rules read.
+ */
+static int readRules(std::istream& input, TrieNode& root) {
+    int ruleCount = 0;
+    std::string line;
+    while (std::getline(input, line)) {
+        // a rule is the first whitespace delimited word of a line, comments start with "//"
+        std::stringstream stream(line);
+        std::string rule;
+        if (!(stream >> rule) || rule.compare(0, 2, "//") == 0) {
+            continue;
+        }
+
+        bool isException = rule[0] == '!';
+        if (isException) {
+            rule.erase(0, 1);
+        }
+
+        TrieNode* node = &root;
+        for (const auto& label : getReversedLabels(rule)) {
+            auto& child = node->children[label];
+            if (!child) {
+                child.reset(new TrieNode());
+            }
+            node = child.get();
+        }
+        node->isRule = !isException;
+        node->isException = isException;
+        ruleCount++;
+    }
+    return ruleCount;
+}
+
+/**
+ * @brief Escapes a string for use in a C++ string literal.
+ *
+ * @param text The text to escape.
+ * @return The escaped text.
+ */
+static std::string escape(const std::string& text) {
+    std::string result;
+    for (unsigned char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            result += '\\';
+            result += static_cast<char>(ch);
+        } else if (ch < 0x20 || ch >= 0x7f) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\%03o", ch);
+            result += buffer;
+        } else {
+            result += static_cast<char>(ch);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Writes the trie as a header with a label pool and a breadth first node array.
+ *
+ * @param output The header to write.
+ * @param root The root of the trie.
+ * @param ruleCount The number of rules, written as a comment.
+ */
+static void writeHeader(std::ostream& output, const TrieNode& root, int ruleCount) {
+    struct Entry {
+        const TrieNode* node;
+        std::string label;
+    };
+
+    std::vector<Entry> order;
+    std::queue<Entry> pending;
+    pending.push({&root, ""});
+    while (!pending.empty()) {
+        Entry entry = pending.front();
+        pending.pop();
+        order.push_back(entry);
+        for (const auto& child : entry.node->children) {
+            pending.push({child.second.get(), child.first});
+        }
+    }
+
+    std::string labels;
+    std::ostringstream nodes;
+    size_t nextChild = 1;
+    for (const auto& entry : order) {
+        unsigned flags = (entry.node->isRule ? 1u : 0u) | (entry.node->isException ? 2u : 0u);
+        nodes << "    {" << labels.size() << ", " << entry.label.size() << ", " << flags << ", "
+              << nextChild << ", " << entry.node->children.size() << "},\n";
+        labels += entry.label;
+        nextChild += entry.node->children.size();
+    }
+
+    output << "// Generated by suffix_trie_generator from the public suffix list (" << ruleCount << " rules). Do not edit.\n"
+           << "#ifndef PUBLIC_SUFFIX_TRIE_H\n"
+           << "#define PUBLIC_SUFFIX_TRIE_H\n\n"
+           << "#include <cstdint>\n\n"
+           << "struct SuffixTrieNode {\n"
+           << "    uint32_t labelOffset;\n"
+           << "    uint8_t labelLength;\n"
+           << "    uint8_t flags;\n"
+           << "    uint32_t firstChild;\n"
+           << "    uint32_t childCount;\n"
+           << "};\n\n"
+           << "const uint8_t SUFFIX_RULE = 1;\n"
+           << "const uint8_t SUFFIX_EXCEPTION = 2;\n\n"
+           << "static const char SUFFIX_LABELS[] = \"" << escape(labels) << "\";\n\n"
+           << "static const SuffixTrieNode SUFFIX_TRIE[] = {\n"
+           << nodes.str()
+           << "};\n\n"
+           << "#endif // PUBLIC_SUFFIX_TRIE_H\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <public_suffix_list.dat> <output header>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream input(argv[1]);
+    if (!input) {
+        std::cerr << " [!] Error: Cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    TrieNode root;
+    int ruleCount = readRules(input, root);
+
+    std::ofstream output(argv[2]);
+    if (!output) {
+        std::cerr << " [!] Error: Cannot write " << argv[2] << std::endl;
+        return 1;
+    }
+    writeHeader(output, root, ruleCount);
+    return 0;
+}